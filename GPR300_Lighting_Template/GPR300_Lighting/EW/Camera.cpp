@@ -2,33 +2,62 @@
 
 #include "Camera.h"
 
-glm::vec3 Camera::getForward() {
-	float yawRad = glm::radians(mYaw);
-	float pitchRad = glm::radians(mPitch);
-
-	glm::vec3 forward;
-	forward.x = cos(yawRad) * cos(pitchRad);
-	forward.y = sin(pitchRad);
-	forward.z = sin(yawRad) * cos(pitchRad);
-	return forward;
-}
+void Camera::update() {
+	if (!mViewDirty && !mProjectionDirty) {
+		return;
+	}
+
+	if (mViewDirty) {
+		float yawRad = glm::radians(mYaw);
+		float pitchRad = glm::radians(mPitch);
 
-glm::mat4 Camera::getProjectionMatrix() {
-	if (mOrtho) {
-		float width = mOrthoSize * mAspectRatio;
-		float right = width * 0.5f;
-		float left = -right;
-		float top = mOrthoSize * 0.5f;
-		float bottom = -top;
-		return glm::ortho(left,right,bottom,top, mNearPlane, mFarPlane);
+		mForward.x = cos(yawRad) * cos(pitchRad);
+		mForward.y = sin(pitchRad);
+		mForward.z = sin(yawRad) * cos(pitchRad);
+		mView = glm::lookAt(mPosition, mPosition + mForward, glm::vec3(0, 1, 0));
 	}
-	else {
-		return glm::perspective(glm::radians(mFov), mAspectRatio, mNearPlane, mFarPlane);
+
+	if (mProjectionDirty) {
+		if (mOrtho) {
+			float width = mOrthoSize * mAspectRatio;
+			float right = width * 0.5f;
+			float left = -right;
+			float top = mOrthoSize * 0.5f;
+			float bottom = -top;
+			mProjection = glm::ortho(left, right, bottom, top, mNearPlane, mFarPlane);
+		}
+		else {
+			mProjection = glm::perspective(glm::radians(mFov), mAspectRatio, mNearPlane, mFarPlane);
+		}
 	}
+
+	mViewProjection = mProjection * mView;
+	mFrustum = ew::Frustum::fromMatrix(mViewProjection);
+	mViewDirty = false;
+	mProjectionDirty = false;
 }
 
-glm::mat4 Camera::getViewMatrix() {
-	return glm::lookAt(mPosition, mPosition + getForward(), glm::vec3(0,1,0));
+const glm::vec3& Camera::getForward() {
+	update();
+	return mForward;
 }
 
+const glm::mat4& Camera::getProjectionMatrix() {
+	update();
+	return mProjection;
+}
+
+const glm::mat4& Camera::getViewMatrix() {
+	update();
+	return mView;
+}
+
+const glm::mat4& Camera::getViewProjectionMatrix() {
+	update();
+	return mViewProjection;
+}
 
+const ew::Frustum& Camera::getFrustum() {
+	update();
+	return mFrustum;
+}
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <glm/glm.hpp>
 #include <glm/matrix.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include "Frustum.h"
 
 class Camera {
 public:
@@ -13,20 +14,26 @@ public:
 	inline float getYaw()const { return mYaw; }
 	inline float getPitch()const { return mPitch; }
 	inline float getFov()const { return mFov; }
-	glm::vec3 getForward();
-	glm::mat4 getProjectionMatrix();
-	glm::mat4 getViewMatrix();
+	//Matrices and the frustum are rebuilt on the first call after a setter changed them
+	const glm::vec3& getForward();
+	const glm::mat4& getProjectionMatrix();
+	const glm::mat4& getViewMatrix();
+	const glm::mat4& getViewProjectionMatrix();
+	const ew::Frustum& getFrustum();
 	//SETTERS
-	inline void setPosition(const glm::vec3 position) { mPosition = position; }
-	inline void setYaw(const float yaw) { mYaw = yaw; };
-	inline void setPitch(const float pitch) { mPitch = pitch; }
-	inline void setFov(const float fov) { mFov = glm::clamp(fov, 0.0f, 180.0f); }
-	inline void setNearPlane(const float nearPlane) { mNearPlane = nearPlane; }
-	inline void setFarPlane(const float farPlane) { mFarPlane = farPlane; }
-	inline void setOrthoSize(const float orthoSize) { mOrthoSize = orthoSize; }
-	inline void setOrtho(const bool ortho) { mOrtho = ortho; }
-	inline void setAspectRatio(const float aspectRatio) { mAspectRatio = aspectRatio; }
+	inline void setPosition(const glm::vec3 position) { mPosition = position; mViewDirty = true; }
+	inline void setYaw(const float yaw) { mYaw = yaw; mViewDirty = true; };
+	inline void setPitch(const float pitch) { mPitch = pitch; mViewDirty = true; }
+	inline void setFov(const float fov) { mFov = glm::clamp(fov, 0.0f, 180.0f); mProjectionDirty = true; }
+	inline void setNearPlane(const float nearPlane) { mNearPlane = nearPlane; mProjectionDirty = true; }
+	inline void setFarPlane(const float farPlane) { mFarPlane = farPlane; mProjectionDirty = true; }
+	inline void setOrthoSize(const float orthoSize) { mOrthoSize = orthoSize; mProjectionDirty = true; }
+	inline void setOrtho(const bool ortho) { mOrtho = ortho; mProjectionDirty = true; }
+	inline void setAspectRatio(const float aspectRatio) { mAspectRatio = aspectRatio; mProjectionDirty = true; }
 private:
+	//Brings whatever is stale up to date
+	void update();
+
 	glm::vec3 mPosition = glm::vec3(0, 0, 5);
 	float mYaw = -90.0f;
 	float mPitch = 0.0f;
@@ -36,4 +43,12 @@ private:
 	float mOrthoSize = 7.5f;
 	bool mOrtho = false;
 	float mAspectRatio = 1.7777f;
+
+	bool mViewDirty = true;
+	bool mProjectionDirty = true;
+	glm::vec3 mForward;
+	glm::mat4 mView;
+	glm::mat4 mProjection;
+	glm::mat4 mViewProjection;
+	ew::Frustum mFrustum;
 };
\ No newline at end of file
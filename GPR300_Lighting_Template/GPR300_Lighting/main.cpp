@@ -21,15 +21,20 @@
 #include "EW/Mesh.h"
 #include "EW/Transform.h"
 #include "EW/ShapeGen.h"
+#include "EW/JobSystem.h"
 
+#include <chrono>
 #include <iostream>
+#include <vector>
 
-void processInput(GLFWwindow* window);
+void processInput(GLFWwindow* window, float dt);
+bool isMovementKeyHeld(GLFWwindow* window);
 void resizeFrameBufferCallback(GLFWwindow* window, int width, int height);
 void keyboardCallback(GLFWwindow* window, int keycode, int scancode, int action, int mods);
 void mouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 void mousePosCallback(GLFWwindow* window, double xpos, double ypos);
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+void windowRefreshCallback(GLFWwindow* window);
 
 float lastFrameTime;
 float deltaTime;
@@ -95,6 +100,107 @@ float pointLightIntensity = 0.5;
 float range = 10;
 float orbit = 3;
 
+//Cubes in a grid behind the shapes, for a scene where the simulation costs something
+const int MAX_EXTRA_OBJECTS = 50000;
+const int EXTRA_GRID_WIDTH = 50;
+const float EXTRA_SPACING = 1.5f;
+int numExtraObjects = 0;
+//Off waits for the simulation before drawing, the way it was before
+bool pipelined = true;
+
+//The simulation and camera movement advance in steps of 1 / updateRate whatever the frame rate is.
+//Frames in between draw a blend of the last two steps
+float updateRate = 60;
+bool interpolate = true;
+//A long hitch, e.g. dragging the window, is dropped instead of caught up on with hundreds of steps
+const int MAX_STEPS_PER_FRAME = 8;
+
+//Only draws when something could have changed: input, the UI, the camera moving or something animating.
+//Otherwise the loop sleeps in glfwWaitEventsTimeout instead of drawing the same frame again
+bool onDemand = false;
+//Frames drawn after an event. ImGui needs a couple to settle hover highlights and popups, and the pipelined
+//simulation shows a change a frame late
+const int REDRAW_FRAMES_AFTER_EVENT = 3;
+//Longest sleep without an event, in seconds
+const double IDLE_WAIT_TIMEOUT = 0.25;
+int redrawFrames = REDRAW_FRAMES_AFTER_EVENT;
+
+//Drawn with the lit shader, owned by the simulation
+struct SceneObject
+{
+	ew::Mesh* mesh;
+	ew::Transform transform;
+	//Bounding sphere radius at scale 1
+	float radius;
+	//Radians per second around y
+	float spinSpeed;
+	//Around y after the last two steps
+	float spin;
+	float previousSpin;
+};
+
+//Only the simulation touches this, one frame at a time
+struct SimulationState
+{
+	//The shapes come first, extra objects after them
+	std::vector<SceneObject> objects;
+	int numShapes;
+	ew::Mesh* extraMesh;
+	std::vector<glm::mat4> models;
+	std::vector<unsigned char> visible;
+	//Point lights after the last two steps
+	float orbitAngle;
+	glm::vec3 lightPositions[3];
+	glm::vec3 previousLightPositions[3];
+};
+
+//Copied from the globals before the simulation starts, so input and the UI can keep changing them while it runs
+struct SimulationInput
+{
+	//Steps to take, how long each is, and how far the frame is past the last one as a fraction of a step
+	int numSteps;
+	float fixedDeltaTime;
+	float alpha;
+	//Already moved to where it is between steps
+	Camera camera = Camera(1.0f);
+	DirectionalLight dirLight;
+	PointLight pointLights[3];
+	SpotLight spotLight;
+	int numPointLights;
+	float pointLightIntensity;
+	float range;
+	float orbit;
+	int numExtraObjects;
+};
+
+struct DrawCall
+{
+	ew::Mesh* mesh;
+	glm::mat4 model;
+};
+
+//Everything the GL thread needs to draw a frame. The simulation fills one while the other is drawn
+struct RenderSnapshot
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 cameraPosition;
+	DirectionalLight dirLight;
+	int numPointLights = 0;
+	PointLight pointLights[3];
+	glm::mat4 lightModels[3];
+	SpotLight spotLight;
+	//Objects that survived culling, in scene order
+	std::vector<DrawCall> draws;
+	int numObjects = 0;
+	float simulationMs = 0;
+	float stepMs = 0;
+};
+
+void captureSimulationInput(SimulationInput& input);
+glm::vec3 getOrbitPosition(int light, float angle, float radius, float height);
+void simulate(const SimulationInput& input, SimulationState& state, RenderSnapshot& snapshot);
+
 int main() {
 	if (!glfwInit()) {
 		printf("glfw failed to init");
@@ -114,6 +220,7 @@ int main() {
 	glfwSetScrollCallback(window, mouseScrollCallback);
 	glfwSetCursorPosCallback(window, mousePosCallback);
 	glfwSetMouseButtonCallback(window, mouseButtonCallback);
+	glfwSetWindowRefreshCallback(window, windowRefreshCallback);
 
 	//Hide cursor
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -164,7 +271,6 @@ int main() {
 	ew::Transform sphereTransform;
 	ew::Transform planeTransform;
 	ew::Transform cylinderTransform;
-	ew::Transform lightTransform[3];
 
 	cubeTransform.position = glm::vec3(-2.0f, 0.0f, 0.0f);
 	sphereTransform.position = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -174,12 +280,14 @@ int main() {
 
 	cylinderTransform.position = glm::vec3(2.0f, 0.0f, 0.0f);
 
-	lightTransform[0].scale = glm::vec3(0.5f);
-	lightTransform[0].position = glm::vec3(0.0f, 5.0f, 0.0f);
-	lightTransform[1].scale = glm::vec3(0.5f);
-	lightTransform[1].position = glm::vec3(0.0f, 5.0f, 0.0f);
-	lightTransform[2].scale = glm::vec3(0.5f);
-	lightTransform[2].position = glm::vec3(0.0f, 5.0f, 0.0f);
+	//Radii are half the diagonal of each shape's bounds
+	SimulationState simulation;
+	simulation.objects.push_back({ &cubeMesh, cubeTransform, 0.866f, 0.0f, 0.0f, 0.0f });
+	simulation.objects.push_back({ &sphereMesh, sphereTransform, 0.5f, 0.0f, 0.0f, 0.0f });
+	simulation.objects.push_back({ &cylinderMesh, cylinderTransform, 0.707f, 0.0f, 0.0f, 0.0f });
+	simulation.objects.push_back({ &planeMesh, planeTransform, 0.707f, 0.0f, 0.0f, 0.0f });
+	simulation.numShapes = (int)simulation.objects.size();
+	simulation.extraMesh = &cubeMesh;
 
 	dirLight.color = glm::vec3(1, 1, 1);
 	dirLight.direction = glm::vec3(0, 1, 0);
@@ -208,98 +316,117 @@ int main() {
 	spotLight.innerAngle = 1.0;
 	spotLight.outerAngle = 10.0;
 
+	simulation.orbitAngle = 0;
+	for (int i = 0; i < 3; i++) {
+		simulation.lightPositions[i] = getOrbitPosition(i, simulation.orbitAngle, orbit, pointLights[i].position.y);
+		simulation.previousLightPositions[i] = simulation.lightPositions[i];
+	}
+
+	//The simulation writes one snapshot on the workers while this thread draws the other, so what's on screen is a frame behind
+	ew::JobSystem& jobs = ew::JobSystem::get();
+	RenderSnapshot snapshots[2];
+	int drawIndex = 0;
+	SimulationInput simulationInput;
+	ew::JobCounter simulationDone;
+	float waitMs = 0;
+	int numStolen = 0;
+
+	//Real time the steps haven't covered yet, always less than a step between frames
+	float accumulator = 0;
+	glm::vec3 previousCameraPosition = camera.getPosition();
+	//Steps and frames counted over about half a second
+	float rateStartTime = 0;
+	int rateSteps = 0;
+	int rateFrames = 0;
+	float stepsPerSecond = 0;
+	float framesPerSecond = 0;
+	//Share of wall time spent outside glfwWaitEventsTimeout and frames drawn, over about a second, so idling can be measured
+	double idleStartTime = glfwGetTime();
+	double idleSleptSeconds = 0;
+	int idleDrawnFrames = 0;
+	float awakePercent = 100;
+	float drawnPerSecond = 0;
+
+	captureSimulationInput(simulationInput);
+	simulationInput.numSteps = 0;
+	simulationInput.fixedDeltaTime = 1.0f / updateRate;
+	simulationInput.alpha = 1.0f;
+	simulate(simulationInput, simulation, snapshots[drawIndex]);
+	lastFrameTime = (float)glfwGetTime();
+
 	while (!glfwWindowShouldClose(window)) {
-		processInput(window);
-		glClearColor(bgColor.r, bgColor.g, bgColor.b, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		double now = glfwGetTime();
+		if (now - idleStartTime >= 1.0) {
+			awakePercent = 100.0f * (float)(1.0 - idleSleptSeconds / (now - idleStartTime));
+			drawnPerSecond = (float)(idleDrawnFrames / (now - idleStartTime));
+			idleStartTime = now;
+			idleSleptSeconds = 0;
+			idleDrawnFrames = 0;
+			//The UI isn't redrawn while idle, the title still is
+			if (onDemand) {
+				char title[128];
+				snprintf(title, sizeof(title), "Lighting - %.0f frames/s, awake %.0f%%", drawnPerSecond, awakePercent);
+				glfwSetWindowTitle(window, title);
+			}
+		}
 
-		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
+		//Anything still changing keeps a few frames coming after it stops, the pipelined frame on screen is a simulation
+		//behind and the camera is still blending toward where it stopped
+		bool animating = numPointLights > 0 || numExtraObjects > 0;
+		bool cameraMoving = previousCameraPosition != camera.getPosition() || isMovementKeyHeld(window);
+		if (animating || cameraMoving || ImGui::IsAnyItemActive()) {
+			redrawFrames = REDRAW_FRAMES_AFTER_EVENT;
+		}
+		//Nothing drawn would differ from what's on screen, sleep until an event or the timeout
+		if (onDemand && redrawFrames == 0) {
+			glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT);
+			idleSleptSeconds += glfwGetTime() - now;
+			//Nothing was moving, so the time asleep isn't owed to the simulation
+			lastFrameTime = (float)glfwGetTime();
+			continue;
+		}
+		idleDrawnFrames++;
+		if (redrawFrames > 0) {
+			redrawFrames--;
+		}
 
 		float time = (float)glfwGetTime();
 		deltaTime = time - lastFrameTime;
 		lastFrameTime = time;
 
-		//Draw
-		litShader.use();
-		litShader.setMat4("_Projection", camera.getProjectionMatrix());
-		litShader.setMat4("_View", camera.getViewMatrix());
-		litShader.setVec3("_Color", materialColor);
-
-		//Directional Light
-		litShader.setVec3("_DirLight.direction", glm::normalize(dirLight.direction));
-		litShader.setVec3("_DirLight.color", dirLight.color);
-		litShader.setFloat("_DirLight.intensity", dirLight.intensity);
-
-		//Point Lights
-		for (int i = 0; i < numPointLights; i++)
+		//As many whole steps as fit in the time since the last frame, the rest waits for the next one
+		float fixedDeltaTime = 1.0f / updateRate;
+		accumulator += deltaTime;
+		int numSteps = 0;
+		while (accumulator >= fixedDeltaTime && numSteps < MAX_STEPS_PER_FRAME)
 		{
-			pointLights[i].intensity = pointLightIntensity;
-			pointLights[i].range = range;
-			litShader.setVec3("_PointLights[" + std::to_string(i) + "].position", pointLights[i].position);
-			litShader.setVec3("_PointLights[" + std::to_string(i) + "].color", pointLights[i].color);
-			litShader.setFloat("_PointLights[" + std::to_string(i) + "].intensity", pointLights[i].intensity);
-			litShader.setFloat("_PointLights[" + std::to_string(i) + "].range", pointLights[i].range);
+			previousCameraPosition = camera.getPosition();
+			processInput(window, fixedDeltaTime);
+			accumulator -= fixedDeltaTime;
+			numSteps++;
+		}
+		if (accumulator >= fixedDeltaTime) {
+			accumulator = fmodf(accumulator, fixedDeltaTime);
+		}
+		float alpha = interpolate ? accumulator / fixedDeltaTime : 1.0f;
+
+		rateSteps += numSteps;
+		rateFrames++;
+		if (time - rateStartTime >= 0.5f) {
+			stepsPerSecond = rateSteps / (time - rateStartTime);
+			framesPerSecond = rateFrames / (time - rateStartTime);
+			rateStartTime = time;
+			rateSteps = rateFrames = 0;
 		}
-		litShader.setInt("numPointLights", numPointLights);
-
-		pointLights[0].position.x = sin(time) * orbit;
-		pointLights[0].position.z = cos(time) * orbit;
-
-		pointLights[1].position.x = -sin(time) * orbit;
-		pointLights[1].position.z = -cos(time) * orbit;
-
-		pointLights[2].position.x = cos(time) * orbit;
-		pointLights[2].position.z = cos(time) * orbit;
-
-		lightTransform[0].position = pointLights[0].position;
-		lightTransform[1].position = pointLights[1].position;
-		lightTransform[2].position = pointLights[2].position;
-
-		//spot light
-		litShader.setVec3("_SpotLight.position", spotLight.position);
-		litShader.setVec3("_SpotLight.direction", spotLight.direction);
-		litShader.setVec3("_SpotLight.color", spotLight.color);
-		litShader.setFloat("_SpotLight.intensity", spotLight.intensity);
-		litShader.setFloat("_SpotLight.radius", spotLight.radius);
-		litShader.setFloat("_SpotLight.innerAngle", cos(glm::radians(spotLight.innerAngle)));
-		litShader.setFloat("_SpotLight.outerAngle", cos(glm::radians(spotLight.outerAngle)));
-
-		litShader.setVec3("_CameraPos", camera.getPosition());
-		litShader.setFloat("_AmbientK", ambientK);
-		litShader.setFloat("_DiffuseK", diffuseK);
-		litShader.setFloat("_SpecularK", specularK);
-		litShader.setFloat("_Shininess", shininess);
-
-		//Draw cube
-		litShader.setMat4("_Model", cubeTransform.getModelMatrix());
-		cubeMesh.draw();
-
-		//Draw sphere
-		litShader.setMat4("_Model", sphereTransform.getModelMatrix());
-		sphereMesh.draw();
-
-		//Draw cylinder
-		litShader.setMat4("_Model", cylinderTransform.getModelMatrix());
-		cylinderMesh.draw();
 
-		//Draw plane
-		litShader.setMat4("_Model", planeTransform.getModelMatrix());
-		planeMesh.draw();
+		glClearColor(bgColor.r, bgColor.g, bgColor.b, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		//Draw light as a small sphere using unlit shader, ironically.
-		for (int i = 0; i < numPointLights; i++)
-		{
-			unlitShader.use();
-			unlitShader.setMat4("_Projection", camera.getProjectionMatrix());
-			unlitShader.setMat4("_View", camera.getViewMatrix());
-			unlitShader.setMat4("_Model", lightTransform[i].getModelMatrix());
-			unlitShader.setVec3("_Color", pointLights[i].color);
-			sphereMesh.draw();
-		}
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui_ImplGlfw_NewFrame();
+		ImGui::NewFrame();
 
-		//Draw UI
+		//Draw UI, before the simulation starts so it sees this frame's settings
 		ImGui::Begin("Settings");
 		ImGui::SliderFloat("Material Ambient K", &ambientK, 0, 1);
 		ImGui::SliderFloat("Material Diffuse K", &diffuseK, 0, 1);
@@ -331,21 +458,248 @@ int main() {
 			ImGui::SliderFloat("Outer Angle", &spotLight.outerAngle, 1, 360);
 		}
 
+		if (ImGui::CollapsingHeader("Pipeline"))
+		{
+			ImGui::Checkbox("Pipelined", &pipelined);
+			ImGui::SliderInt("Extra Objects", &numExtraObjects, 0, MAX_EXTRA_OBJECTS);
+			ImGui::Text("%d threads, %d jobs stolen last frame", jobs.getNumThreads(), numStolen);
+			const RenderSnapshot& shown = snapshots[drawIndex];
+			ImGui::Text("Simulation: %.2f ms, drew %d of %d objects", shown.simulationMs, (int)shown.draws.size(), shown.numObjects);
+			ImGui::Text("Waited %.2f ms for it", waitMs);
+		}
+
+		if (ImGui::CollapsingHeader("Fixed Timestep"))
+		{
+			ImGui::SliderFloat("Update Rate (Hz)", &updateRate, 10, 240);
+			ImGui::Checkbox("Interpolate", &interpolate);
+			ImGui::Text("Updating %.0f times a second, rendering %.0f", stepsPerSecond, framesPerSecond);
+			ImGui::Text("%d steps this frame, %.2f ms of simulation in them", numSteps, snapshots[drawIndex].stepMs);
+		}
+
+		if (ImGui::CollapsingHeader("On Demand Rendering"))
+		{
+			if (ImGui::Checkbox("Render On Demand", &onDemand) && !onDemand) {
+				glfwSetWindowTitle(window, "Lighting");
+			}
+			ImGui::Text("Drew %.0f frames a second, awake %.0f%% of the time", drawnPerSecond, awakePercent);
+		}
+
 		ImGui::End();
 
+		//Next frame's simulation and culling
+		int simulateIndex = 1 - drawIndex;
+		captureSimulationInput(simulationInput);
+		simulationInput.numSteps = numSteps;
+		simulationInput.fixedDeltaTime = fixedDeltaTime;
+		simulationInput.alpha = alpha;
+		simulationInput.camera.setPosition(glm::mix(previousCameraPosition, camera.getPosition(), alpha));
+		jobs.run([&, simulateIndex]() { simulate(simulationInput, simulation, snapshots[simulateIndex]); }, simulationDone);
+		if (!pipelined) {
+			jobs.wait(simulationDone);
+			drawIndex = simulateIndex;
+		}
+		const RenderSnapshot& frame = snapshots[drawIndex];
+
+		//Draw
+		litShader.use();
+		litShader.setMat4("_Projection", frame.projection);
+		litShader.setMat4("_View", frame.view);
+		litShader.setVec3("_Color", materialColor);
+
+		//Directional Light
+		litShader.setVec3("_DirLight.direction", glm::normalize(frame.dirLight.direction));
+		litShader.setVec3("_DirLight.color", frame.dirLight.color);
+		litShader.setFloat("_DirLight.intensity", frame.dirLight.intensity);
+
+		//Point Lights
+		for (int i = 0; i < frame.numPointLights; i++)
+		{
+			litShader.setVec3("_PointLights[" + std::to_string(i) + "].position", frame.pointLights[i].position);
+			litShader.setVec3("_PointLights[" + std::to_string(i) + "].color", frame.pointLights[i].color);
+			litShader.setFloat("_PointLights[" + std::to_string(i) + "].intensity", frame.pointLights[i].intensity);
+			litShader.setFloat("_PointLights[" + std::to_string(i) + "].range", frame.pointLights[i].range);
+		}
+		litShader.setInt("numPointLights", frame.numPointLights);
+
+		//spot light
+		litShader.setVec3("_SpotLight.position", frame.spotLight.position);
+		litShader.setVec3("_SpotLight.direction", frame.spotLight.direction);
+		litShader.setVec3("_SpotLight.color", frame.spotLight.color);
+		litShader.setFloat("_SpotLight.intensity", frame.spotLight.intensity);
+		litShader.setFloat("_SpotLight.radius", frame.spotLight.radius);
+		litShader.setFloat("_SpotLight.innerAngle", cos(glm::radians(frame.spotLight.innerAngle)));
+		litShader.setFloat("_SpotLight.outerAngle", cos(glm::radians(frame.spotLight.outerAngle)));
+
+		litShader.setVec3("_CameraPos", frame.cameraPosition);
+		litShader.setFloat("_AmbientK", ambientK);
+		litShader.setFloat("_DiffuseK", diffuseK);
+		litShader.setFloat("_SpecularK", specularK);
+		litShader.setFloat("_Shininess", shininess);
+
+		//Shapes and extra objects
+		for (size_t i = 0; i < frame.draws.size(); i++)
+		{
+			litShader.setMat4("_Model", frame.draws[i].model);
+			frame.draws[i].mesh->draw();
+		}
+
+		//Draw light as a small sphere using unlit shader, ironically.
+		for (int i = 0; i < frame.numPointLights; i++)
+		{
+			unlitShader.use();
+			unlitShader.setMat4("_Projection", frame.projection);
+			unlitShader.setMat4("_View", frame.view);
+			unlitShader.setMat4("_Model", frame.lightModels[i]);
+			unlitShader.setVec3("_Color", frame.pointLights[i].color);
+			sphereMesh.draw();
+		}
+
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 		glfwPollEvents();
 
 		glfwSwapBuffers(window);
+
+		if (pipelined) {
+			std::chrono::high_resolution_clock::time_point waitStart = std::chrono::high_resolution_clock::now();
+			jobs.wait(simulationDone);
+			std::chrono::duration<float, std::milli> waited = std::chrono::high_resolution_clock::now() - waitStart;
+			waitMs = waited.count();
+			drawIndex = simulateIndex;
+		}
+		else {
+			waitMs = 0;
+		}
+		numStolen = jobs.takeNumStolen();
 	}
 
 	glfwTerminate();
 	return 0;
 }
+//Author: Sam Fox
+//Copies what the simulation reads, on the main thread
+void captureSimulationInput(SimulationInput& input)
+{
+	input.camera = camera;
+	input.dirLight = dirLight;
+	for (int i = 0; i < 3; i++) {
+		input.pointLights[i] = pointLights[i];
+	}
+	input.spotLight = spotLight;
+	input.numPointLights = numPointLights;
+	input.pointLightIntensity = pointLightIntensity;
+	input.range = range;
+	input.orbit = orbit;
+	input.numExtraObjects = numExtraObjects;
+}
+//Author: Sam Fox
+//Where each point light circles the origin
+glm::vec3 getOrbitPosition(int light, float angle, float radius, float height)
+{
+	switch (light) {
+	case 0:
+		return glm::vec3(sin(angle) * radius, height, cos(angle) * radius);
+	case 1:
+		return glm::vec3(-sin(angle) * radius, height, -cos(angle) * radius);
+	default:
+		return glm::vec3(cos(angle) * radius, height, cos(angle) * radius);
+	}
+}
+//Author: Sam Fox
+//Takes input.numSteps fixed steps, then culls everything where it is input.alpha of the way from the step before the
+//last to the last one. Runs as a job, so no GL in here
+void simulate(const SimulationInput& input, SimulationState& state, RenderSnapshot& snapshot)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	ew::JobSystem& jobs = ew::JobSystem::get();
+
+	int numObjects = state.numShapes + input.numExtraObjects;
+	while ((int)state.objects.size() < numObjects)
+	{
+		int extra = (int)state.objects.size() - state.numShapes;
+		SceneObject object = { state.extraMesh, ew::Transform(), 0.866f, 0.5f + (extra % 7) * 0.25f, 0.0f, 0.0f };
+		object.transform.position = glm::vec3((extra % EXTRA_GRID_WIDTH - EXTRA_GRID_WIDTH / 2) * EXTRA_SPACING, 0.0f, -4.0f - (extra / EXTRA_GRID_WIDTH) * EXTRA_SPACING);
+		object.transform.scale = glm::vec3(0.5f);
+		state.objects.push_back(object);
+	}
+	state.objects.resize(numObjects);
+	state.models.resize(numObjects);
+	state.visible.resize(numObjects);
+
+	float dt = input.fixedDeltaTime;
+	for (int step = 0; step < input.numSteps; step++)
+	{
+		jobs.parallelFor(numObjects, 1024, [&](int begin, int end) {
+			for (int i = begin; i < end; i++)
+			{
+				SceneObject& object = state.objects[i];
+				object.previousSpin = object.spin;
+				object.spin += object.spinSpeed * dt;
+			}
+		});
+		//One radian a second
+		state.orbitAngle += dt;
+		for (int i = 0; i < 3; i++) {
+			state.previousLightPositions[i] = state.lightPositions[i];
+			state.lightPositions[i] = getOrbitPosition(i, state.orbitAngle, input.orbit, input.pointLights[i].position.y);
+		}
+	}
+	std::chrono::duration<float, std::milli> stepped = std::chrono::high_resolution_clock::now() - start;
+
+	float alpha = input.alpha;
+	Camera camera = input.camera;
+	const ew::Frustum& frustum = camera.getFrustum();
+	jobs.parallelFor(numObjects, 256, [&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+		{
+			SceneObject& object = state.objects[i];
+			object.transform.rotation.y = glm::mix(object.previousSpin, object.spin, alpha);
+			glm::mat4 model = object.transform.getModelMatrix();
+			glm::vec3 scale = object.transform.scale;
+			float radius = object.radius * glm::max(scale.x, glm::max(scale.y, scale.z));
+			state.models[i] = model;
+			state.visible[i] = frustum.intersectsSphere(glm::vec3(model[3]), radius) ? 1 : 0;
+		}
+	});
+
+	snapshot.draws.clear();
+	for (int i = 0; i < numObjects; i++)
+	{
+		if (state.visible[i]) {
+			DrawCall draw = { state.objects[i].mesh, state.models[i] };
+			snapshot.draws.push_back(draw);
+		}
+	}
+	snapshot.numObjects = numObjects;
+
+	snapshot.view = camera.getViewMatrix();
+	snapshot.projection = camera.getProjectionMatrix();
+	snapshot.cameraPosition = camera.getPosition();
+	snapshot.dirLight = input.dirLight;
+	snapshot.spotLight = input.spotLight;
+
+	snapshot.numPointLights = input.numPointLights;
+	for (int i = 0; i < 3; i++)
+	{
+		snapshot.pointLights[i] = input.pointLights[i];
+		snapshot.pointLights[i].intensity = input.pointLightIntensity;
+		snapshot.pointLights[i].range = input.range;
+		snapshot.pointLights[i].position = glm::mix(state.previousLightPositions[i], state.lightPositions[i], alpha);
+
+		ew::Transform lightTransform;
+		lightTransform.position = snapshot.pointLights[i].position;
+		lightTransform.scale = glm::vec3(0.5f);
+		snapshot.lightModels[i] = lightTransform.getModelMatrix();
+	}
+
+	std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	snapshot.simulationMs = elapsed.count();
+	snapshot.stepMs = stepped.count();
+}
 //Author: Eric Winebrenner
 void resizeFrameBufferCallback(GLFWwindow* window, int width, int height)
 {
+	redrawFrames = REDRAW_FRAMES_AFTER_EVENT;
 	SCREEN_WIDTH = width;
 	SCREEN_HEIGHT = height;
 	camera.setAspectRatio((float)SCREEN_WIDTH / SCREEN_HEIGHT);
@@ -354,6 +708,7 @@ void resizeFrameBufferCallback(GLFWwindow* window, int width, int height)
 //Author: Eric Winebrenner
 void keyboardCallback(GLFWwindow* window, int keycode, int scancode, int action, int mods)
 {
+	redrawFrames = REDRAW_FRAMES_AFTER_EVENT;
 	if (keycode == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
 		glfwSetWindowShouldClose(window, true);
 	}
@@ -372,6 +727,7 @@ void keyboardCallback(GLFWwindow* window, int keycode, int scancode, int action,
 //Author: Eric Winebrenner
 void mouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
 {
+	redrawFrames = REDRAW_FRAMES_AFTER_EVENT;
 	if (abs(yoffset) > 0) {
 		float fov = camera.getFov() - (float)yoffset * CAMERA_ZOOM_SPEED;
 		camera.setFov(fov);
@@ -380,6 +736,7 @@ void mouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
 //Author: Eric Winebrenner
 void mousePosCallback(GLFWwindow* window, double xpos, double ypos)
 {
+	redrawFrames = REDRAW_FRAMES_AFTER_EVENT;
 	if (glfwGetInputMode(window, GLFW_CURSOR) != GLFW_CURSOR_DISABLED) {
 		return;
 	}
@@ -399,6 +756,7 @@ void mousePosCallback(GLFWwindow* window, double xpos, double ypos)
 //Author: Eric Winebrenner
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 {
+	redrawFrames = REDRAW_FRAMES_AFTER_EVENT;
 	//Toggle cursor lock
 	if (button == MOUSE_TOGGLE_BUTTON && action == GLFW_PRESS) {
 		int inputMode = glfwGetInputMode(window, GLFW_CURSOR) == GLFW_CURSOR_DISABLED ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED;
@@ -406,6 +764,12 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 		glfwGetCursorPos(window, &prevMouseX, &prevMouseY);
 	}
 }
+//Author: Sam Fox
+//The window was uncovered or resized, what's on screen may be gone
+void windowRefreshCallback(GLFWwindow* window)
+{
+	redrawFrames = REDRAW_FRAMES_AFTER_EVENT;
+}
 
 //Author: Eric Winebrenner
 //Returns -1, 0, or 1 depending on keys held
@@ -421,10 +785,10 @@ float getAxis(GLFWwindow* window, int positiveKey, int negativeKey) {
 }
 
 //Author: Eric Winebrenner
-//Get input every frame
-void processInput(GLFWwindow* window) {
+//Get input every fixed step
+void processInput(GLFWwindow* window, float dt) {
 
-	float moveAmnt = CAMERA_MOVE_SPEED * deltaTime;
+	float moveAmnt = CAMERA_MOVE_SPEED * dt;
 
 	//Get camera vectors
 	glm::vec3 forward = camera.getForward();
@@ -437,3 +801,10 @@ void processInput(GLFWwindow* window) {
 	position += up * getAxis(window, GLFW_KEY_Q, GLFW_KEY_E) * moveAmnt;
 	camera.setPosition(position);
 }
+
+//Author: Sam Fox
+//Whether processInput would move the camera, a held key sends no events to wake the loop
+bool isMovementKeyHeld(GLFWwindow* window) {
+	return getAxis(window, GLFW_KEY_W, GLFW_KEY_S) != 0.0f || getAxis(window, GLFW_KEY_D, GLFW_KEY_A) != 0.0f
+		|| getAxis(window, GLFW_KEY_Q, GLFW_KEY_E) != 0.0f;
+}
@@ -0,0 +1,497 @@
+//Author: Sam Fox
+
+#include "FrameGraph.h"
+#include <algorithm>
+#include <stdio.h>
+#include "../imgui/imgui.h"
+
+namespace ew {
+	static GLenum getDepthAttachmentPoint(GLenum format)
+	{
+		return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+	}
+
+	//What a read needs after a shader wrote the resource. Attachment and copy writes are ordered by GL already
+	static GLbitfield getBarrierBit(FrameAccess access)
+	{
+		switch (access) {
+		case FRAME_ACCESS_SAMPLED:
+			return GL_TEXTURE_FETCH_BARRIER_BIT;
+		case FRAME_ACCESS_IMAGE:
+			return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+		case FRAME_ACCESS_STORAGE:
+			return GL_SHADER_STORAGE_BARRIER_BIT;
+		case FRAME_ACCESS_INDIRECT:
+			return GL_COMMAND_BARRIER_BIT;
+		case FRAME_ACCESS_COPY:
+			return GL_TEXTURE_UPDATE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT;
+		case FRAME_ACCESS_ATTACHMENT:
+			return GL_FRAMEBUFFER_BARRIER_BIT;
+		}
+		return 0;
+	}
+
+	static bool isShaderWrite(FrameAccess access)
+	{
+		return access == FRAME_ACCESS_IMAGE || access == FRAME_ACCESS_STORAGE;
+	}
+
+	static const char* getAccessName(FrameAccess access)
+	{
+		static const char* names[] = { "sampled", "image", "storage", "indirect", "copy", "attachment" };
+		return names[access];
+	}
+
+	FrameGraph::FrameGraph(int screenWidth, int screenHeight)
+		: mScreenWidth(screenWidth), mScreenHeight(screenHeight), mDirty(true), mNumCulledPasses(0), mNumTransientTextures(0), mNumBarriers(0)
+	{
+	}
+
+	FrameGraph::~FrameGraph()
+	{
+		deleteFramebuffers();
+		for (size_t i = 0; i < mTextures.size(); i++) {
+			glDeleteTextures(1, &mTextures[i].texture);
+		}
+	}
+
+	int FrameGraph::createTexture(const char* name, const FrameTextureDesc& desc)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.type = RESOURCE_TEXTURE;
+		resource.desc = desc;
+		resource.texture = 0;
+		resource.width = resource.height = 0;
+		resource.allocation = -1;
+		mResources.push_back(resource);
+		mDirty = true;
+		return (int)mResources.size() - 1;
+	}
+
+	int FrameGraph::importTexture(const char* name, GLuint texture, int width, int height)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.type = RESOURCE_IMPORTED_TEXTURE;
+		resource.texture = texture;
+		resource.width = width;
+		resource.height = height;
+		resource.allocation = -1;
+		mResources.push_back(resource);
+		mDirty = true;
+		return (int)mResources.size() - 1;
+	}
+
+	int FrameGraph::importExternal(const char* name)
+	{
+		int resource = importTexture(name, 0, 0, 0);
+		mResources[resource].type = RESOURCE_EXTERNAL;
+		return resource;
+	}
+
+	int FrameGraph::importFramebuffer(const char* name, GLuint framebuffer)
+	{
+		int resource = importTexture(name, 0, mScreenWidth, mScreenHeight);
+		mResources[resource].type = RESOURCE_FRAMEBUFFER;
+		//Kept in texture, there's nothing else to keep for it
+		mResources[resource].texture = framebuffer;
+		return resource;
+	}
+
+	int FrameGraph::addPass(const char* name, ExecuteFunc execute)
+	{
+		Pass pass;
+		pass.name = name;
+		pass.execute = execute;
+		pass.depthAttachment = -1;
+		pass.sideEffect = false;
+		pass.enabled = true;
+		pass.culled = false;
+		pass.barrier = 0;
+		pass.framebuffer = 0;
+		pass.width = pass.height = 0;
+		mPasses.push_back(pass);
+		mDirty = true;
+		return (int)mPasses.size() - 1;
+	}
+
+	void FrameGraph::read(int pass, int resource, FrameAccess access)
+	{
+		Access read = { resource, access };
+		mPasses[pass].reads.push_back(read);
+		mDirty = true;
+	}
+
+	void FrameGraph::write(int pass, int resource, FrameAccess access)
+	{
+		Access write = { resource, access };
+		mPasses[pass].writes.push_back(write);
+		mDirty = true;
+	}
+
+	void FrameGraph::writeColor(int pass, int resource)
+	{
+		if ((int)mPasses[pass].colorAttachments.size() >= MAX_COLOR_ATTACHMENTS) {
+			printf("FrameGraph: %s has more than %d color attachments\n", mPasses[pass].name.c_str(), MAX_COLOR_ATTACHMENTS);
+			return;
+		}
+		mPasses[pass].colorAttachments.push_back(resource);
+		write(pass, resource, FRAME_ACCESS_ATTACHMENT);
+	}
+
+	void FrameGraph::writeDepth(int pass, int resource)
+	{
+		mPasses[pass].depthAttachment = resource;
+		write(pass, resource, FRAME_ACCESS_ATTACHMENT);
+	}
+
+	void FrameGraph::setSideEffect(int pass)
+	{
+		mPasses[pass].sideEffect = true;
+		mDirty = true;
+	}
+
+	void FrameGraph::setEnabled(int pass, bool enabled)
+	{
+		if (mPasses[pass].enabled != enabled) {
+			mPasses[pass].enabled = enabled;
+			mDirty = true;
+		}
+	}
+
+	void FrameGraph::setScreenSize(int width, int height)
+	{
+		if (width != mScreenWidth || height != mScreenHeight) {
+			mScreenWidth = width;
+			mScreenHeight = height;
+			mDirty = true;
+		}
+	}
+
+	void FrameGraph::execute()
+	{
+		if (mDirty) {
+			compile();
+			mDirty = false;
+		}
+		for (size_t i = 0; i < mPasses.size(); i++) {
+			Pass& pass = mPasses[i];
+			if (!pass.enabled || pass.culled) {
+				continue;
+			}
+			if (pass.barrier != 0) {
+				glMemoryBarrier(pass.barrier);
+			}
+			if (!pass.colorAttachments.empty() || pass.depthAttachment >= 0) {
+				glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+				glViewport(0, 0, pass.width, pass.height);
+			}
+			pass.execute();
+		}
+	}
+
+	void FrameGraph::compile()
+	{
+		for (size_t i = 0; i < mResources.size(); i++) {
+			if (mResources[i].type == RESOURCE_FRAMEBUFFER) {
+				mResources[i].width = mScreenWidth;
+				mResources[i].height = mScreenHeight;
+			}
+		}
+		cullPasses();
+		allocateTextures();
+		createFramebuffers();
+		placeBarriers();
+	}
+
+	void FrameGraph::cullPasses()
+	{
+		//Backwards from what's visible. A pass stays if something later still needs what it writes, and then
+		//everything it reads is needed too. Writes never end a resource's life, a pass may draw on top of what's there
+		std::vector<bool> needed(mResources.size(), false);
+		for (size_t i = 0; i < mResources.size(); i++) {
+			needed[i] = mResources[i].type == RESOURCE_FRAMEBUFFER;
+		}
+		mNumCulledPasses = 0;
+		for (int i = (int)mPasses.size() - 1; i >= 0; i--) {
+			Pass& pass = mPasses[i];
+			if (!pass.enabled) {
+				pass.culled = false;
+				continue;
+			}
+			bool keep = pass.sideEffect;
+			for (size_t w = 0; w < pass.writes.size() && !keep; w++) {
+				keep = needed[pass.writes[w].resource];
+			}
+			pass.culled = !keep;
+			if (pass.culled) {
+				mNumCulledPasses++;
+				continue;
+			}
+			for (size_t r = 0; r < pass.reads.size(); r++) {
+				needed[pass.reads[r].resource] = true;
+			}
+		}
+	}
+
+	void FrameGraph::allocateTextures()
+	{
+		//Lifetime of every owned texture, first to last pass that runs and touches it
+		std::vector<int> firstUse(mResources.size(), -1), lastUse(mResources.size(), -1);
+		for (int i = 0; i < (int)mPasses.size(); i++) {
+			const Pass& pass = mPasses[i];
+			if (!pass.enabled || pass.culled) {
+				continue;
+			}
+			for (int list = 0; list < 2; list++) {
+				const std::vector<Access>& accesses = list == 0 ? pass.reads : pass.writes;
+				for (size_t a = 0; a < accesses.size(); a++) {
+					int resource = accesses[a].resource;
+					if (firstUse[resource] < 0) {
+						firstUse[resource] = i;
+					}
+					lastUse[resource] = i;
+				}
+			}
+		}
+
+		std::vector<int> order;
+		for (size_t i = 0; i < mResources.size(); i++) {
+			Resource& resource = mResources[i];
+			if (resource.type != RESOURCE_TEXTURE) {
+				continue;
+			}
+			resource.allocation = -1;
+			resource.texture = 0;
+			if (firstUse[i] < 0) {
+				resource.width = resource.height = 0;
+				continue;
+			}
+			if (resource.desc.screenScale > 0.0f) {
+				resource.width = std::max(1, (int)(mScreenWidth * resource.desc.screenScale));
+				resource.height = std::max(1, (int)(mScreenHeight * resource.desc.screenScale));
+			}
+			else {
+				resource.width = resource.desc.width;
+				resource.height = resource.desc.height;
+			}
+			order.push_back((int)i);
+		}
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return firstUse[a] < firstUse[b]; });
+		mNumTransientTextures = (int)order.size();
+
+		//Greedy, each texture goes into the first matching allocation that's free by the time it's needed.
+		//Allocations from the last compile are tried first so toggling a pass doesn't reallocate anything
+		std::vector<bool> used(mTextures.size(), false);
+		for (size_t i = 0; i < mTextures.size(); i++) {
+			mTextures[i].busyUntil = -1;
+		}
+		for (size_t o = 0; o < order.size(); o++) {
+			Resource& resource = mResources[order[o]];
+			int found = -1;
+			for (size_t t = 0; t < mTextures.size() && found < 0; t++) {
+				const Allocation& allocation = mTextures[t];
+				if (allocation.busyUntil < firstUse[order[o]] && allocation.format == resource.desc.format
+					&& allocation.width == resource.width && allocation.height == resource.height
+					&& allocation.filter == resource.desc.filter && allocation.wrap == resource.desc.wrap) {
+					found = (int)t;
+				}
+			}
+			if (found < 0) {
+				Allocation allocation;
+				allocation.format = resource.desc.format;
+				allocation.width = resource.width;
+				allocation.height = resource.height;
+				allocation.filter = resource.desc.filter;
+				allocation.wrap = resource.desc.wrap;
+				//Direct state access, so whatever is bound on the active unit stays bound
+				glCreateTextures(GL_TEXTURE_2D, 1, &allocation.texture);
+				glTextureStorage2D(allocation.texture, 1, allocation.format, allocation.width, allocation.height);
+				glTextureParameteri(allocation.texture, GL_TEXTURE_MIN_FILTER, allocation.filter);
+				glTextureParameteri(allocation.texture, GL_TEXTURE_MAG_FILTER, allocation.filter);
+				glTextureParameteri(allocation.texture, GL_TEXTURE_WRAP_S, allocation.wrap);
+				glTextureParameteri(allocation.texture, GL_TEXTURE_WRAP_T, allocation.wrap);
+				mTextures.push_back(allocation);
+				used.push_back(false);
+				found = (int)mTextures.size() - 1;
+			}
+			mTextures[found].busyUntil = lastUse[order[o]];
+			used[found] = true;
+			resource.allocation = found;
+		}
+
+		//Whatever nothing fits anymore, e.g. everything the old screen size needed
+		std::vector<int> remap(mTextures.size(), -1);
+		std::vector<Allocation> kept;
+		for (size_t t = 0; t < mTextures.size(); t++) {
+			if (used[t]) {
+				remap[t] = (int)kept.size();
+				kept.push_back(mTextures[t]);
+			}
+			else {
+				glDeleteTextures(1, &mTextures[t].texture);
+			}
+		}
+		mTextures.swap(kept);
+		for (size_t o = 0; o < order.size(); o++) {
+			Resource& resource = mResources[order[o]];
+			resource.allocation = remap[resource.allocation];
+			resource.texture = mTextures[resource.allocation].texture;
+		}
+	}
+
+	void FrameGraph::createFramebuffers()
+	{
+		deleteFramebuffers();
+		for (size_t i = 0; i < mPasses.size(); i++) {
+			Pass& pass = mPasses[i];
+			if (!pass.enabled || pass.culled || (pass.colorAttachments.empty() && pass.depthAttachment < 0)) {
+				continue;
+			}
+			int first = pass.depthAttachment >= 0 ? pass.depthAttachment : pass.colorAttachments[0];
+			pass.width = mResources[first].width;
+			pass.height = mResources[first].height;
+
+			//The screen's framebuffer already has everything attached, it can't be mixed with anything else
+			bool screen = false;
+			for (size_t c = 0; c < pass.colorAttachments.size(); c++) {
+				screen = screen || mResources[pass.colorAttachments[c]].type == RESOURCE_FRAMEBUFFER;
+			}
+			if (screen) {
+				if (pass.colorAttachments.size() > 1 || pass.depthAttachment >= 0) {
+					printf("FrameGraph: %s draws to %s along with other attachments\n", pass.name.c_str(), mResources[pass.colorAttachments[0]].name.c_str());
+				}
+				pass.framebuffer = mResources[pass.colorAttachments[0]].texture;
+				pass.width = mResources[pass.colorAttachments[0]].width;
+				pass.height = mResources[pass.colorAttachments[0]].height;
+				continue;
+			}
+
+			glCreateFramebuffers(1, &pass.framebuffer);
+			GLenum buffers[MAX_COLOR_ATTACHMENTS];
+			for (size_t c = 0; c < pass.colorAttachments.size(); c++) {
+				const Resource& resource = mResources[pass.colorAttachments[c]];
+				glNamedFramebufferTexture(pass.framebuffer, GL_COLOR_ATTACHMENT0 + (GLenum)c, resource.texture, 0);
+				buffers[c] = GL_COLOR_ATTACHMENT0 + (GLenum)c;
+				if (resource.width != pass.width || resource.height != pass.height) {
+					printf("FrameGraph: %s attachments aren't all the same size\n", pass.name.c_str());
+				}
+			}
+			if (pass.depthAttachment >= 0) {
+				const Resource& resource = mResources[pass.depthAttachment];
+				GLenum format = resource.type == RESOURCE_TEXTURE ? resource.desc.format : GL_DEPTH_COMPONENT24;
+				glNamedFramebufferTexture(pass.framebuffer, getDepthAttachmentPoint(format), resource.texture, 0);
+			}
+			if (pass.colorAttachments.empty()) {
+				glNamedFramebufferDrawBuffer(pass.framebuffer, GL_NONE);
+				glNamedFramebufferReadBuffer(pass.framebuffer, GL_NONE);
+			}
+			else {
+				glNamedFramebufferDrawBuffers(pass.framebuffer, (GLsizei)pass.colorAttachments.size(), buffers);
+			}
+			GLenum status = glCheckNamedFramebufferStatus(pass.framebuffer, GL_FRAMEBUFFER);
+			if (status != GL_FRAMEBUFFER_COMPLETE) {
+				printf("FrameGraph: %s framebuffer is incomplete (0x%x)\n", pass.name.c_str(), status);
+			}
+		}
+	}
+
+	void FrameGraph::placeBarriers()
+	{
+		//Per resource, whether its last write came from a shader and which barrier bits have gone in since
+		std::vector<bool> written(mResources.size(), false);
+		std::vector<bool> shaderWritten(mResources.size(), false);
+		std::vector<GLbitfield> covered(mResources.size(), 0);
+		mNumBarriers = 0;
+		for (size_t i = 0; i < mPasses.size(); i++) {
+			Pass& pass = mPasses[i];
+			pass.barrier = 0;
+			if (!pass.enabled || pass.culled) {
+				continue;
+			}
+			for (size_t r = 0; r < pass.reads.size(); r++) {
+				int resource = pass.reads[r].resource;
+				if (!written[resource] && mResources[resource].type == RESOURCE_TEXTURE) {
+					printf("FrameGraph: %s reads %s before anything writes it\n", pass.name.c_str(), mResources[resource].name.c_str());
+				}
+				if (shaderWritten[resource] && (covered[resource] & getBarrierBit(pass.reads[r].access)) == 0) {
+					pass.barrier |= getBarrierBit(pass.reads[r].access);
+				}
+				for (size_t w = 0; w < pass.writes.size(); w++) {
+					if (pass.writes[w].resource == resource && pass.writes[w].access == FRAME_ACCESS_ATTACHMENT) {
+						printf("FrameGraph: %s samples %s while drawing into it\n", pass.name.c_str(), mResources[resource].name.c_str());
+					}
+				}
+			}
+			//A pass drawing on top of what a shader wrote needs it visible to the framebuffer too
+			for (size_t w = 0; w < pass.writes.size(); w++) {
+				int resource = pass.writes[w].resource;
+				if (shaderWritten[resource] && (covered[resource] & getBarrierBit(pass.writes[w].access)) == 0) {
+					pass.barrier |= getBarrierBit(pass.writes[w].access);
+				}
+			}
+			//A barrier covers every write before it, not just the ones this pass reads
+			if (pass.barrier != 0) {
+				mNumBarriers++;
+				for (size_t r = 0; r < mResources.size(); r++) {
+					covered[r] |= pass.barrier;
+				}
+			}
+			for (size_t w = 0; w < pass.writes.size(); w++) {
+				int resource = pass.writes[w].resource;
+				written[resource] = true;
+				shaderWritten[resource] = isShaderWrite(pass.writes[w].access);
+				covered[resource] = 0;
+			}
+		}
+	}
+
+	void FrameGraph::deleteFramebuffers()
+	{
+		for (size_t i = 0; i < mPasses.size(); i++) {
+			Pass& pass = mPasses[i];
+			bool owned = pass.framebuffer != 0;
+			for (size_t c = 0; c < pass.colorAttachments.size() && owned; c++) {
+				owned = mResources[pass.colorAttachments[c]].type != RESOURCE_FRAMEBUFFER;
+			}
+			if (owned) {
+				glDeleteFramebuffers(1, &pass.framebuffer);
+			}
+			pass.framebuffer = 0;
+		}
+	}
+
+	void FrameGraph::drawImGui()
+	{
+		if (!ImGui::CollapsingHeader("Frame Graph")) {
+			return;
+		}
+		ImGui::Text("%d passes, %d culled, %d barriers", (int)mPasses.size(), mNumCulledPasses, mNumBarriers);
+		ImGui::Text("%d textures in %d allocations, %dx%d screen", mNumTransientTextures, getNumAllocatedTextures(), mScreenWidth, mScreenHeight);
+		for (size_t i = 0; i < mPasses.size(); i++) {
+			const Pass& pass = mPasses[i];
+			const char* state = !pass.enabled ? " (disabled)" : pass.culled ? " (culled)" : "";
+			if (!ImGui::TreeNode(pass.name.c_str(), "%s%s", pass.name.c_str(), state)) {
+				continue;
+			}
+			if (pass.barrier != 0) {
+				ImGui::Text("Barrier 0x%x", pass.barrier);
+			}
+			for (int list = 0; list < 2; list++) {
+				const std::vector<Access>& accesses = list == 0 ? pass.reads : pass.writes;
+				for (size_t a = 0; a < accesses.size(); a++) {
+					const Resource& resource = mResources[accesses[a].resource];
+					if (resource.type == RESOURCE_TEXTURE) {
+						ImGui::Text("%s %s (%s) %dx%d, texture %u", list == 0 ? "Reads" : "Writes", resource.name.c_str(),
+							getAccessName(accesses[a].access), resource.width, resource.height, resource.texture);
+					}
+					else {
+						ImGui::Text("%s %s (%s)", list == 0 ? "Reads" : "Writes", resource.name.c_str(), getAccessName(accesses[a].access));
+					}
+				}
+			}
+			ImGui::TreePop();
+		}
+	}
+}
@@ -0,0 +1,154 @@
+//Author: Sam Fox
+
+#pragma once
+#include <GL/glew.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ew {
+	//How a pass touches a resource. Decides which glMemoryBarrier bit a read needs after a shader wrote it
+	enum FrameAccess {
+		//Sampled through a texture unit
+		FRAME_ACCESS_SAMPLED,
+		//Image load/store
+		FRAME_ACCESS_IMAGE,
+		//Shader storage buffer
+		FRAME_ACCESS_STORAGE,
+		//Indirect draw or dispatch arguments
+		FRAME_ACCESS_INDIRECT,
+		//Uploads and copies, glTexSubImage2D, glBufferSubData and the like
+		FRAME_ACCESS_COPY,
+		//Framebuffer attachment, use writeColor/writeDepth
+		FRAME_ACCESS_ATTACHMENT
+	};
+
+	/// <summary>
+	/// Texture the graph creates. A screenScale above 0 sizes it to the screen times that and ignores width and height,
+	/// so it's recreated whenever the screen size changes
+	/// </summary>
+	struct FrameTextureDesc {
+		GLenum format = GL_RGBA8;
+		int width = 0;
+		int height = 0;
+		float screenScale = 0.0f;
+		GLenum filter = GL_LINEAR;
+		GLenum wrap = GL_CLAMP_TO_EDGE;
+	};
+
+	/// <summary>
+	/// Passes declare what they read and write, the graph works out the rest when something changes:
+	/// passes nothing visible depends on are culled, textures the graph owns are created at the current screen size and
+	/// ones whose lifetimes don't overlap share a GL texture, each pass with attachments gets a framebuffer, and a
+	/// glMemoryBarrier goes in front of any pass reading what an earlier pass wrote from a shader.
+	/// Passes run in the order they were added, so a pass can only read what passes before it wrote.
+	/// The graph binds each pass's framebuffer and sets the viewport to its size, everything else is up to the pass.
+	/// </summary>
+	class FrameGraph {
+	public:
+		typedef std::function<void()> ExecuteFunc;
+		static const int MAX_COLOR_ATTACHMENTS = 8;
+
+		FrameGraph(int screenWidth, int screenHeight);
+		~FrameGraph();
+
+		//Owned by the graph, only exists while a pass that isn't culled uses it
+		int createTexture(const char* name, const FrameTextureDesc& desc);
+		//Owned by someone else, the graph only orders passes around it. The size is used when a pass draws into it
+		int importTexture(const char* name, GLuint texture, int width, int height);
+		//Anything else one pass hands the next that the graph only orders them by, e.g. a buffer of draw commands
+		int importExternal(const char* name);
+		//The screen, or whatever stands in for it. Screen sized and never culled
+		int importFramebuffer(const char* name, GLuint framebuffer);
+
+		int addPass(const char* name, ExecuteFunc execute);
+		void read(int pass, int resource, FrameAccess access = FRAME_ACCESS_SAMPLED);
+		//Shader or copy writes, attachments go through writeColor and writeDepth
+		void write(int pass, int resource, FrameAccess access);
+		//Attachment index is the order these are called in
+		void writeColor(int pass, int resource);
+		void writeDepth(int pass, int resource);
+		//Runs even if nothing reads what it writes, e.g. when it reads back to the CPU
+		void setSideEffect(int pass);
+		//A disabled pass is left out as if it were never added
+		void setEnabled(int pass, bool enabled);
+		bool isEnabled(int pass) const { return mPasses[pass].enabled; }
+
+		//Cheap when nothing changed, call every frame
+		void setScreenSize(int width, int height);
+		//Compiles again if anything changed since last time, then runs every pass that wasn't culled
+		void execute();
+
+		//0 until the resource's first compile, and can change on every compile after
+		GLuint getTexture(int resource) const { return mResources[resource].texture; }
+		int getWidth(int resource) const { return mResources[resource].width; }
+		int getHeight(int resource) const { return mResources[resource].height; }
+
+		int getNumCulledPasses() const { return mNumCulledPasses; }
+		//Textures the graph owns that are in use, and the GL textures backing them
+		int getNumTransientTextures() const { return mNumTransientTextures; }
+		int getNumAllocatedTextures() const { return (int)mTextures.size(); }
+		int getNumBarriers() const { return mNumBarriers; }
+		//Passes, what they touch and what the last compile decided. Call inside an ImGui window
+		void drawImGui();
+
+	private:
+		FrameGraph(const FrameGraph& r) = delete;
+
+		enum ResourceType { RESOURCE_TEXTURE, RESOURCE_IMPORTED_TEXTURE, RESOURCE_EXTERNAL, RESOURCE_FRAMEBUFFER };
+		struct Resource {
+			std::string name;
+			ResourceType type;
+			FrameTextureDesc desc;
+			//Resolved by the last compile
+			GLuint texture;
+			int width, height;
+			//Index into mTextures, -1 if not created
+			int allocation;
+		};
+		struct Access {
+			int resource;
+			FrameAccess access;
+		};
+		struct Pass {
+			std::string name;
+			ExecuteFunc execute;
+			std::vector<Access> reads;
+			std::vector<Access> writes;
+			std::vector<int> colorAttachments;
+			int depthAttachment;
+			bool sideEffect;
+			bool enabled;
+			//Decided by the last compile
+			bool culled;
+			GLbitfield barrier;
+			GLuint framebuffer;
+			int width, height;
+		};
+		//A GL texture the graph owns, shared by every resource with the same description whose lifetime fits
+		struct Allocation {
+			GLenum format;
+			int width, height;
+			GLenum filter, wrap;
+			GLuint texture;
+			//Last pass of the resource currently in it, during a compile
+			int busyUntil;
+		};
+
+		void compile();
+		void cullPasses();
+		void allocateTextures();
+		void createFramebuffers();
+		void placeBarriers();
+		void deleteFramebuffers();
+
+		int mScreenWidth, mScreenHeight;
+		bool mDirty;
+		std::vector<Resource> mResources;
+		std::vector<Pass> mPasses;
+		std::vector<Allocation> mTextures;
+		int mNumCulledPasses;
+		int mNumTransientTextures;
+		int mNumBarriers;
+	};
+}
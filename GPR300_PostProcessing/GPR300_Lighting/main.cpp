@@ -21,6 +21,7 @@
 #include "EW/Mesh.h"
 #include "EW/Transform.h"
 #include "EW/ShapeGen.h"
+#include "EW/FrameGraph.h"
 
 #include <iostream>
 
@@ -190,54 +191,26 @@ int main() {
 	if (texture == NULL || normalMap == NULL)
 		std::cout << "Failed to load texture!" << std::endl;
 
-	// Create Frame Buffer Object
-	unsigned int fbo;
-	glGenFramebuffers(1, &fbo);
-
-	// Create Framebuffer Texture
-	unsigned int fbTexture;
-	glGenTextures(1, &fbTexture);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, fbTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCREEN_WIDTH, SCREEN_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// Create Render Buffer Object
-	unsigned int rbo;
-	glGenRenderbuffers(1, &rbo);
-	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SCREEN_WIDTH, SCREEN_HEIGHT);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fbTexture, 0);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-
-	// Error checking framebuffer
-	GLenum fboStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-	if (fboStatus != GL_FRAMEBUFFER_COMPLETE)
-		std::cout << "Framebuffer error: " << fboStatus << std::endl;
-
-	while (!glfwWindowShouldClose(window)) {
-		processInput(window);
-
-		glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	float time = 0.0f;
+
+	//Scene into a screen sized texture, then that through the effect onto the screen. The graph resizes both with the window
+	ew::FrameGraph frameGraph(SCREEN_WIDTH, SCREEN_HEIGHT);
+	ew::FrameTextureDesc sceneColorDesc;
+	sceneColorDesc.format = GL_RGB8;
+	sceneColorDesc.screenScale = 1.0f;
+	int sceneColor = frameGraph.createTexture("SceneColor", sceneColorDesc);
+	ew::FrameTextureDesc sceneDepthDesc;
+	sceneDepthDesc.format = GL_DEPTH24_STENCIL8;
+	sceneDepthDesc.screenScale = 1.0f;
+	sceneDepthDesc.filter = GL_NEAREST;
+	int sceneDepth = frameGraph.createTexture("SceneDepth", sceneDepthDesc);
+	int screen = frameGraph.importFramebuffer("Screen", 0);
+
+	int scenePass = frameGraph.addPass("ScenePass", [&]() {
 		glClearColor(bgColor.r, bgColor.g, bgColor.b, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		glEnable(GL_DEPTH_TEST);
 
-		GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-		glDrawBuffers(2, buffers);
-
-		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
-
-		float time = (float)glfwGetTime();
-		deltaTime = time - lastFrameTime;
-		lastFrameTime = time;
-
 		//Draw
 		litShader.use();
 		litShader.setMat4("_Projection", camera.getProjectionMatrix());
@@ -286,9 +259,11 @@ int main() {
 		unlitShader.setMat4("_Model", lightTransform.getModelMatrix());
 		unlitShader.setVec3("_Color", pointLight.color);
 		sphereMesh.draw();
+	});
+	frameGraph.writeColor(scenePass, sceneColor);
+	frameGraph.writeDepth(scenePass, sceneDepth);
 
-		// Bind the default framebuffer
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	int postPass = frameGraph.addPass("PostPass", [&]() {
 		glDisable(GL_DEPTH_TEST); // prevents framebuffer rectangle from being discarded
 		glClear(GL_COLOR_BUFFER_BIT);
 
@@ -298,8 +273,27 @@ int main() {
 		framebufferShader.setInt("_CurrentEffect", currentEffect);
 		framebufferShader.setFloat("_ScreenWidth", SCREEN_WIDTH);
 		framebufferShader.setFloat("_ScreenHeight", SCREEN_HEIGHT);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, frameGraph.getTexture(sceneColor));
 		framebufferShader.setInt("_ScreenTexture", 2);
 		quadMesh.draw();
+	});
+	frameGraph.read(postPass, sceneColor);
+	frameGraph.writeColor(postPass, screen);
+
+	while (!glfwWindowShouldClose(window)) {
+		processInput(window);
+
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui_ImplGlfw_NewFrame();
+		ImGui::NewFrame();
+
+		time = (float)glfwGetTime();
+		deltaTime = time - lastFrameTime;
+		lastFrameTime = time;
+
+		frameGraph.setScreenSize(SCREEN_WIDTH, SCREEN_HEIGHT);
+		frameGraph.execute();
 
 		//Draw UI
 		ImGui::Begin("Settings");
@@ -337,6 +331,8 @@ int main() {
 
 		ImGui::Text(effectName.c_str());
 
+		frameGraph.drawImGui();
+
 		lightTransform.position = pointLight.position;
 
 		ImGui::End();
@@ -349,7 +345,6 @@ int main() {
 	}
 
 	glDeleteTextures(1, &texture);
-	glDeleteFramebuffers(1, &fbo);
 
 	glfwTerminate();
 	return 0;
@@ -9,8 +9,8 @@ uniform float _ScreenWidth;
 uniform float _ScreenHeight;
 uniform sampler2D _ScreenTexture;
 
-float xOffset = 1f / _ScreenWidth;
-float yOffset = 1f / _ScreenHeight;
+float xOffset = 1.0 / _ScreenWidth;
+float yOffset = 1.0 / _ScreenHeight;
 
 vec2 neighborPixels[9] = vec2[] (vec2(-xOffset, yOffset), vec2(0, yOffset), vec2(xOffset, yOffset),
                                  vec2(-xOffset, 0), vec2(0, 0), vec2(xOffset, 0),
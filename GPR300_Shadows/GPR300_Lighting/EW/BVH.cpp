@@ -0,0 +1,503 @@
+//Author: Sam Fox
+
+#include "BVH.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <float.h>
+
+namespace ew {
+	//Centroid buckets tried per axis when looking for the cheapest split
+	static const int SAH_BINS = 12;
+	//Smallest subtree handed to a thread on its own
+	static const int MIN_PARALLEL_BUILD = 1024;
+
+	const int BVH::NULL_NODE;
+
+	static AABB merge(const AABB& a, const AABB& b)
+	{
+		AABB box;
+		box.min = glm::min(a.min, b.min);
+		box.max = glm::max(a.max, b.max);
+		return box;
+	}
+
+	static float surfaceArea(const AABB& box)
+	{
+		glm::vec3 size = box.max - box.min;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	static bool sameBox(const AABB& a, const AABB& b)
+	{
+		return a.min == b.min && a.max == b.max;
+	}
+
+	enum FrustumTest { TEST_OUTSIDE, TEST_INTERSECTS, TEST_INSIDE };
+
+	static FrustumTest testFrustum(const Frustum& frustum, const AABB& box)
+	{
+		glm::vec3 center = box.getCenter();
+		glm::vec3 extents = box.getExtents();
+		FrustumTest result = TEST_INSIDE;
+		for (int p = 0; p < FRUSTUM_NUM_PLANES; p++) {
+			glm::vec3 normal = glm::vec3(frustum.planes[p]);
+			float distance = glm::dot(normal, center) + frustum.planes[p].w;
+			float reach = glm::dot(glm::abs(normal), extents);
+			if (distance + reach < 0.0f) {
+				return TEST_OUTSIDE;
+			}
+			if (distance - reach < 0.0f) {
+				result = TEST_INTERSECTS;
+			}
+		}
+		return result;
+	}
+
+	//Distance along the ray to where it enters the box, or FLT_MAX
+	static float rayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const AABB& box, float maxDistance)
+	{
+		glm::vec3 t0 = (box.min - origin) * inverseDirection;
+		glm::vec3 t1 = (box.max - origin) * inverseDirection;
+		glm::vec3 near = glm::min(t0, t1);
+		glm::vec3 far = glm::max(t0, t1);
+		float enter = glm::max(glm::max(near.x, near.y), glm::max(near.z, 0.0f));
+		float exit = glm::min(glm::min(far.x, far.y), glm::min(far.z, maxDistance));
+		return enter <= exit ? enter : FLT_MAX;
+	}
+
+	void BVH::clear()
+	{
+		mNodes.clear();
+		mObjectLeaves.clear();
+		mRoot = NULL_NODE;
+		mFreeList = NULL_NODE;
+		mNumObjects = 0;
+	}
+
+	void BVH::build(const AABB* boxes, int count)
+	{
+		clear();
+		if (count <= 0) {
+			return;
+		}
+		mNodes.resize(2 * count - 1);
+		mObjectLeaves.assign(count, NULL_NODE);
+		mNumObjects = count;
+
+		std::vector<glm::vec3> centroids(count);
+		std::vector<int> objects(count);
+		for (int i = 0; i < count; i++) {
+			centroids[i] = boxes[i].getCenter();
+			objects[i] = i;
+		}
+
+		BuildInput input;
+		input.boxes = boxes;
+		input.centroids = &centroids[0];
+		input.objects = &objects[0];
+		input.deferBelow = std::max(MIN_PARALLEL_BUILD, count / (getNumThreads() * 4));
+
+		//Split serially until the ranges are small enough to go one per thread, then build those together.
+		//Every subtree knows its node range up front, so the threads never share an allocator
+		std::vector<BuildTask> tasks;
+		std::vector<int> topNodes;
+		buildRange(input, 0, count, 0, NULL_NODE, &tasks, &topNodes);
+		parallelFor((int)tasks.size(), 1, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				buildRange(input, tasks[i].first, tasks[i].count, tasks[i].node, tasks[i].parent, NULL, NULL);
+			}
+		});
+
+		//The top nodes were made before their subtrees had boxes. Children come after parents, so go backwards
+		for (int i = (int)topNodes.size() - 1; i >= 0; i--) {
+			BVHNode& node = mNodes[topNodes[i]];
+			node.box = merge(mNodes[node.left].box, mNodes[node.right].box);
+		}
+		mRoot = 0;
+	}
+
+	void BVH::buildRange(const BuildInput& input, int first, int count, int nodeIndex, int parent,
+		std::vector<BuildTask>* deferred, std::vector<int>* topNodes)
+	{
+		if (deferred != NULL && count <= input.deferBelow) {
+			BuildTask task;
+			task.node = nodeIndex;
+			task.parent = parent;
+			task.first = first;
+			task.count = count;
+			deferred->push_back(task);
+			return;
+		}
+
+		BVHNode& node = mNodes[nodeIndex];
+		node.parent = parent;
+		if (count == 1) {
+			node.object = input.objects[first];
+			node.left = node.right = NULL_NODE;
+			node.box = input.boxes[node.object];
+			mObjectLeaves[node.object] = nodeIndex;
+			return;
+		}
+		node.object = -1;
+
+		AABB box = input.boxes[input.objects[first]];
+		glm::vec3 centroidMin = input.centroids[input.objects[first]];
+		glm::vec3 centroidMax = centroidMin;
+		for (int i = first + 1; i < first + count; i++) {
+			box = merge(box, input.boxes[input.objects[i]]);
+			centroidMin = glm::min(centroidMin, input.centroids[input.objects[i]]);
+			centroidMax = glm::max(centroidMax, input.centroids[input.objects[i]]);
+		}
+		node.box = box;
+
+		//Cheapest split is the one with the least (area * objects) on both sides
+		int bestAxis = -1, bestBin = 0;
+		float bestCost = FLT_MAX;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float extent = centroidMax[axis] - centroidMin[axis];
+			if (extent <= 0.0f) {
+				continue;
+			}
+			float binScale = SAH_BINS / extent;
+			AABB binBoxes[SAH_BINS];
+			int binCounts[SAH_BINS] = {};
+			for (int i = first; i < first + count; i++)
+			{
+				int object = input.objects[i];
+				int bin = std::min((int)((input.centroids[object][axis] - centroidMin[axis]) * binScale), SAH_BINS - 1);
+				binBoxes[bin] = binCounts[bin] == 0 ? input.boxes[object] : merge(binBoxes[bin], input.boxes[object]);
+				binCounts[bin]++;
+			}
+
+			//Right side areas swept from the end, then the left side from the start
+			float rightAreas[SAH_BINS];
+			int rightCounts[SAH_BINS];
+			AABB sweep;
+			int swept = 0;
+			for (int bin = SAH_BINS - 1; bin > 0; bin--) {
+				if (binCounts[bin] > 0) {
+					sweep = swept == 0 ? binBoxes[bin] : merge(sweep, binBoxes[bin]);
+					swept += binCounts[bin];
+				}
+				rightAreas[bin] = swept > 0 ? surfaceArea(sweep) : 0.0f;
+				rightCounts[bin] = swept;
+			}
+			swept = 0;
+			for (int bin = 0; bin < SAH_BINS - 1; bin++) {
+				if (binCounts[bin] > 0) {
+					sweep = swept == 0 ? binBoxes[bin] : merge(sweep, binBoxes[bin]);
+					swept += binCounts[bin];
+				}
+				if (swept == 0 || rightCounts[bin + 1] == 0) {
+					continue;
+				}
+				float cost = surfaceArea(sweep) * swept + rightAreas[bin + 1] * rightCounts[bin + 1];
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin;
+				}
+			}
+		}
+
+		int leftCount;
+		if (bestAxis >= 0) {
+			float binScale = SAH_BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+			int* middle = std::partition(input.objects + first, input.objects + first + count, [&](int object) {
+				return std::min((int)((input.centroids[object][bestAxis] - centroidMin[bestAxis]) * binScale), SAH_BINS - 1) <= bestBin;
+			});
+			leftCount = (int)(middle - (input.objects + first));
+		}
+		else {
+			//Every centroid in the same spot, any split is as good as another
+			leftCount = count / 2;
+		}
+
+		int left = nodeIndex + 1;
+		int right = nodeIndex + 2 * leftCount;
+		node.left = left;
+		node.right = right;
+		if (topNodes != NULL) {
+			topNodes->push_back(nodeIndex);
+		}
+		buildRange(input, first, leftCount, left, nodeIndex, deferred, topNodes);
+		buildRange(input, first + leftCount, count - leftCount, right, nodeIndex, deferred, topNodes);
+	}
+
+	int BVH::allocateNode()
+	{
+		int node;
+		if (mFreeList != NULL_NODE) {
+			node = mFreeList;
+			mFreeList = mNodes[node].parent;
+		}
+		else {
+			node = (int)mNodes.size();
+			mNodes.push_back(BVHNode());
+		}
+		mNodes[node].parent = mNodes[node].left = mNodes[node].right = NULL_NODE;
+		mNodes[node].object = -1;
+		return node;
+	}
+
+	void BVH::freeNode(int node)
+	{
+		mNodes[node].parent = mFreeList;
+		mNodes[node].object = -1;
+		mFreeList = node;
+	}
+
+	void BVH::refitUpward(int node)
+	{
+		while (node != NULL_NODE)
+		{
+			AABB box = merge(mNodes[mNodes[node].left].box, mNodes[mNodes[node].right].box);
+			//Ancestors only depend on their children, nothing above an unchanged box changes either
+			if (sameBox(box, mNodes[node].box)) {
+				return;
+			}
+			mNodes[node].box = box;
+			node = mNodes[node].parent;
+		}
+	}
+
+	void BVH::insert(int object, const AABB& box)
+	{
+		if (contains(object)) {
+			update(object, box);
+			return;
+		}
+		if (object >= (int)mObjectLeaves.size()) {
+			mObjectLeaves.resize(object + 1, NULL_NODE);
+		}
+		int leaf = allocateNode();
+		mNodes[leaf].box = box;
+		mNodes[leaf].object = object;
+		mObjectLeaves[object] = leaf;
+		mNumObjects++;
+		if (mRoot == NULL_NODE) {
+			mRoot = leaf;
+			return;
+		}
+
+		//Walk down to the sibling that grows the tree's total area the least
+		int sibling = mRoot;
+		while (!mNodes[sibling].isLeaf())
+		{
+			const BVHNode& node = mNodes[sibling];
+			float area = surfaceArea(node.box);
+			float combinedArea = surfaceArea(merge(node.box, box));
+			//Pairing with this node makes a new parent here, going further down makes every node on the way grow
+			float pairCost = 2.0f * combinedArea;
+			float inheritedCost = 2.0f * (combinedArea - area);
+			float childCosts[2];
+			int children[2] = { node.left, node.right };
+			for (int i = 0; i < 2; i++) {
+				const BVHNode& child = mNodes[children[i]];
+				float grown = surfaceArea(merge(child.box, box));
+				childCosts[i] = (child.isLeaf() ? grown : grown - surfaceArea(child.box)) + inheritedCost;
+			}
+			if (pairCost < childCosts[0] && pairCost < childCosts[1]) {
+				break;
+			}
+			sibling = childCosts[0] <= childCosts[1] ? children[0] : children[1];
+		}
+
+		int oldParent = mNodes[sibling].parent;
+		int newParent = allocateNode();
+		mNodes[newParent].parent = oldParent;
+		mNodes[newParent].box = merge(mNodes[sibling].box, box);
+		mNodes[newParent].left = sibling;
+		mNodes[newParent].right = leaf;
+		mNodes[sibling].parent = newParent;
+		mNodes[leaf].parent = newParent;
+		if (oldParent == NULL_NODE) {
+			mRoot = newParent;
+			return;
+		}
+		if (mNodes[oldParent].left == sibling) {
+			mNodes[oldParent].left = newParent;
+		}
+		else {
+			mNodes[oldParent].right = newParent;
+		}
+		refitUpward(oldParent);
+	}
+
+	void BVH::remove(int object)
+	{
+		if (!contains(object)) {
+			return;
+		}
+		int leaf = mObjectLeaves[object];
+		mObjectLeaves[object] = NULL_NODE;
+		mNumObjects--;
+		if (leaf == mRoot) {
+			mRoot = NULL_NODE;
+			freeNode(leaf);
+			return;
+		}
+
+		//The sibling takes the parent's place
+		int parent = mNodes[leaf].parent;
+		int grandParent = mNodes[parent].parent;
+		int sibling = mNodes[parent].left == leaf ? mNodes[parent].right : mNodes[parent].left;
+		mNodes[sibling].parent = grandParent;
+		if (grandParent == NULL_NODE) {
+			mRoot = sibling;
+		}
+		else {
+			if (mNodes[grandParent].left == parent) {
+				mNodes[grandParent].left = sibling;
+			}
+			else {
+				mNodes[grandParent].right = sibling;
+			}
+			refitUpward(grandParent);
+		}
+		freeNode(parent);
+		freeNode(leaf);
+	}
+
+	void BVH::update(int object, const AABB& box)
+	{
+		if (!contains(object)) {
+			insert(object, box);
+			return;
+		}
+		int leaf = mObjectLeaves[object];
+		if (sameBox(mNodes[leaf].box, box)) {
+			return;
+		}
+		mNodes[leaf].box = box;
+		refitUpward(mNodes[leaf].parent);
+	}
+
+	void BVH::queryFrustum(const Frustum& frustum, std::vector<int>& objects) const
+	{
+		if (mRoot == NULL_NODE) {
+			return;
+		}
+		//Second value is 1 once an ancestor was found fully inside, nothing below needs testing
+		std::vector<glm::ivec2> stack;
+		stack.push_back(glm::ivec2(mRoot, 0));
+		while (!stack.empty())
+		{
+			glm::ivec2 entry = stack.back();
+			stack.pop_back();
+			const BVHNode& node = mNodes[entry.x];
+			int inside = entry.y;
+			if (!inside) {
+				FrustumTest test = testFrustum(frustum, node.box);
+				if (test == TEST_OUTSIDE) {
+					continue;
+				}
+				inside = test == TEST_INSIDE ? 1 : 0;
+			}
+			if (node.isLeaf()) {
+				objects.push_back(node.object);
+				continue;
+			}
+			stack.push_back(glm::ivec2(node.right, inside));
+			stack.push_back(glm::ivec2(node.left, inside));
+		}
+	}
+
+	void BVH::querySphere(const glm::vec3& center, float radius, std::vector<int>& objects) const
+	{
+		if (mRoot == NULL_NODE) {
+			return;
+		}
+		std::vector<int> stack;
+		stack.push_back(mRoot);
+		while (!stack.empty())
+		{
+			const BVHNode& node = mNodes[stack.back()];
+			stack.pop_back();
+			glm::vec3 offset = glm::clamp(center, node.box.min, node.box.max) - center;
+			if (glm::dot(offset, offset) > radius * radius) {
+				continue;
+			}
+			if (node.isLeaf()) {
+				objects.push_back(node.object);
+				continue;
+			}
+			stack.push_back(node.right);
+			stack.push_back(node.left);
+		}
+	}
+
+	int BVH::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* hitDistance) const
+	{
+		if (mRoot == NULL_NODE) {
+			return -1;
+		}
+		//Divide by zero gives +-inf, which the slab test handles
+		glm::vec3 inverseDirection = 1.0f / direction;
+		int hitObject = -1;
+		float closest = maxDistance;
+		std::vector<int> stack;
+		stack.push_back(mRoot);
+		while (!stack.empty())
+		{
+			const BVHNode& node = mNodes[stack.back()];
+			stack.pop_back();
+			if (rayBox(origin, inverseDirection, node.box, closest) == FLT_MAX) {
+				continue;
+			}
+			if (node.isLeaf()) {
+				closest = rayBox(origin, inverseDirection, node.box, closest);
+				hitObject = node.object;
+				continue;
+			}
+			//Nearer child on top, so its hits shrink the search before the far one is looked at
+			float leftDistance = rayBox(origin, inverseDirection, mNodes[node.left].box, closest);
+			float rightDistance = rayBox(origin, inverseDirection, mNodes[node.right].box, closest);
+			if (leftDistance <= rightDistance) {
+				if (rightDistance != FLT_MAX) {
+					stack.push_back(node.right);
+				}
+				if (leftDistance != FLT_MAX) {
+					stack.push_back(node.left);
+				}
+			}
+			else {
+				if (leftDistance != FLT_MAX) {
+					stack.push_back(node.left);
+				}
+				stack.push_back(node.right);
+			}
+		}
+		if (hitObject >= 0 && hitDistance != NULL) {
+			*hitDistance = closest;
+		}
+		return hitObject;
+	}
+
+	float BVH::getCost() const
+	{
+		if (mRoot == NULL_NODE || mNodes[mRoot].isLeaf()) {
+			return 0.0f;
+		}
+		float rootArea = surfaceArea(mNodes[mRoot].box);
+		if (rootArea <= 0.0f) {
+			return 0.0f;
+		}
+		float total = 0.0f;
+		std::vector<int> stack;
+		stack.push_back(mRoot);
+		while (!stack.empty())
+		{
+			const BVHNode& node = mNodes[stack.back()];
+			stack.pop_back();
+			if (node.isLeaf()) {
+				continue;
+			}
+			total += surfaceArea(node.box);
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+		return total / rootArea;
+	}
+}
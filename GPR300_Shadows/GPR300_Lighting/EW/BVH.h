@@ -0,0 +1,78 @@
+//Author: Sam Fox
+
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "Bounds.h"
+#include "Frustum.h"
+
+namespace ew {
+	struct BVHNode {
+		AABB box;
+		int parent;
+		int left, right;
+		//Object of a leaf, -1 for internal nodes
+		int object;
+
+		bool isLeaf() const { return object >= 0; }
+	};
+
+	/// <summary>
+	/// Bounding volume hierarchy over object world bounds, one object per leaf.
+	/// build() makes a surface area heuristic tree over everything at once, insert / remove / update keep it valid
+	/// as objects come, go and move. Queries return object ids, which are whatever the caller passed in (e.g. a CullingSet
+	/// or MeshBatch object index).
+	/// </summary>
+	class BVH {
+	public:
+		static const int NULL_NODE = -1;
+
+		//Replaces the tree with one over objects 0..count-1. Subtrees below the top few splits are built in parallel
+		void build(const AABB* boxes, int count);
+		void clear();
+
+		//Object ids are picked by the caller and should stay small, they index a lookup table
+		void insert(int object, const AABB& box);
+		void remove(int object);
+		//Refits the leaf and its ancestors. Cheap when the box didn't change
+		void update(int object, const AABB& box);
+		bool contains(int object) const { return object < (int)mObjectLeaves.size() && mObjectLeaves[object] != NULL_NODE; }
+
+		//Appends every object whose box is at least partly inside
+		void queryFrustum(const Frustum& frustum, std::vector<int>& objects) const;
+		void querySphere(const glm::vec3& center, float radius, std::vector<int>& objects) const;
+		//Object whose box the ray enters first within maxDistance, or -1. hitDistance is along direction, which needs no normalizing
+		int raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* hitDistance = NULL) const;
+
+		int getNumObjects() const { return mNumObjects; }
+		int getRoot() const { return mRoot; }
+		const BVHNode& getNode(int node) const { return mNodes[node]; }
+		//Sum of internal node areas over the root area, lower is better. Grows as inserts and removes pile up
+		float getCost() const;
+
+	private:
+		struct BuildInput {
+			const AABB* boxes;
+			const glm::vec3* centroids;
+			int* objects; //reordered as the ranges split
+			int deferBelow; //ranges this small are left for the parallel pass
+		};
+		struct BuildTask {
+			int node, parent;
+			int first, count;
+		};
+
+		int allocateNode();
+		void freeNode(int node);
+		void refitUpward(int node);
+		//Subtree of count objects at node, its nodes are node .. node + 2 * count - 2
+		void buildRange(const BuildInput& input, int first, int count, int node, int parent,
+			std::vector<BuildTask>* deferred, std::vector<int>* topNodes);
+
+		std::vector<BVHNode> mNodes;
+		std::vector<int> mObjectLeaves; //leaf of every object id, NULL_NODE when not in the tree
+		int mRoot = NULL_NODE;
+		int mFreeList = NULL_NODE; //chained through BVHNode::parent
+		int mNumObjects = 0;
+	};
+}
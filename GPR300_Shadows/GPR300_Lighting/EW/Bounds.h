@@ -0,0 +1,45 @@
+//Author: Sam Fox
+
+#pragma once
+#include <glm/glm.hpp>
+
+namespace ew {
+	/// <summary>
+	/// Axis aligned box, min and max corners
+	/// </summary>
+	struct AABB {
+		glm::vec3 min = glm::vec3(0);
+		glm::vec3 max = glm::vec3(0);
+
+		glm::vec3 getCenter() const { return (min + max) * 0.5f; }
+		glm::vec3 getExtents() const { return (max - min) * 0.5f; }
+
+		//Box around this one after model, still axis aligned (Arvo's method)
+		AABB transformed(const glm::mat4& model) const {
+			glm::vec3 center = glm::vec3(model * glm::vec4(getCenter(), 1.0f));
+			glm::vec3 extents = getExtents();
+			glm::vec3 worldExtents = glm::abs(glm::vec3(model[0])) * extents.x
+				+ glm::abs(glm::vec3(model[1])) * extents.y
+				+ glm::abs(glm::vec3(model[2])) * extents.z;
+			AABB box;
+			box.min = center - worldExtents;
+			box.max = center + worldExtents;
+			return box;
+		}
+	};
+
+	struct BoundingSphere {
+		glm::vec3 center = glm::vec3(0);
+		float radius = 0;
+
+		//Scaled by the largest axis scale, so non uniform scale only ever grows the sphere
+		BoundingSphere transformed(const glm::mat4& model) const {
+			float scale2 = glm::max(glm::max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+				glm::dot(glm::vec3(model[1]), glm::vec3(model[1]))), glm::dot(glm::vec3(model[2]), glm::vec3(model[2])));
+			BoundingSphere sphere;
+			sphere.center = glm::vec3(model * glm::vec4(center, 1.0f));
+			sphere.radius = radius * sqrtf(scale2);
+			return sphere;
+		}
+	};
+}
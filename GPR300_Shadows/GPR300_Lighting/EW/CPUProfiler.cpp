@@ -0,0 +1,236 @@
+//Author: Sam Fox
+
+#include "CPUProfiler.h"
+#include "GPUProfiler.h"
+#include <algorithm>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "../imgui/imgui.h"
+
+namespace ew {
+	//Everything one thread records. Only that thread writes events, readers copy them and then check
+	//count again to throw away any the writer lapped while they were copying
+	struct ThreadBuffer {
+		int tid;
+		//Guarded by the registry mutex
+		char name[32];
+		std::atomic<uint64_t> count;
+		CPUProfiler::Event events[CPUProfiler::EVENTS_PER_THREAD];
+		//Open beginScope calls, only touched by the owning thread
+		int numOpenScopes;
+		const char* openNames[CPUProfiler::MAX_OPEN_SCOPES];
+		uint64_t openStarts[CPUProfiler::MAX_OPEN_SCOPES];
+	};
+
+	//Buffers are never freed, a thread that has exited still shows up in the next export
+	static std::mutex registryMutex;
+	static std::vector<ThreadBuffer*> registry;
+	static thread_local ThreadBuffer* threadBuffer = NULL;
+
+	std::atomic<bool> CPUProfiler::sEnabled(true);
+
+	//Once per thread, everything after this is lock free
+	static ThreadBuffer* registerThread()
+	{
+		//Start the clock before the first event
+		CPUProfiler::get();
+		ThreadBuffer* buffer = new ThreadBuffer();
+		buffer->count.store(0, std::memory_order_relaxed);
+		buffer->numOpenScopes = 0;
+		std::lock_guard<std::mutex> lock(registryMutex);
+		buffer->tid = (int)registry.size() + 1;
+		snprintf(buffer->name, sizeof(buffer->name), "Thread %d", buffer->tid);
+		registry.push_back(buffer);
+		return buffer;
+	}
+
+	static inline ThreadBuffer* getThreadBuffer()
+	{
+		if (threadBuffer == NULL) {
+			threadBuffer = registerThread();
+		}
+		return threadBuffer;
+	}
+
+	//Copies out whatever the ring still holds, oldest first
+	static void readEvents(const ThreadBuffer* buffer, std::vector<CPUProfiler::Event>& events)
+	{
+		const uint64_t size = CPUProfiler::EVENTS_PER_THREAD;
+		uint64_t end = buffer->count.load(std::memory_order_acquire);
+		uint64_t begin = end > size ? end - size : 0;
+		events.resize((size_t)(end - begin));
+		for (uint64_t i = begin; i < end; i++) {
+			events[(size_t)(i - begin)] = buffer->events[i & (size - 1)];
+		}
+		//Anything written since may have landed on top of the oldest copies
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t written = buffer->count.load(std::memory_order_relaxed);
+		uint64_t overwritten = written > size ? written - size : 0;
+		if (overwritten > begin) {
+			events.erase(events.begin(), events.begin() + (size_t)std::min(overwritten - begin, end - begin));
+		}
+	}
+
+	CPUProfiler& CPUProfiler::get()
+	{
+		static CPUProfiler profiler;
+		return profiler;
+	}
+
+	CPUProfiler::CPUProfiler()
+		: mStartTicks(now()), mStartTime(std::chrono::steady_clock::now())
+	{
+		mExportMessage[0] = '\0';
+	}
+
+	void CPUProfiler::record(const char* name, uint64_t start, uint64_t end)
+	{
+		ThreadBuffer* buffer = getThreadBuffer();
+		uint64_t index = buffer->count.load(std::memory_order_relaxed);
+		Event& event = buffer->events[index & (EVENTS_PER_THREAD - 1)];
+		event.name = name;
+		event.start = start;
+		event.end = end;
+		buffer->count.store(index + 1, std::memory_order_release);
+	}
+
+	void CPUProfiler::beginScope(const char* name)
+	{
+		ThreadBuffer* buffer = getThreadBuffer();
+		if (buffer->numOpenScopes < MAX_OPEN_SCOPES) {
+			buffer->openNames[buffer->numOpenScopes] = isEnabled() ? name : NULL;
+			buffer->openStarts[buffer->numOpenScopes] = now();
+		}
+		buffer->numOpenScopes++;
+	}
+
+	void CPUProfiler::endScope()
+	{
+		uint64_t end = now();
+		ThreadBuffer* buffer = getThreadBuffer();
+		if (buffer->numOpenScopes == 0) {
+			return;
+		}
+		buffer->numOpenScopes--;
+		if (buffer->numOpenScopes < MAX_OPEN_SCOPES && buffer->openNames[buffer->numOpenScopes] != NULL) {
+			record(buffer->openNames[buffer->numOpenScopes], buffer->openStarts[buffer->numOpenScopes], end);
+		}
+	}
+
+	void CPUProfiler::setThreadName(const char* name)
+	{
+		ThreadBuffer* buffer = getThreadBuffer();
+		std::lock_guard<std::mutex> lock(registryMutex);
+		snprintf(buffer->name, sizeof(buffer->name), "%s", name);
+	}
+
+	double CPUProfiler::getTicksPerMicrosecond()
+	{
+#ifdef EW_PROFILER_TSC
+		//The TSC runs at a fixed rate on anything recent, so one long measurement is enough
+		uint64_t ticks = now() - mStartTicks;
+		std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - mStartTime;
+		return elapsed.count() > 0.0 ? (double)ticks / elapsed.count() : 1000.0;
+#else
+		return 1000.0;
+#endif
+	}
+
+	double CPUProfiler::toMicroseconds(uint64_t ticks)
+	{
+		return (double)(int64_t)(ticks - mStartTicks) / getTicksPerMicrosecond();
+	}
+
+	void CPUProfiler::drawImGui(const GPUProfiler* gpuProfiler, const char* tracePath)
+	{
+		if (!ImGui::CollapsingHeader("CPU Profiler")) {
+			return;
+		}
+		bool enabled = isEnabled();
+		if (ImGui::Checkbox("Profile CPU", &enabled)) {
+			setEnabled(enabled);
+		}
+
+		//Scopes are recorded when they end, so everything inside the last frame sits right before it
+		std::vector<Event> events;
+		readEvents(getThreadBuffer(), events);
+		int frame = (int)events.size() - 1;
+		while (frame >= 0 && strcmp(events[frame].name, "Frame") != 0) {
+			frame--;
+		}
+		if (frame < 0) {
+			ImGui::Text("No frames recorded on this thread yet");
+		}
+		else {
+			int first = frame;
+			while (first > 0 && events[first - 1].start >= events[frame].start) {
+				first--;
+			}
+			std::vector<Event> scopes(events.begin() + first, events.begin() + frame + 1);
+			std::stable_sort(scopes.begin(), scopes.end(), [](const Event& a, const Event& b) { return a.start < b.start; });
+
+			double ticksPerMs = getTicksPerMicrosecond() * 1000.0;
+			std::vector<uint64_t> openEnds;
+			for (size_t i = 0; i < scopes.size(); i++) {
+				while (!openEnds.empty() && scopes[i].start >= openEnds.back()) {
+					openEnds.pop_back();
+				}
+				ImGui::Text("%*s%s: %.3f ms", (int)openEnds.size() * 2, "", scopes[i].name, (scopes[i].end - scopes[i].start) / ticksPerMs);
+				openEnds.push_back(scopes[i].end);
+			}
+		}
+
+		if (ImGui::Button("Export CPU + GPU Trace")) {
+			if (exportChromeTrace(tracePath, gpuProfiler)) {
+				snprintf(mExportMessage, sizeof(mExportMessage), "Wrote %s", tracePath);
+			}
+			else {
+				snprintf(mExportMessage, sizeof(mExportMessage), "Could not write %s", tracePath);
+			}
+		}
+		if (mExportMessage[0] != '\0') {
+			ImGui::Text("%s", mExportMessage);
+		}
+	}
+
+	bool CPUProfiler::exportChromeTrace(const char* path, const GPUProfiler* gpuProfiler)
+	{
+		ChromeTraceWriter writer;
+		if (!writer.open(path)) {
+			return false;
+		}
+		std::vector<ThreadBuffer*> buffers;
+		std::vector<std::string> names;
+		{
+			std::lock_guard<std::mutex> lock(registryMutex);
+			buffers = registry;
+			for (size_t i = 0; i < buffers.size(); i++) {
+				names.push_back(buffers[i]->name);
+			}
+		}
+
+		double ticksPerUs = getTicksPerMicrosecond();
+		writer.processName(1, "CPU");
+		std::vector<Event> events;
+		for (size_t i = 0; i < buffers.size(); i++) {
+			writer.threadName(1, buffers[i]->tid, names[i].c_str());
+			readEvents(buffers[i], events);
+			for (size_t j = 0; j < events.size(); j++) {
+				double startUs = (double)(int64_t)(events[j].start - mStartTicks) / ticksPerUs;
+				writer.complete(events[j].name, "cpu", 1, buffers[i]->tid, startUs, (events[j].end - events[j].start) / ticksPerUs);
+			}
+		}
+
+		if (gpuProfiler != NULL) {
+			//Read both clocks back to back, the gap between them is far below a trace's resolution
+			GLint64 gpuNow = 0;
+			glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+			double cpuNowUs = toMicroseconds(now());
+			gpuProfiler->writeTraceEvents(writer, 2, cpuNowUs - (double)gpuNow / 1000.0);
+		}
+		return writer.close();
+	}
+}
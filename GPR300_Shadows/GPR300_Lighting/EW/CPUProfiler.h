@@ -0,0 +1,105 @@
+//Author: Sam Fox
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include "ChromeTrace.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define EW_PROFILER_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define EW_PROFILER_TSC
+#endif
+
+namespace ew {
+	class GPUProfiler;
+
+	/// <summary>
+	/// Always-on CPU scope timing. A scope reads the TSC when it starts and ends and appends one event to a ring
+	/// owned by the calling thread, so recording takes no locks and threads never touch each other's memory.
+	/// Each ring keeps the last EVENTS_PER_THREAD events. Ticks only become microseconds when something reads them.
+	/// Use through PROFILE_CPU("Name") inside a block. Build with EW_NO_PROFILING to compile every scope out.
+	/// </summary>
+	class CPUProfiler {
+	public:
+		static const int EVENTS_PER_THREAD = 1 << 16;
+		//Deepest beginScope nesting per thread
+		static const int MAX_OPEN_SCOPES = 64;
+
+		struct Event {
+			//Must outlive the profiler, PROFILE_CPU takes string literals
+			const char* name;
+			uint64_t start;
+			uint64_t end;
+		};
+
+		static CPUProfiler& get();
+
+		//Raw ticks, TSC where there is one, nanoseconds otherwise
+		static inline uint64_t now() {
+#ifdef EW_PROFILER_TSC
+			return __rdtsc();
+#else
+			return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+		}
+		static bool isEnabled() { return sEnabled.load(std::memory_order_relaxed); }
+		static void setEnabled(bool enabled) { sEnabled.store(enabled, std::memory_order_relaxed); }
+
+		//Adds one finished scope to the calling thread's ring
+		static void record(const char* name, uint64_t start, uint64_t end);
+		//For spans that don't fit a block, on the same thread
+		static void beginScope(const char* name);
+		static void endScope();
+		//Row label in the trace for the calling thread
+		static void setThreadName(const char* name);
+
+		//Since the profiler started. Calibrates ticks against steady_clock on the way, so it's not for hot code
+		double toMicroseconds(uint64_t ticks);
+
+		//Last finished "Frame" scope of the calling thread with everything inside it. Call inside an ImGui window
+		void drawImGui(const GPUProfiler* gpuProfiler, const char* tracePath = "trace.json");
+		//Every thread's events, plus the GPU profiler's history on the same clock when it's given.
+		//With a GPU profiler it reads the GL clock, so call it on the thread that owns the context
+		bool exportChromeTrace(const char* path, const GPUProfiler* gpuProfiler = NULL);
+
+	private:
+		CPUProfiler();
+		CPUProfiler(const CPUProfiler& r) = delete;
+		double getTicksPerMicrosecond();
+
+		static std::atomic<bool> sEnabled;
+		uint64_t mStartTicks;
+		std::chrono::steady_clock::time_point mStartTime;
+		char mExportMessage[256];
+	};
+
+	//Times everything until the end of the block it's declared in
+	class CPUProfileScope {
+	public:
+		CPUProfileScope(const char* name)
+			: mName(CPUProfiler::isEnabled() ? name : NULL), mStart(mName != NULL ? CPUProfiler::now() : 0) {}
+		~CPUProfileScope() {
+			if (mName != NULL) {
+				CPUProfiler::record(mName, mStart, CPUProfiler::now());
+			}
+		}
+	private:
+		CPUProfileScope(const CPUProfileScope& r) = delete;
+		const char* mName;
+		uint64_t mStart;
+	};
+}
+
+#ifndef EW_PROFILE_CONCAT
+#define EW_PROFILE_CONCAT_INNER(a, b) a##b
+#define EW_PROFILE_CONCAT(a, b) EW_PROFILE_CONCAT_INNER(a, b)
+#endif
+#ifdef EW_NO_PROFILING
+#define PROFILE_CPU(name)
+#else
+#define PROFILE_CPU(name) ew::CPUProfileScope EW_PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
+#endif
@@ -0,0 +1,68 @@
+//Author: Sam Fox
+
+//fopen is fine here
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "ChromeTrace.h"
+
+namespace ew {
+	ChromeTraceWriter::ChromeTraceWriter()
+		: mFile(NULL), mFirstEvent(true)
+	{
+	}
+
+	ChromeTraceWriter::~ChromeTraceWriter()
+	{
+		close();
+	}
+
+	bool ChromeTraceWriter::open(const char* path)
+	{
+		close();
+		mFile = fopen(path, "w");
+		if (mFile == NULL) {
+			printf("ChromeTraceWriter: could not write %s\n", path);
+			return false;
+		}
+		mFirstEvent = true;
+		fprintf(mFile, "{\"traceEvents\":[");
+		return true;
+	}
+
+	bool ChromeTraceWriter::close()
+	{
+		if (mFile == NULL) {
+			return false;
+		}
+		fprintf(mFile, "\n]}\n");
+		bool written = ferror(mFile) == 0;
+		written = fclose(mFile) == 0 && written;
+		mFile = NULL;
+		return written;
+	}
+
+	void ChromeTraceWriter::beginEvent()
+	{
+		fprintf(mFile, mFirstEvent ? "\n" : ",\n");
+		mFirstEvent = false;
+	}
+
+	void ChromeTraceWriter::processName(int pid, const char* name)
+	{
+		beginEvent();
+		fprintf(mFile, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}", pid, name);
+	}
+
+	void ChromeTraceWriter::threadName(int pid, int tid, const char* name)
+	{
+		beginEvent();
+		fprintf(mFile, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", pid, tid, name);
+	}
+
+	void ChromeTraceWriter::complete(const char* name, const char* category, int pid, int tid, double startUs, double durationUs)
+	{
+		beginEvent();
+		fprintf(mFile, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+			name, category, pid, tid, startUs, durationUs);
+	}
+}
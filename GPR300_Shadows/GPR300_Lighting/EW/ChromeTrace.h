@@ -0,0 +1,31 @@
+//Author: Sam Fox
+
+#pragma once
+#include <stdio.h>
+
+namespace ew {
+	/// <summary>
+	/// Writes the Chrome trace event JSON that chrome://tracing and Perfetto load. Times are in microseconds.
+	/// Each pid shows up as a process and each tid as a row inside it.
+	/// </summary>
+	class ChromeTraceWriter {
+	public:
+		ChromeTraceWriter();
+		~ChromeTraceWriter();
+		bool open(const char* path);
+		//False if anything failed to write
+		bool close();
+
+		void processName(int pid, const char* name);
+		void threadName(int pid, int tid, const char* name);
+		//A span ("X" event). name is written as is, so no quotes or backslashes
+		void complete(const char* name, const char* category, int pid, int tid, double startUs, double durationUs);
+
+	private:
+		ChromeTraceWriter(const ChromeTraceWriter& r) = delete;
+		void beginEvent();
+
+		FILE* mFile;
+		bool mFirstEvent;
+	};
+}
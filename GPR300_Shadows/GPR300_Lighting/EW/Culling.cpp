@@ -0,0 +1,137 @@
+//Author: Sam Fox
+
+#include "Culling.h"
+#include "Parallel.h"
+#include "SimdMath.h"
+#include <float.h>
+#include <string.h>
+
+namespace ew {
+	//Objects per parallel batch, a multiple of 4
+	static const int CULL_CHUNK = 4096;
+
+	void CullingSet::resize(int count)
+	{
+		int padded = (count + 3) & ~3;
+		std::vector<float>* arrays[] = { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ, &mSphereX, &mSphereY, &mSphereZ };
+		for (int i = 0; i < 9; i++) {
+			arrays[i]->resize(padded, 0.0f);
+		}
+		//Any distance minus FLT_MAX is behind every plane
+		mRadius.resize(padded, -FLT_MAX);
+		for (int i = count; i < padded; i++) {
+			mRadius[i] = -FLT_MAX;
+		}
+		mCount = count;
+	}
+
+	void CullingSet::setBounds(int index, const AABB& localBox, const BoundingSphere& localSphere, const glm::mat4& model)
+	{
+		setWorldBounds(index, localBox.transformed(model), localSphere.transformed(model));
+	}
+
+	void CullingSet::setWorldBounds(int index, const AABB& worldBox, const BoundingSphere& worldSphere)
+	{
+		glm::vec3 center = worldBox.getCenter();
+		glm::vec3 extents = worldBox.getExtents();
+		mCenterX[index] = center.x;
+		mCenterY[index] = center.y;
+		mCenterZ[index] = center.z;
+		mExtentX[index] = extents.x;
+		mExtentY[index] = extents.y;
+		mExtentZ[index] = extents.z;
+		mSphereX[index] = worldSphere.center.x;
+		mSphereY[index] = worldSphere.center.y;
+		mSphereZ[index] = worldSphere.center.z;
+		mRadius[index] = worldSphere.radius;
+	}
+
+	int CullingSet::cull(const Frustum& frustum, std::vector<int>& visible) const
+	{
+		//Room for the padding too, the SIMD loop writes before it knows what passed
+		visible.resize(mRadius.size());
+		if (mCount == 0) {
+			return 0;
+		}
+		int numChunks = (mCount + CULL_CHUNK - 1) / CULL_CHUNK;
+		mChunkCounts.resize(numChunks);
+
+		//Each chunk writes its survivors at its own start, then they are packed together below
+		parallelFor(numChunks, 1, [&](int beginChunk, int endChunk) {
+			for (int chunk = beginChunk; chunk < endChunk; chunk++)
+			{
+				int begin = chunk * CULL_CHUNK;
+				int end = glm::min(begin + CULL_CHUNK, mCount);
+				int* out = &visible[begin];
+				int numVisible = 0;
+#ifdef EW_SIMD_SSE
+				__m128 planeX[FRUSTUM_NUM_PLANES], planeY[FRUSTUM_NUM_PLANES], planeZ[FRUSTUM_NUM_PLANES], planeW[FRUSTUM_NUM_PLANES];
+				__m128 absX[FRUSTUM_NUM_PLANES], absY[FRUSTUM_NUM_PLANES], absZ[FRUSTUM_NUM_PLANES];
+				for (int p = 0; p < FRUSTUM_NUM_PLANES; p++) {
+					const glm::vec4& plane = frustum.planes[p];
+					planeX[p] = _mm_set1_ps(plane.x);
+					planeY[p] = _mm_set1_ps(plane.y);
+					planeZ[p] = _mm_set1_ps(plane.z);
+					planeW[p] = _mm_set1_ps(plane.w);
+					absX[p] = _mm_set1_ps(glm::abs(plane.x));
+					absY[p] = _mm_set1_ps(glm::abs(plane.y));
+					absZ[p] = _mm_set1_ps(glm::abs(plane.z));
+				}
+				const __m128 zero = _mm_setzero_ps();
+				for (int i = begin; i < end; i += 4)
+				{
+					__m128 cx = _mm_loadu_ps(&mCenterX[i]), cy = _mm_loadu_ps(&mCenterY[i]), cz = _mm_loadu_ps(&mCenterZ[i]);
+					__m128 ex = _mm_loadu_ps(&mExtentX[i]), ey = _mm_loadu_ps(&mExtentY[i]), ez = _mm_loadu_ps(&mExtentZ[i]);
+					__m128 sx = _mm_loadu_ps(&mSphereX[i]), sy = _mm_loadu_ps(&mSphereY[i]), sz = _mm_loadu_ps(&mSphereZ[i]);
+					__m128 radius = _mm_loadu_ps(&mRadius[i]);
+					__m128 outside = zero;
+					for (int p = 0; p < FRUSTUM_NUM_PLANES; p++)
+					{
+						//Box: center distance plus its extents projected on the normal
+						__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+							_mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+						__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)), _mm_mul_ps(absZ[p], ez));
+						outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, reach), zero));
+						//Sphere: tighter than the box for rotated, long objects
+						__m128 sphereDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], sx), _mm_mul_ps(planeY[p], sy)),
+							_mm_add_ps(_mm_mul_ps(planeZ[p], sz), planeW[p]));
+						outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(sphereDistance, radius), zero));
+					}
+					//Always written, only kept when inside. No branch to mispredict on half visible scenes
+					int inside = ~_mm_movemask_ps(outside);
+					for (int lane = 0; lane < 4; lane++) {
+						out[numVisible] = i + lane;
+						numVisible += (inside >> lane) & 1;
+					}
+				}
+#else
+				for (int i = begin; i < end; i++)
+				{
+					bool inside = true;
+					for (int p = 0; p < FRUSTUM_NUM_PLANES && inside; p++)
+					{
+						const glm::vec4& plane = frustum.planes[p];
+						float distance = plane.x * mCenterX[i] + plane.y * mCenterY[i] + plane.z * mCenterZ[i] + plane.w;
+						float reach = glm::abs(plane.x) * mExtentX[i] + glm::abs(plane.y) * mExtentY[i] + glm::abs(plane.z) * mExtentZ[i];
+						float sphereDistance = plane.x * mSphereX[i] + plane.y * mSphereY[i] + plane.z * mSphereZ[i] + plane.w;
+						inside = distance + reach >= 0.0f && sphereDistance + mRadius[i] >= 0.0f;
+					}
+					if (inside) {
+						out[numVisible++] = i;
+					}
+				}
+#endif
+				mChunkCounts[chunk] = numVisible;
+			}
+		});
+
+		int numVisible = mChunkCounts[0];
+		for (int chunk = 1; chunk < numChunks; chunk++) {
+			//Moves only what survived, the first chunk is already in place
+			memmove(&visible[numVisible], &visible[chunk * CULL_CHUNK], mChunkCounts[chunk] * sizeof(int));
+			numVisible += mChunkCounts[chunk];
+		}
+		visible.resize(numVisible);
+		return numVisible;
+	}
+}
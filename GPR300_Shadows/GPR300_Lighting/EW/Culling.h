@@ -0,0 +1,37 @@
+//Author: Sam Fox
+
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "Bounds.h"
+#include "Frustum.h"
+
+namespace ew {
+	/// <summary>
+	/// World space bounds of every object as separate x / y / z arrays, so a frustum plane is tested
+	/// against four boxes per SSE instruction. Refill the bounds after the transforms change, then cull
+	/// once per view (camera, light...) to get the objects that view has to draw.
+	/// </summary>
+	class CullingSet {
+	public:
+		void resize(int count);
+		int getCount() const { return mCount; }
+
+		//Moves the mesh's local bounds by model
+		void setBounds(int index, const AABB& localBox, const BoundingSphere& localSphere, const glm::mat4& model);
+		void setWorldBounds(int index, const AABB& worldBox, const BoundingSphere& worldSphere);
+
+		//Fills visible with the index of every object at least partly inside the frustum, in index order.
+		//Boxes that straddle a plane corner can pass, nothing inside is ever dropped.
+		int cull(const Frustum& frustum, std::vector<int>& visible) const;
+
+	private:
+		//Padded to a multiple of 4 with objects no frustum accepts
+		std::vector<float> mCenterX, mCenterY, mCenterZ;
+		std::vector<float> mExtentX, mExtentY, mExtentZ;
+		std::vector<float> mSphereX, mSphereY, mSphereZ, mRadius;
+		int mCount = 0;
+		//Survivors of each parallel chunk before they are packed together
+		mutable std::vector<int> mChunkCounts;
+	};
+}
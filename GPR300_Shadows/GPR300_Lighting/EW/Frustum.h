@@ -0,0 +1,53 @@
+//Author: Sam Fox
+
+#pragma once
+#include <glm/glm.hpp>
+
+namespace ew {
+	//Plane order in Frustum::planes
+	enum FrustumPlane {
+		FRUSTUM_LEFT, FRUSTUM_RIGHT, FRUSTUM_BOTTOM, FRUSTUM_TOP, FRUSTUM_NEAR, FRUSTUM_FAR, FRUSTUM_NUM_PLANES
+	};
+
+	/// <summary>
+	/// World space view volume. Planes are (normal, d) with normals pointing inward and unit length,
+	/// so dot(plane.xyz, p) + plane.w is the signed distance of p. Corners are near (0-3) then far (4-7),
+	/// each in the order (-x,-y), (+x,-y), (+x,+y), (-x,+y) of clip space.
+	/// </summary>
+	struct Frustum {
+		glm::vec4 planes[FRUSTUM_NUM_PLANES];
+		glm::vec3 corners[8];
+
+		//Works for any projection * view, e.g. a light's for shadow casters
+		static Frustum fromMatrix(const glm::mat4& viewProjection) {
+			Frustum frustum;
+			glm::mat4 m = glm::transpose(viewProjection); //rows of viewProjection as columns
+			frustum.planes[FRUSTUM_LEFT] = m[3] + m[0];
+			frustum.planes[FRUSTUM_RIGHT] = m[3] - m[0];
+			frustum.planes[FRUSTUM_BOTTOM] = m[3] + m[1];
+			frustum.planes[FRUSTUM_TOP] = m[3] - m[1];
+			frustum.planes[FRUSTUM_NEAR] = m[3] + m[2];
+			frustum.planes[FRUSTUM_FAR] = m[3] - m[2];
+			for (int i = 0; i < FRUSTUM_NUM_PLANES; i++) {
+				frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+			}
+
+			glm::mat4 inverse = glm::inverse(viewProjection);
+			for (int i = 0; i < 8; i++) {
+				glm::vec4 ndc((i & 3) == 1 || (i & 3) == 2 ? 1.0f : -1.0f, (i & 3) >= 2 ? 1.0f : -1.0f, i < 4 ? -1.0f : 1.0f, 1.0f);
+				glm::vec4 world = inverse * ndc;
+				frustum.corners[i] = glm::vec3(world) / world.w;
+			}
+			return frustum;
+		}
+
+		bool containsPoint(const glm::vec3& p) const {
+			for (int i = 0; i < FRUSTUM_NUM_PLANES; i++) {
+				if (glm::dot(glm::vec3(planes[i]), p) + planes[i].w < 0.0f) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+}
@@ -0,0 +1,371 @@
+//Author: Sam Fox
+
+#include "GLState.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	//Nothing known about this state yet, never a real value
+	static const GLuint UNKNOWN = 0xFFFFFFFFu;
+	//Mismatches printed before going quiet, one bad call site tends to repeat every frame
+	static const int MAX_MISMATCH_REPORTS = 10;
+
+	//Texture targets with a slot per unit, -1 for ones that go straight through
+	static int getTargetIndex(GLenum target)
+	{
+		switch (target) {
+		case GL_TEXTURE_1D: return 0;
+		case GL_TEXTURE_2D: return 1;
+		case GL_TEXTURE_3D: return 2;
+		case GL_TEXTURE_2D_ARRAY: return 3;
+		case GL_TEXTURE_CUBE_MAP: return 4;
+		default: return -1;
+		}
+	}
+
+	static GLenum getTargetBinding(int targetIndex)
+	{
+		const GLenum bindings[5] = { GL_TEXTURE_BINDING_1D, GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_3D,
+			GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_CUBE_MAP };
+		return bindings[targetIndex];
+	}
+
+	static int getCapabilityIndex(GLenum capability)
+	{
+		switch (capability) {
+		case GL_BLEND: return 0;
+		case GL_CULL_FACE: return 1;
+		case GL_DEPTH_TEST: return 2;
+		case GL_STENCIL_TEST: return 3;
+		case GL_SCISSOR_TEST: return 4;
+		case GL_POLYGON_OFFSET_FILL: return 5;
+		default: return -1;
+		}
+	}
+
+	GLState& GLState::get()
+	{
+		static GLState state;
+		return state;
+	}
+
+	GLState::GLState()
+		: mDebug(false), mIssued(0), mSkipped(0), mLastIssued(0), mLastSkipped(0), mMismatches(0)
+	{
+		invalidate();
+	}
+
+	void GLState::invalidate()
+	{
+		mProgram = UNKNOWN;
+		mVAO = UNKNOWN;
+		mActiveUnit = UNKNOWN;
+		for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+			for (int target = 0; target < 5; target++) {
+				mTextures[unit][target] = UNKNOWN;
+			}
+		}
+		mDrawFramebuffer = UNKNOWN;
+		mReadFramebuffer = UNKNOWN;
+		mDrawBuffers.clear();
+		memset(mCapabilities, -1, sizeof(mCapabilities));
+		mBlendSource = mBlendDestination = UNKNOWN;
+		mDepthFunc = UNKNOWN;
+		mDepthMask = UNKNOWN;
+		mCullFace = UNKNOWN;
+		mStencilFunc = UNKNOWN;
+		mStencilRef = 0;
+		mStencilReadMask = 0;
+		mStencilWriteMask = UNKNOWN;
+		mStencilFail = mStencilDepthFail = mStencilPass = UNKNOWN;
+		mViewportKnown = false;
+	}
+
+	bool GLState::issue(bool changed)
+	{
+		if (mDebug) {
+			(changed ? mIssued : mSkipped)++;
+		}
+		return changed;
+	}
+
+	void GLState::check(GLenum query, GLint cached, const char* name)
+	{
+		GLint actual = 0;
+		glGetIntegerv(query, &actual);
+		if (actual != cached) {
+			if (mMismatches < MAX_MISMATCH_REPORTS) {
+				printf("GLState: %s is %d but the cache has %d\n", name, actual, cached);
+			}
+			mMismatches++;
+		}
+	}
+
+	void GLState::useProgram(GLuint program)
+	{
+		if (issue(program != mProgram)) {
+			glUseProgram(program);
+			mProgram = program;
+		}
+		else if (mDebug) {
+			check(GL_CURRENT_PROGRAM, (GLint)mProgram, "program");
+		}
+	}
+
+	void GLState::bindVertexArray(GLuint vao)
+	{
+		if (issue(vao != mVAO)) {
+			glBindVertexArray(vao);
+			mVAO = vao;
+		}
+		else if (mDebug) {
+			check(GL_VERTEX_ARRAY_BINDING, (GLint)mVAO, "VAO");
+		}
+	}
+
+	void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture)
+	{
+		int targetIndex = getTargetIndex(target);
+		bool tracked = unit < (GLuint)MAX_TEXTURE_UNITS && targetIndex >= 0;
+		if (!issue(!tracked || mTextures[unit][targetIndex] != texture)) {
+			//Only the active unit can be asked without changing it
+			if (mDebug && unit == mActiveUnit) {
+				check(getTargetBinding(targetIndex), (GLint)texture, "texture");
+			}
+			return;
+		}
+		//The unit only has to be switched when something is actually bound
+		if (issue(unit != mActiveUnit)) {
+			glActiveTexture(GL_TEXTURE0 + unit);
+			mActiveUnit = unit;
+		}
+		glBindTexture(target, texture);
+		if (tracked) {
+			mTextures[unit][targetIndex] = texture;
+		}
+	}
+
+	void GLState::bindTexture(GLenum target, GLuint texture)
+	{
+		if (mActiveUnit == UNKNOWN) {
+			GLint activeTexture = GL_TEXTURE0;
+			glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+			mActiveUnit = (GLuint)(activeTexture - GL_TEXTURE0);
+		}
+		bindTexture(mActiveUnit, target, texture);
+	}
+
+	void GLState::bindFramebuffer(GLenum target, GLuint framebuffer)
+	{
+		bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+		bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+		if (issue((draw && framebuffer != mDrawFramebuffer) || (read && framebuffer != mReadFramebuffer))) {
+			glBindFramebuffer(target, framebuffer);
+			mDrawFramebuffer = draw ? framebuffer : mDrawFramebuffer;
+			mReadFramebuffer = read ? framebuffer : mReadFramebuffer;
+		}
+		else if (mDebug) {
+			check(draw ? GL_DRAW_FRAMEBUFFER_BINDING : GL_READ_FRAMEBUFFER_BINDING, (GLint)framebuffer, "framebuffer");
+		}
+	}
+
+	void GLState::drawBuffers(GLsizei count, const GLenum* buffers)
+	{
+		FramebufferDrawBuffers* current = NULL;
+		for (size_t i = 0; i < mDrawBuffers.size() && current == NULL; i++) {
+			current = mDrawBuffers[i].framebuffer == mDrawFramebuffer ? &mDrawBuffers[i] : NULL;
+		}
+		bool tracked = mDrawFramebuffer != UNKNOWN && count <= MAX_DRAW_BUFFERS;
+		bool changed = !tracked || current == NULL || current->count != count || memcmp(current->buffers, buffers, count * sizeof(GLenum)) != 0;
+		if (!issue(changed)) {
+			return;
+		}
+		glDrawBuffers(count, buffers);
+		if (!tracked) {
+			return;
+		}
+		if (current == NULL) {
+			mDrawBuffers.push_back(FramebufferDrawBuffers());
+			current = &mDrawBuffers.back();
+			current->framebuffer = mDrawFramebuffer;
+		}
+		current->count = count;
+		memcpy(current->buffers, buffers, count * sizeof(GLenum));
+	}
+
+	void GLState::setEnabled(GLenum capability, bool enabled)
+	{
+		int index = getCapabilityIndex(capability);
+		if (issue(index < 0 || mCapabilities[index] != (enabled ? 1 : 0))) {
+			if (enabled) {
+				glEnable(capability);
+			}
+			else {
+				glDisable(capability);
+			}
+			if (index >= 0) {
+				mCapabilities[index] = enabled ? 1 : 0;
+			}
+		}
+		else if (mDebug && (glIsEnabled(capability) == GL_TRUE) != enabled) {
+			check(capability, enabled, "capability");
+		}
+	}
+
+	void GLState::blendFunc(GLenum source, GLenum destination)
+	{
+		if (issue(source != mBlendSource || destination != mBlendDestination)) {
+			glBlendFunc(source, destination);
+			mBlendSource = source;
+			mBlendDestination = destination;
+		}
+		else if (mDebug) {
+			check(GL_BLEND_SRC_RGB, (GLint)source, "blend source");
+		}
+	}
+
+	void GLState::depthFunc(GLenum func)
+	{
+		if (issue(func != mDepthFunc)) {
+			glDepthFunc(func);
+			mDepthFunc = func;
+		}
+		else if (mDebug) {
+			check(GL_DEPTH_FUNC, (GLint)func, "depth func");
+		}
+	}
+
+	void GLState::depthMask(GLboolean write)
+	{
+		if (issue(write != mDepthMask)) {
+			glDepthMask(write);
+			mDepthMask = write;
+		}
+		else if (mDebug) {
+			check(GL_DEPTH_WRITEMASK, write, "depth mask");
+		}
+	}
+
+	void GLState::cullFace(GLenum face)
+	{
+		if (issue(face != mCullFace)) {
+			glCullFace(face);
+			mCullFace = face;
+		}
+		else if (mDebug) {
+			check(GL_CULL_FACE_MODE, (GLint)face, "cull face");
+		}
+	}
+
+	void GLState::stencilFunc(GLenum func, GLint ref, GLuint mask)
+	{
+		if (issue(func != mStencilFunc || ref != mStencilRef || mask != mStencilReadMask)) {
+			glStencilFunc(func, ref, mask);
+			mStencilFunc = func;
+			mStencilRef = ref;
+			mStencilReadMask = mask;
+		}
+		else if (mDebug) {
+			check(GL_STENCIL_REF, ref, "stencil ref");
+		}
+	}
+
+	void GLState::stencilMask(GLuint mask)
+	{
+		if (issue(mask != mStencilWriteMask)) {
+			glStencilMask(mask);
+			mStencilWriteMask = mask;
+		}
+		else if (mDebug) {
+			check(GL_STENCIL_WRITEMASK, (GLint)mask, "stencil mask");
+		}
+	}
+
+	void GLState::stencilOp(GLenum stencilFail, GLenum depthFail, GLenum pass)
+	{
+		if (issue(stencilFail != mStencilFail || depthFail != mStencilDepthFail || pass != mStencilPass)) {
+			glStencilOp(stencilFail, depthFail, pass);
+			mStencilFail = stencilFail;
+			mStencilDepthFail = depthFail;
+			mStencilPass = pass;
+		}
+		else if (mDebug) {
+			check(GL_STENCIL_PASS_DEPTH_PASS, (GLint)pass, "stencil op");
+		}
+	}
+
+	void GLState::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		bool changed = !mViewportKnown || x != mViewport[0] || y != mViewport[1] || width != mViewport[2] || height != mViewport[3];
+		if (issue(changed)) {
+			glViewport(x, y, width, height);
+			mViewport[0] = x;
+			mViewport[1] = y;
+			mViewport[2] = width;
+			mViewport[3] = height;
+			mViewportKnown = true;
+		}
+		else if (mDebug) {
+			GLint actual[4];
+			glGetIntegerv(GL_VIEWPORT, actual);
+			if (memcmp(actual, mViewport, sizeof(actual)) != 0) {
+				check(GL_VIEWPORT, mViewport[0], "viewport");
+			}
+		}
+	}
+
+	void GLState::getViewport(GLint viewport[4])
+	{
+		if (!mViewportKnown) {
+			glGetIntegerv(GL_VIEWPORT, mViewport);
+			mViewportKnown = true;
+		}
+		memcpy(viewport, mViewport, sizeof(mViewport));
+	}
+
+	void GLState::deleteTextures(GLsizei count, const GLuint* textures)
+	{
+		//GL unbinds them everywhere, so the cache does too
+		for (GLsizei i = 0; i < count; i++) {
+			for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+				for (int target = 0; target < 5; target++) {
+					if (mTextures[unit][target] == textures[i]) {
+						mTextures[unit][target] = 0;
+					}
+				}
+			}
+		}
+		glDeleteTextures(count, textures);
+	}
+
+	void GLState::deleteFramebuffers(GLsizei count, const GLuint* framebuffers)
+	{
+		for (GLsizei i = 0; i < count; i++) {
+			mDrawFramebuffer = mDrawFramebuffer == framebuffers[i] ? 0 : mDrawFramebuffer;
+			mReadFramebuffer = mReadFramebuffer == framebuffers[i] ? 0 : mReadFramebuffer;
+			for (size_t j = 0; j < mDrawBuffers.size(); j++) {
+				if (mDrawBuffers[j].framebuffer == framebuffers[i]) {
+					mDrawBuffers.erase(mDrawBuffers.begin() + j);
+					break;
+				}
+			}
+		}
+		glDeleteFramebuffers(count, framebuffers);
+	}
+
+	void GLState::deleteVertexArrays(GLsizei count, const GLuint* vaos)
+	{
+		for (GLsizei i = 0; i < count; i++) {
+			mVAO = mVAO == vaos[i] ? 0 : mVAO;
+		}
+		glDeleteVertexArrays(count, vaos);
+	}
+
+	void GLState::newFrame()
+	{
+		mLastIssued = mIssued;
+		mLastSkipped = mSkipped;
+		mIssued = 0;
+		mSkipped = 0;
+	}
+}
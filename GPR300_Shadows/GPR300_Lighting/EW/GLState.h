@@ -0,0 +1,103 @@
+//Author: Sam Fox
+
+#pragma once
+#include <GL/glew.h>
+#include <vector>
+
+namespace ew {
+	/// <summary>
+	/// Shadow copy of the GL state the demo changes: program, VAO, textures per unit, framebuffers and their draw buffers,
+	/// capabilities, blend/depth/stencil/cull settings and the viewport. A call that wouldn't change anything never reaches
+	/// the driver. Only works if every change to that state goes through here, code that goes around it has to call invalidate().
+	/// Debug mode counts issued and skipped calls and checks skipped ones against what GL reports.
+	/// </summary>
+	class GLState {
+	public:
+		//Units and draw buffers past these still work, they just aren't filtered
+		static const int MAX_TEXTURE_UNITS = 32;
+		static const int MAX_DRAW_BUFFERS = 8;
+
+		static GLState& get();
+
+		//Forget everything, the next call of each kind is issued
+		void invalidate();
+
+		void useProgram(GLuint program);
+		void bindVertexArray(GLuint vao);
+		void bindTexture(GLuint unit, GLenum target, GLuint texture);
+		//On whichever unit is active, for creating and uploading textures
+		void bindTexture(GLenum target, GLuint texture);
+		//GL_FRAMEBUFFER sets both the draw and the read framebuffer
+		void bindFramebuffer(GLenum target, GLuint framebuffer);
+		//Of the bound draw framebuffer, which remembers them
+		void drawBuffers(GLsizei count, const GLenum* buffers);
+		void drawBuffer(GLenum buffer) { drawBuffers(1, &buffer); }
+
+		void setEnabled(GLenum capability, bool enabled);
+		void enable(GLenum capability) { setEnabled(capability, true); }
+		void disable(GLenum capability) { setEnabled(capability, false); }
+		void blendFunc(GLenum source, GLenum destination);
+		void depthFunc(GLenum func);
+		void depthMask(GLboolean write);
+		void cullFace(GLenum face);
+		void stencilFunc(GLenum func, GLint ref, GLuint mask);
+		void stencilMask(GLuint mask);
+		void stencilOp(GLenum stencilFail, GLenum depthFail, GLenum pass);
+		void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+		//From the cache, only asks GL if nothing has been set yet
+		void getViewport(GLint viewport[4]);
+
+		//Deleted names get reused, so the cache has to let go of them
+		void deleteTextures(GLsizei count, const GLuint* textures);
+		void deleteFramebuffers(GLsizei count, const GLuint* framebuffers);
+		void deleteVertexArrays(GLsizei count, const GLuint* vaos);
+
+		void setDebug(bool debug) { mDebug = debug; }
+		bool isDebug() const { return mDebug; }
+		//Moves this frame's counts to the last frame's
+		void newFrame();
+		int getIssuedCalls() const { return mLastIssued; }
+		int getSkippedCalls() const { return mLastSkipped; }
+		//Skipped calls where GL disagreed with the cache, something changed state behind its back
+		int getMismatches() const { return mMismatches; }
+
+	private:
+		GLState();
+		GLState(const GLState& r) = delete;
+
+		struct FramebufferDrawBuffers {
+			GLuint framebuffer;
+			GLsizei count;
+			GLenum buffers[MAX_DRAW_BUFFERS];
+		};
+
+		//Counts the call and sends it on when it changes something. Returns whether it did
+		bool issue(bool changed);
+		//Debug only, compares a cached value with what GL reports
+		void check(GLenum query, GLint cached, const char* name);
+
+		bool mDebug;
+		int mIssued, mSkipped;
+		int mLastIssued, mLastSkipped;
+		int mMismatches;
+
+		GLuint mProgram;
+		GLuint mVAO;
+		GLuint mActiveUnit;
+		GLuint mTextures[MAX_TEXTURE_UNITS][5];
+		GLuint mDrawFramebuffer, mReadFramebuffer;
+		std::vector<FramebufferDrawBuffers> mDrawBuffers;
+		signed char mCapabilities[6];
+		GLenum mBlendSource, mBlendDestination;
+		GLenum mDepthFunc;
+		GLuint mDepthMask;
+		GLenum mCullFace;
+		GLenum mStencilFunc;
+		GLint mStencilRef;
+		GLuint mStencilReadMask;
+		GLuint mStencilWriteMask;
+		GLenum mStencilFail, mStencilDepthFail, mStencilPass;
+		bool mViewportKnown;
+		GLint mViewport[4];
+	};
+}
@@ -0,0 +1,116 @@
+//Author: Sam Fox
+
+#include "GPUCulling.h"
+#include <stddef.h>
+#include <string.h>
+
+namespace ew {
+	//local_size_x of cullObjects.comp
+	static const int CULL_GROUP_SIZE = 64;
+
+	bool GPUCuller::isSupported()
+	{
+		return GLEW_VERSION_4_3 && (GLEW_VERSION_4_6 || GLEW_ARB_indirect_parameters);
+	}
+
+	GPUCuller::GPUCuller(const char* computeShaderPath, int numLists)
+		: mShader(computeShaderPath), mReadbackFence(0), mNumLists(numLists), mListCapacity(0), mStats(numLists)
+	{
+		memset(&mStats[0], 0, numLists * sizeof(CullStats));
+		glGenBuffers(1, &mCommandBuffer);
+		glGenBuffers(1, &mCountBuffer);
+		glGenBuffers(1, &mReadbackBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCountBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, numLists * sizeof(CullStats), &mStats[0], GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, mReadbackBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, numLists * sizeof(CullStats), NULL, GL_STREAM_READ);
+	}
+
+	GPUCuller::~GPUCuller()
+	{
+		if (mReadbackFence != 0) {
+			glDeleteSync(mReadbackFence);
+		}
+		glDeleteBuffers(1, &mCommandBuffer);
+		glDeleteBuffers(1, &mCountBuffer);
+		glDeleteBuffers(1, &mReadbackBuffer);
+	}
+
+	void GPUCuller::begin()
+	{
+		GLsizeiptr size = mNumLists * sizeof(CullStats);
+		//The copy made at an earlier begin() is read once the GPU says it's done, never before
+		if (mReadbackFence != 0 && glClientWaitSync(mReadbackFence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+			glDeleteSync(mReadbackFence);
+			mReadbackFence = 0;
+			glBindBuffer(GL_COPY_READ_BUFFER, mReadbackBuffer);
+			glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size, &mStats[0]);
+		}
+		//Last frame's counts are still in the buffer, queue their copy ahead of the clear
+		if (mReadbackFence == 0) {
+			glBindBuffer(GL_COPY_READ_BUFFER, mCountBuffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, mReadbackBuffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+			mReadbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+
+		GLuint zero = 0;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCountBuffer);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	}
+
+	void GPUCuller::cull(MeshBatch& batch, int list, const Frustum& frustum, const HiZBuffer* occlusion, const glm::mat4& viewProjection)
+	{
+		int numObjects = batch.getNumObjects();
+		if (numObjects > mListCapacity) {
+			//Any list can end up drawing every object
+			mListCapacity = glm::max(numObjects, mListCapacity * 2);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCommandBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, mNumLists * mListCapacity * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+		}
+		if (numObjects == 0) {
+			return;
+		}
+
+		batch.bind();
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, mCommandBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNT_BINDING, mCountBuffer);
+		mShader.use();
+		for (int i = 0; i < FRUSTUM_NUM_PLANES; i++) {
+			mShader.setVec4("_Planes[" + std::to_string(i) + "]", frustum.planes[i]);
+		}
+		mShader.setInt("_NumObjects", numObjects);
+		mShader.setInt("_List", list);
+		mShader.setInt("_FirstCommand", list * mListCapacity);
+		mShader.setInt("_Occlusion", occlusion != NULL ? 1 : 0);
+		if (occlusion != NULL) {
+			occlusion->bind(HI_Z_UNIT);
+			mShader.setInt("_HiZ", HI_Z_UNIT);
+			mShader.setVec2("_HiZSize", glm::vec2(occlusion->getWidth(), occlusion->getHeight()));
+			mShader.setInt("_HiZLevels", occlusion->getNumLevels());
+			mShader.setMat4("_ViewProjection", viewProjection);
+		}
+		glDispatchCompute((numObjects + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+		//The next begin() copies the counts. The draws' GL_COMMAND_BARRIER_BIT is up to whoever draws them
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	}
+
+	void GPUCuller::draw(MeshBatch& batch, int list)
+	{
+		if (mListCapacity == 0) {
+			return;
+		}
+		batch.bind();
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+		glBindBuffer(GL_PARAMETER_BUFFER, mCountBuffer);
+		const void* commands = (const void*)(list * mListCapacity * sizeof(DrawElementsIndirectCommand));
+		GLintptr count = list * sizeof(CullStats) + offsetof(CullStats, drawn);
+		if (GLEW_VERSION_4_6) {
+			glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, commands, count, mListCapacity, 0);
+		}
+		else {
+			glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, commands, count, mListCapacity, 0);
+		}
+	}
+}
@@ -0,0 +1,62 @@
+//Author: Sam Fox
+
+#pragma once
+#include <GL/glew.h>
+#include <vector>
+#include "Frustum.h"
+#include "HiZ.h"
+#include "MeshBatch.h"
+#include "Shader.h"
+
+namespace ew {
+	//What one list's cull did. drawn is also the draw count glMultiDrawElementsIndirectCount reads
+	struct CullStats {
+		GLuint drawn;
+		GLuint frustumCulled;
+		GLuint occluded;
+		GLuint triangles;
+	};
+
+	/// <summary>
+	/// Culls a MeshBatch's objects on the GPU. A compute shader tests every object's bounds against a frustum, and optionally
+	/// a Hi-Z pyramid, and writes the draw commands of what passes plus how many there are, so the draw never goes through the CPU.
+	/// The CPU cost per list is one dispatch and one draw no matter how many objects there are.
+	/// </summary>
+	class GPUCuller {
+	public:
+		static const GLuint COMMAND_BINDING = 4;
+		static const GLuint COUNT_BINDING = 5;
+		static const int HI_Z_UNIT = 6;
+
+		//Compute shaders plus glMultiDrawElementsIndirectCount (GL 4.6 or ARB_indirect_parameters). Mesa llvmpipe has both
+		static bool isSupported();
+
+		GPUCuller(const char* computeShaderPath, int numLists);
+		~GPUCuller();
+
+		//Once per frame before any cull. Resets every list and picks up stats from a finished earlier frame
+		void begin();
+		//Rebuilds list from every object of the batch inside the frustum. Call after batch.submit().
+		//Adding objects can grow the command buffer, which drops the other lists, so cull every list each frame.
+		//With occlusion, objects hidden behind the pyramid's depth as seen through viewProjection are dropped too
+		//The commands are written from a shader, glMemoryBarrier(GL_COMMAND_BARRIER_BIT) before drawing them.
+		//The frame graph puts it in front of the first pass that reads the lists
+		void cull(MeshBatch& batch, int list, const Frustum& frustum, const HiZBuffer* occlusion = NULL,
+			const glm::mat4& viewProjection = glm::mat4(1));
+		void draw(MeshBatch& batch, int list);
+
+		//A frame or two old, reading them never waits on the GPU
+		const CullStats& getStats(int list) const { return mStats[list]; }
+
+	private:
+		GPUCuller(const GPUCuller& r) = delete;
+
+		Shader mShader;
+		GLuint mCommandBuffer, mCountBuffer, mReadbackBuffer;
+		GLsync mReadbackFence;
+		int mNumLists;
+		//Commands each list has room for, lists sit back to back
+		int mListCapacity;
+		std::vector<CullStats> mStats;
+	};
+}
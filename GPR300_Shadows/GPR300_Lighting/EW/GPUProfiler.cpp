@@ -0,0 +1,243 @@
+//Author: Sam Fox
+
+#include "GPUProfiler.h"
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+#include "../imgui/imgui.h"
+
+namespace ew {
+	GPUProfiler& GPUProfiler::get()
+	{
+		static GPUProfiler profiler;
+		return profiler;
+	}
+
+	GPUProfiler::GPUProfiler()
+		: mEnabled(true), mProfilingFrame(false), mFrameIndex(0), mDroppedFrames(0)
+	{
+		for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+			mFrames[i].frameIndex = -1;
+			mFrames[i].inFlight = false;
+		}
+		mExportMessage[0] = '\0';
+	}
+
+	GPUProfiler::~GPUProfiler()
+	{
+		for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+			if (!mFrames[i].queries.empty()) {
+				glDeleteQueries((GLsizei)mFrames[i].queries.size(), &mFrames[i].queries[0]);
+			}
+		}
+	}
+
+	void GPUProfiler::beginFrame()
+	{
+		//This frame's queries were last used FRAMES_IN_FLIGHT frames ago, collect them before they're reused
+		PendingFrame& frame = mFrames[mFrameIndex % FRAMES_IN_FLIGHT];
+		if (frame.inFlight) {
+			resolve(frame);
+		}
+		mProfilingFrame = mEnabled;
+		if (!mProfilingFrame) {
+			return;
+		}
+		frame.frameIndex = mFrameIndex;
+		frame.scopes.clear();
+		mOpenScopes.clear();
+		beginScope("Frame");
+	}
+
+	void GPUProfiler::endFrame()
+	{
+		if (mProfilingFrame) {
+			while (!mOpenScopes.empty()) {
+				endScope();
+			}
+			mFrames[mFrameIndex % FRAMES_IN_FLIGHT].inFlight = true;
+			mProfilingFrame = false;
+		}
+		mFrameIndex++;
+	}
+
+	void GPUProfiler::beginScope(const char* name)
+	{
+		if (!mProfilingFrame) {
+			return;
+		}
+		PendingFrame& frame = mFrames[mFrameIndex % FRAMES_IN_FLIGHT];
+		int scope = (int)frame.scopes.size();
+		size_t numQueries = frame.queries.size();
+		if (numQueries < (size_t)(scope + 1) * 2) {
+			frame.queries.resize(numQueries > 0 ? numQueries * 2 : 32);
+			glGenQueries((GLsizei)(frame.queries.size() - numQueries), &frame.queries[numQueries]);
+		}
+		PendingScope pending;
+		pending.name = name;
+		pending.depth = (int)mOpenScopes.size();
+		frame.scopes.push_back(pending);
+		mOpenScopes.push_back(scope);
+		glQueryCounter(frame.queries[scope * 2], GL_TIMESTAMP);
+	}
+
+	void GPUProfiler::endScope()
+	{
+		if (!mProfilingFrame || mOpenScopes.empty()) {
+			return;
+		}
+		int scope = mOpenScopes.back();
+		mOpenScopes.pop_back();
+		glQueryCounter(mFrames[mFrameIndex % FRAMES_IN_FLIGHT].queries[scope * 2 + 1], GL_TIMESTAMP);
+	}
+
+	void GPUProfiler::resolve(PendingFrame& pending)
+	{
+		pending.inFlight = false;
+		int numQueries = (int)pending.scopes.size() * 2;
+		for (int i = 0; i < numQueries; i++) {
+			GLint available = 0;
+			glGetQueryObjectiv(pending.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) {
+				mDroppedFrames++;
+				return;
+			}
+		}
+
+		Frame frame;
+		frame.frameIndex = pending.frameIndex;
+		frame.scopes.resize(pending.scopes.size());
+		for (size_t i = 0; i < pending.scopes.size(); i++) {
+			GLuint64 start, end;
+			glGetQueryObjectui64v(pending.queries[i * 2], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(pending.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+			if (i == 0) {
+				frame.startTimestamp = start;
+			}
+			frame.scopes[i].name = pending.scopes[i].name;
+			frame.scopes[i].depth = pending.scopes[i].depth;
+			frame.scopes[i].startMs = (double)(start - frame.startTimestamp) / 1000000.0;
+			frame.scopes[i].durationMs = (double)(end - start) / 1000000.0;
+		}
+		mHistory.push_back(frame);
+		if ((int)mHistory.size() > HISTORY_SIZE) {
+			mHistory.pop_front();
+		}
+	}
+
+	//Same name, same color every frame
+	static ImU32 getScopeColor(const char* name)
+	{
+		unsigned int hash = 2166136261u;
+		for (const char* c = name; *c != '\0'; c++) {
+			hash = (hash ^ (unsigned char)*c) * 16777619u;
+		}
+		return ImColor::HSV((hash % 360) / 360.0f, 0.5f, 0.7f);
+	}
+
+	void GPUProfiler::drawImGui(const char* tracePath)
+	{
+		if (!ImGui::CollapsingHeader("GPU Profiler")) {
+			return;
+		}
+		ImGui::Checkbox("Profile GPU", &mEnabled);
+		if (mHistory.empty()) {
+			ImGui::Text("No frames resolved yet");
+			return;
+		}
+
+		//Rolling whole frame times
+		float frameMs[HISTORY_SIZE];
+		int numFrames = (int)mHistory.size();
+		for (int i = 0; i < numFrames; i++) {
+			frameMs[i] = (float)mHistory[i].scopes[0].durationMs;
+		}
+		char overlay[32];
+		snprintf(overlay, sizeof(overlay), "%.2f ms", frameMs[numFrames - 1]);
+		ImGui::PlotHistogram("GPU Frame", frameMs, numFrames, 0, overlay, 0.0f, FLT_MAX, ImVec2(0, 60));
+
+		//Flame graph of the latest frame, a row per depth
+		const Frame& latest = mHistory.back();
+		int maxDepth = 0;
+		for (size_t i = 0; i < latest.scopes.size(); i++) {
+			maxDepth = latest.scopes[i].depth > maxDepth ? latest.scopes[i].depth : maxDepth;
+		}
+		ImVec2 origin = ImGui::GetCursorScreenPos();
+		float width = ImGui::GetContentRegionAvail().x;
+		float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+		ImGui::Dummy(ImVec2(width, rowHeight * (maxDepth + 1)));
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+		double msToPixels = width / (latest.scopes[0].durationMs > 0.0 ? latest.scopes[0].durationMs : 1.0);
+		for (size_t i = 0; i < latest.scopes.size(); i++) {
+			const Scope& scope = latest.scopes[i];
+			ImVec2 min(origin.x + (float)(scope.startMs * msToPixels), origin.y + scope.depth * rowHeight);
+			ImVec2 max(min.x + (float)(scope.durationMs * msToPixels) + 1.0f, min.y + rowHeight - 1.0f);
+			drawList->AddRectFilled(min, max, getScopeColor(scope.name));
+			drawList->PushClipRect(min, max, true);
+			drawList->AddText(ImVec2(min.x + 2.0f, min.y), IM_COL32_WHITE, scope.name);
+			drawList->PopClipRect();
+			if (ImGui::IsMouseHoveringRect(min, max)) {
+				ImGui::SetTooltip("%s: %.3f ms", scope.name, scope.durationMs);
+			}
+		}
+
+		//Average over the history, a scope that runs more than once a frame counts all of its runs
+		for (size_t i = 0; i < latest.scopes.size(); i++) {
+			const Scope& scope = latest.scopes[i];
+			bool seen = false;
+			for (size_t j = 0; j < i && !seen; j++) {
+				seen = latest.scopes[j].depth == scope.depth && strcmp(latest.scopes[j].name, scope.name) == 0;
+			}
+			if (seen) {
+				continue;
+			}
+			double totalMs = 0;
+			for (int f = 0; f < numFrames; f++) {
+				const std::vector<Scope>& scopes = mHistory[f].scopes;
+				for (size_t j = 0; j < scopes.size(); j++) {
+					if (scopes[j].depth == scope.depth && strcmp(scopes[j].name, scope.name) == 0) {
+						totalMs += scopes[j].durationMs;
+					}
+				}
+			}
+			ImGui::Text("%*s%s: %.3f ms", scope.depth * 2, "", scope.name, totalMs / numFrames);
+		}
+		ImGui::Text("Frames dropped waiting on the GPU: %d", mDroppedFrames);
+
+		if (ImGui::Button("Export Chrome Trace")) {
+			if (exportChromeTrace(tracePath)) {
+				snprintf(mExportMessage, sizeof(mExportMessage), "Wrote %d frames to %s", numFrames, tracePath);
+			}
+			else {
+				snprintf(mExportMessage, sizeof(mExportMessage), "Could not write %s", tracePath);
+			}
+		}
+		if (mExportMessage[0] != '\0') {
+			ImGui::Text("%s", mExportMessage);
+		}
+	}
+
+	bool GPUProfiler::exportChromeTrace(const char* path) const
+	{
+		ChromeTraceWriter writer;
+		if (!writer.open(path)) {
+			return false;
+		}
+		writeTraceEvents(writer, 1, 0.0);
+		return writer.close();
+	}
+
+	void GPUProfiler::writeTraceEvents(ChromeTraceWriter& writer, int pid, double offsetUs) const
+	{
+		writer.processName(pid, "GPU");
+		writer.threadName(pid, 1, "GL");
+		for (size_t f = 0; f < mHistory.size(); f++) {
+			const Frame& frame = mHistory[f];
+			double frameStartUs = (double)frame.startTimestamp / 1000.0 + offsetUs;
+			for (size_t i = 0; i < frame.scopes.size(); i++) {
+				const Scope& scope = frame.scopes[i];
+				writer.complete(scope.name, "gpu", pid, 1, frameStartUs + scope.startMs * 1000.0, scope.durationMs * 1000.0);
+			}
+		}
+	}
+}
@@ -0,0 +1,103 @@
+//Author: Sam Fox
+
+#pragma once
+#include <GL/glew.h>
+#include <deque>
+#include <vector>
+#include "ChromeTrace.h"
+
+namespace ew {
+	/// <summary>
+	/// Named, nestable GPU timings. Each scope drops a GL_TIMESTAMP query at its start and end, so scopes can nest
+	/// (GL_TIME_ELAPSED can't). Queries go into one of FRAMES_IN_FLIGHT sets and are read FRAMES_IN_FLIGHT frames later.
+	/// If the GPU still isn't done with them by then, that frame is dropped rather than waited on.
+	/// Use through PROFILE_GPU("Name") inside a block, between beginFrame and endFrame.
+	/// </summary>
+	class GPUProfiler {
+	public:
+		static const int FRAMES_IN_FLIGHT = 3;
+		//Resolved frames kept for the chart and the trace export
+		static const int HISTORY_SIZE = 120;
+
+		struct Scope {
+			//Must outlive the profiler, PROFILE_GPU takes string literals
+			const char* name;
+			int depth;
+			//From the start of the frame
+			double startMs;
+			double durationMs;
+		};
+		struct Frame {
+			int frameIndex;
+			//GPU clock, nanoseconds
+			GLuint64 startTimestamp;
+			//Scope 0 is the whole frame, the rest in the order they started
+			std::vector<Scope> scopes;
+		};
+
+		static GPUProfiler& get();
+
+		//Only read at beginFrame, a frame is either profiled or not
+		void setEnabled(bool enabled) { mEnabled = enabled; }
+		bool isEnabled() const { return mEnabled; }
+
+		void beginFrame();
+		void endFrame();
+		void beginScope(const char* name);
+		void endScope();
+
+		//Oldest first
+		const std::deque<Frame>& getHistory() const { return mHistory; }
+		int getDroppedFrames() const { return mDroppedFrames; }
+
+		//Chart of the history, flame graph of the latest frame and the average per scope. Call inside an ImGui window
+		void drawImGui(const char* tracePath = "gpu_trace.json");
+		//Every frame in the history as complete ("X") events, loads in chrome://tracing or Perfetto
+		bool exportChromeTrace(const char* path) const;
+		//Same events into a trace shared with other sources. offsetUs moves the GPU clock onto theirs
+		void writeTraceEvents(ChromeTraceWriter& writer, int pid, double offsetUs) const;
+
+	private:
+		GPUProfiler();
+		~GPUProfiler();
+		GPUProfiler(const GPUProfiler& r) = delete;
+
+		struct PendingScope {
+			const char* name;
+			int depth;
+		};
+		//One frame's queries, two per scope
+		struct PendingFrame {
+			int frameIndex;
+			bool inFlight;
+			std::vector<PendingScope> scopes;
+			std::vector<GLuint> queries;
+		};
+		void resolve(PendingFrame& frame);
+
+		bool mEnabled;
+		bool mProfilingFrame;
+		int mFrameIndex;
+		int mDroppedFrames;
+		PendingFrame mFrames[FRAMES_IN_FLIGHT];
+		//Scopes of the current frame still waiting for their end
+		std::vector<int> mOpenScopes;
+		std::deque<Frame> mHistory;
+		char mExportMessage[256];
+	};
+
+	//Times everything until the end of the block it's declared in
+	class GPUProfileScope {
+	public:
+		GPUProfileScope(const char* name) { GPUProfiler::get().beginScope(name); }
+		~GPUProfileScope() { GPUProfiler::get().endScope(); }
+	private:
+		GPUProfileScope(const GPUProfileScope& r) = delete;
+	};
+}
+
+#ifndef EW_PROFILE_CONCAT
+#define EW_PROFILE_CONCAT_INNER(a, b) a##b
+#define EW_PROFILE_CONCAT(a, b) EW_PROFILE_CONCAT_INNER(a, b)
+#endif
+#define PROFILE_GPU(name) ew::GPUProfileScope EW_PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
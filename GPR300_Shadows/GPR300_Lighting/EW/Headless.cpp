@@ -0,0 +1,276 @@
+//Author: Sam Fox
+
+//fopen is fine here
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "Headless.h"
+#include "GLState.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glm/gtc/constants.hpp>
+
+namespace ew {
+	bool parseHeadlessOptions(int argc, char** argv, HeadlessOptions& options)
+	{
+		for (int i = 1; i < argc; i++) {
+			bool hasValue = i + 1 < argc && argv[i + 1][0] != '-';
+			if (strcmp(argv[i], "--headless") == 0) {
+				options.enabled = true;
+				if (hasValue) {
+					options.numFrames = atoi(argv[++i]);
+				}
+			}
+			else if (strcmp(argv[i], "--csv") == 0 || strcmp(argv[i], "--dump-frames") == 0 || strcmp(argv[i], "--dump-every") == 0) {
+				if (!hasValue) {
+					printf("%s needs a value\n", argv[i]);
+					return false;
+				}
+				if (strcmp(argv[i], "--csv") == 0) {
+					options.csvPath = argv[++i];
+				}
+				else if (strcmp(argv[i], "--dump-frames") == 0) {
+					options.frameDirectory = argv[++i];
+				}
+				else {
+					options.dumpEvery = std::max(1, atoi(argv[++i]));
+				}
+			}
+		}
+		if (options.enabled && options.numFrames <= 0) {
+			printf("--headless needs a frame count above 0\n");
+			return false;
+		}
+		return true;
+	}
+
+	HeadlessRun::HeadlessRun(const HeadlessOptions& options, int width, int height)
+		: mOptions(options), mWidth(width), mHeight(height), mFBO(0), mColorTexture(0), mDepthRenderbuffer(0), mFrame(0)
+	{
+		if (!mOptions.enabled) {
+			return;
+		}
+		//A hidden window's default framebuffer isn't guaranteed to have pixels, this one is
+		glGenTextures(1, &mColorTexture);
+		GLState::get().bindTexture(GL_TEXTURE_2D, mColorTexture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+		glGenRenderbuffers(1, &mDepthRenderbuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, mDepthRenderbuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+		glGenFramebuffers(1, &mFBO);
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, mFBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mColorTexture, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, mDepthRenderbuffer);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			printf("HeadlessRun: framebuffer is incomplete\n");
+		}
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		glGenQueries(QUERY_LATENCY * 2, &mQueries[0][0]);
+		for (int i = 0; i < QUERY_LATENCY; i++) {
+			mQueryFrames[i] = -1;
+		}
+		mCpuMs.resize(mOptions.numFrames, 0.0);
+		mGpuMs.resize(mOptions.numFrames, 0.0);
+	}
+
+	HeadlessRun::~HeadlessRun()
+	{
+		if (!mOptions.enabled) {
+			return;
+		}
+		glDeleteQueries(QUERY_LATENCY * 2, &mQueries[0][0]);
+		GLState::get().deleteFramebuffers(1, &mFBO);
+		GLState::get().deleteTextures(1, &mColorTexture);
+		glDeleteRenderbuffers(1, &mDepthRenderbuffer);
+	}
+
+	void HeadlessRun::applyCamera(Camera& camera) const
+	{
+		//Circle the origin from a little above, looking at it
+		float angle = glm::two_pi<float>() * mFrame / mOptions.numFrames;
+		glm::vec3 position(sinf(angle) * 6.0f, 2.0f, cosf(angle) * 6.0f);
+		glm::vec3 forward = glm::normalize(-position);
+		camera.setPosition(position);
+		camera.setYaw(glm::degrees(atan2f(forward.z, forward.x)));
+		camera.setPitch(glm::degrees(asinf(forward.y)));
+	}
+
+	void HeadlessRun::beginFrame()
+	{
+		if (!mOptions.enabled) {
+			return;
+		}
+		int slot = mFrame % QUERY_LATENCY;
+		readQueries(slot);
+		glQueryCounter(mQueries[slot][0], GL_TIMESTAMP);
+		mQueryFrames[slot] = mFrame;
+		mFrameStart = std::chrono::high_resolution_clock::now();
+	}
+
+	void HeadlessRun::endFrame()
+	{
+		if (!mOptions.enabled) {
+			return;
+		}
+		glQueryCounter(mQueries[mFrame % QUERY_LATENCY][1], GL_TIMESTAMP);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - mFrameStart;
+		mCpuMs[mFrame] = elapsed.count();
+
+		//Outside the timed part, reading pixels back waits for the whole frame
+		if (!mOptions.frameDirectory.empty() && mFrame % mOptions.dumpEvery == 0) {
+			char path[512];
+			snprintf(path, sizeof(path), "%s/frame%05d.png", mOptions.frameDirectory.c_str(), mFrame);
+			if (!writePNG(path)) {
+				printf("HeadlessRun: could not write %s\n", path);
+			}
+		}
+		mFrame++;
+	}
+
+	void HeadlessRun::readQueries(int slot)
+	{
+		int frame = mQueryFrames[slot];
+		if (frame < 0) {
+			return;
+		}
+		//QUERY_LATENCY frames later this is normally long done, if not it waits
+		GLuint64 begin, end;
+		glGetQueryObjectui64v(mQueries[slot][0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(mQueries[slot][1], GL_QUERY_RESULT, &end);
+		mGpuMs[frame] = (double)(end - begin) / 1000000.0;
+		mQueryFrames[slot] = -1;
+	}
+
+	//Mean and median of a column
+	static void summarize(const std::vector<double>& values, double& mean, double& median)
+	{
+		std::vector<double> sorted = values;
+		std::sort(sorted.begin(), sorted.end());
+		mean = 0;
+		for (size_t i = 0; i < sorted.size(); i++) {
+			mean += sorted[i];
+		}
+		mean /= sorted.size();
+		median = sorted[sorted.size() / 2];
+	}
+
+	bool HeadlessRun::finish()
+	{
+		if (!mOptions.enabled || mFrame == 0) {
+			return true;
+		}
+		for (int i = 0; i < QUERY_LATENCY; i++) {
+			readQueries(i);
+		}
+		mCpuMs.resize(mFrame);
+		mGpuMs.resize(mFrame);
+
+		double cpuMean, cpuMedian, gpuMean, gpuMedian;
+		summarize(mCpuMs, cpuMean, cpuMedian);
+		summarize(mGpuMs, gpuMean, gpuMedian);
+		printf("Headless: %d frames at %dx%d, CPU %.3f ms mean %.3f ms median, GPU %.3f ms mean %.3f ms median\n",
+			mFrame, mWidth, mHeight, cpuMean, cpuMedian, gpuMean, gpuMedian);
+
+		FILE* file = fopen(mOptions.csvPath.c_str(), "w");
+		if (file == NULL) {
+			printf("HeadlessRun: could not write %s\n", mOptions.csvPath.c_str());
+			return false;
+		}
+		fprintf(file, "frame,cpu_ms,gpu_ms\n");
+		for (int i = 0; i < mFrame; i++) {
+			fprintf(file, "%d,%.4f,%.4f\n", i, mCpuMs[i], mGpuMs[i]);
+		}
+		fclose(file);
+		printf("Headless: per frame timings in %s\n", mOptions.csvPath.c_str());
+		return true;
+	}
+
+	static unsigned int crc32(const unsigned char* data, size_t size)
+	{
+		unsigned int crc = 0xFFFFFFFFu;
+		for (size_t i = 0; i < size; i++) {
+			crc ^= data[i];
+			for (int bit = 0; bit < 8; bit++) {
+				crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+			}
+		}
+		return ~crc;
+	}
+
+	static void writeU32(std::vector<unsigned char>& out, unsigned int value)
+	{
+		out.push_back((unsigned char)(value >> 24));
+		out.push_back((unsigned char)(value >> 16));
+		out.push_back((unsigned char)(value >> 8));
+		out.push_back((unsigned char)value);
+	}
+
+	static void writeChunk(FILE* file, const char* type, const std::vector<unsigned char>& data)
+	{
+		std::vector<unsigned char> chunk;
+		writeU32(chunk, (unsigned int)data.size());
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		writeU32(chunk, crc32(&chunk[4], chunk.size() - 4));
+		fwrite(&chunk[0], 1, chunk.size(), file);
+	}
+
+	bool HeadlessRun::writePNG(const char* path)
+	{
+		std::vector<unsigned char> pixels(mWidth * mHeight * 3);
+		GLState::get().bindFramebuffer(GL_READ_FRAMEBUFFER, mFBO);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, mWidth, mHeight, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+		GLState::get().bindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+		//Rows top down, each behind a "no filter" byte
+		size_t rowSize = mWidth * 3;
+		std::vector<unsigned char> raw;
+		raw.reserve((rowSize + 1) * mHeight);
+		for (int y = mHeight - 1; y >= 0; y--) {
+			raw.push_back(0);
+			raw.insert(raw.end(), pixels.begin() + y * rowSize, pixels.begin() + (y + 1) * rowSize);
+		}
+
+		//zlib stream of uncompressed deflate blocks, bigger files but nothing to pull in
+		std::vector<unsigned char> zlib;
+		zlib.push_back(0x78);
+		zlib.push_back(0x01);
+		unsigned int a = 1, b = 0;
+		for (size_t offset = 0; offset < raw.size(); offset += 65535) {
+			size_t size = std::min(raw.size() - offset, (size_t)65535);
+			zlib.push_back(offset + size == raw.size() ? 1 : 0);
+			zlib.push_back((unsigned char)size);
+			zlib.push_back((unsigned char)(size >> 8));
+			zlib.push_back((unsigned char)~size);
+			zlib.push_back((unsigned char)(~size >> 8));
+			zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+		}
+		for (size_t i = 0; i < raw.size(); i++) {
+			a = (a + raw[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		writeU32(zlib, (b << 16) | a);
+
+		FILE* file = fopen(path, "wb");
+		if (file == NULL) {
+			return false;
+		}
+		const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		fwrite(signature, 1, 8, file);
+		std::vector<unsigned char> header;
+		writeU32(header, mWidth);
+		writeU32(header, mHeight);
+		//8 bit RGB, deflate, standard filtering, not interlaced
+		const unsigned char format[5] = { 8, 2, 0, 0, 0 };
+		header.insert(header.end(), format, format + 5);
+		writeChunk(file, "IHDR", header);
+		writeChunk(file, "IDAT", zlib);
+		writeChunk(file, "IEND", std::vector<unsigned char>());
+		fclose(file);
+		return true;
+	}
+}
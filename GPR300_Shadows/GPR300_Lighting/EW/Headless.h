@@ -0,0 +1,70 @@
+//Author: Sam Fox
+
+#pragma once
+#include <GL/glew.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "Camera.h"
+
+namespace ew {
+	/// <summary>
+	/// --headless [frames] renders that many frames into an offscreen framebuffer of a hidden window, with a scripted camera,
+	/// then quits. Optional: --csv path (default headless.csv), --dump-frames directory, --dump-every n (default 60)
+	/// </summary>
+	struct HeadlessOptions {
+		bool enabled = false;
+		int numFrames = 300;
+		std::string csvPath = "headless.csv";
+		//Empty: no PNGs
+		std::string frameDirectory;
+		int dumpEvery = 60;
+	};
+
+	//False if the arguments are malformed
+	bool parseHeadlessOptions(int argc, char** argv, HeadlessOptions& options);
+
+	/// <summary>
+	/// Drives a headless benchmark run: where the frame is drawn, where the camera is, and what each frame cost.
+	/// CPU time is wall time from beginFrame to endFrame. GPU time comes from timestamp queries read a few frames later,
+	/// so measuring never stalls the pipeline it measures. Does nothing when the options aren't enabled.
+	/// </summary>
+	class HeadlessRun {
+	public:
+		//Frames in flight before a query is read back
+		static const int QUERY_LATENCY = 4;
+
+		HeadlessRun(const HeadlessOptions& options, int width, int height);
+		~HeadlessRun();
+
+		bool isEnabled() const { return mOptions.enabled; }
+		bool isDone() const { return mOptions.enabled && mFrame >= mOptions.numFrames; }
+		int getFrame() const { return mFrame; }
+		//Where the final pass draws, 0 when not headless
+		GLuint getFramebuffer() const { return mFBO; }
+
+		//One orbit of the scene over the run, same frames every run
+		void applyCamera(Camera& camera) const;
+		void beginFrame();
+		//After the final pass, before swapping
+		void endFrame();
+		//Collects the last queries, writes the CSV and prints a summary. False if the CSV couldn't be written
+		bool finish();
+
+	private:
+		HeadlessRun(const HeadlessRun& r) = delete;
+		void readQueries(int slot);
+		bool writePNG(const char* path);
+
+		HeadlessOptions mOptions;
+		int mWidth, mHeight;
+		GLuint mFBO, mColorTexture, mDepthRenderbuffer;
+		//Begin and end timestamp per frame in flight
+		GLuint mQueries[QUERY_LATENCY][2];
+		int mQueryFrames[QUERY_LATENCY];
+		int mFrame;
+		std::chrono::high_resolution_clock::time_point mFrameStart;
+		std::vector<double> mCpuMs;
+		std::vector<double> mGpuMs;
+	};
+}
@@ -0,0 +1,123 @@
+//Author: Sam Fox
+
+#include "HiZ.h"
+#include "GLState.h"
+#include <glm/glm.hpp>
+#include <stdio.h>
+
+namespace ew {
+	//local_size of hiZReduce.comp
+	static const int REDUCE_GROUP_SIZE = 8;
+
+	HiZBuffer::HiZBuffer(const char* reduceShaderPath, int screenWidth, int screenHeight)
+		: mReduceShader(reduceShaderPath), mDepthTexture(0), mPyramid(0), mDepthWidth(0), mDepthHeight(0), mWidth(0), mHeight(0), mNumLevels(0)
+	{
+		glGenFramebuffers(1, &mFBO);
+		resize(screenWidth, screenHeight);
+	}
+
+	HiZBuffer::~HiZBuffer()
+	{
+		deleteTextures();
+		GLState::get().deleteFramebuffers(1, &mFBO);
+	}
+
+	void HiZBuffer::resize(int screenWidth, int screenHeight)
+	{
+		int width = glm::max(1, screenWidth / SCREEN_DIVISOR);
+		int height = glm::max(1, screenHeight / SCREEN_DIVISOR);
+		if (width == mDepthWidth && height == mDepthHeight) {
+			return;
+		}
+		mDepthWidth = width;
+		mDepthHeight = height;
+		mWidth = mHeight = 1;
+		while (mWidth * 2 <= width) {
+			mWidth *= 2;
+		}
+		while (mHeight * 2 <= height) {
+			mHeight *= 2;
+		}
+		deleteTextures();
+		createTextures();
+	}
+
+	void HiZBuffer::createTextures()
+	{
+		mNumLevels = 1;
+		while ((mWidth >> mNumLevels) > 0 || (mHeight >> mNumLevels) > 0) {
+			mNumLevels++;
+		}
+
+		glGenTextures(1, &mDepthTexture);
+		GLState::get().bindTexture(GL_TEXTURE_2D, mDepthTexture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, mDepthWidth, mDepthHeight);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		//Depth can't be bound as an image, so the pyramid is its own R32F texture, level 0 reduced from the depth
+		glGenTextures(1, &mPyramid);
+		GLState::get().bindTexture(GL_TEXTURE_2D, mPyramid);
+		glTexStorage2D(GL_TEXTURE_2D, mNumLevels, GL_R32F, mWidth, mHeight);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, mFBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, mDepthTexture, 0);
+		GLState::get().drawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			printf("HiZBuffer: depth framebuffer is incomplete\n");
+		}
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void HiZBuffer::deleteTextures()
+	{
+		if (mDepthTexture != 0) {
+			GLState::get().deleteTextures(1, &mDepthTexture);
+			GLState::get().deleteTextures(1, &mPyramid);
+			mDepthTexture = mPyramid = 0;
+		}
+	}
+
+	void HiZBuffer::beginOccluders()
+	{
+		GLState::get().getViewport(mSavedViewport);
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, mFBO);
+		GLState::get().viewport(0, 0, mDepthWidth, mDepthHeight);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	void HiZBuffer::endOccluders()
+	{
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::get().viewport(mSavedViewport[0], mSavedViewport[1], mSavedViewport[2], mSavedViewport[3]);
+
+		mReduceShader.use();
+		GLState::get().bindTexture(0, GL_TEXTURE_2D, mDepthTexture);
+		mReduceShader.setInt("_Depth", 0);
+		for (int level = 0; level < mNumLevels; level++)
+		{
+			int width = glm::max(1, mWidth >> level);
+			int height = glm::max(1, mHeight >> level);
+			//Level 0 reduces the depth, every other level the one before it
+			mReduceShader.setInt("_FromDepth", level == 0 ? 1 : 0);
+			if (level > 0) {
+				glBindImageTexture(1, mPyramid, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+			}
+			glBindImageTexture(0, mPyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+			glDispatchCompute((width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, (height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		}
+		//Culling samples the finished pyramid
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	void HiZBuffer::bind(int unit) const
+	{
+		GLState::get().bindTexture(unit, GL_TEXTURE_2D, mPyramid);
+	}
+}
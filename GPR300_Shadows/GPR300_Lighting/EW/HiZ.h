@@ -0,0 +1,46 @@
+//Author: Sam Fox
+
+#pragma once
+#include <GL/glew.h>
+#include "Shader.h"
+
+namespace ew {
+	/// <summary>
+	/// Hierarchical depth for occlusion culling. The big occluders are drawn depth only into a small target,
+	/// then each mip of the pyramid keeps the farthest depth of the 2x2 texels below it.
+	/// An object whose nearest depth is behind the farthest depth over its whole screen rectangle is hidden.
+	/// The pyramid is a power of two, so a texel at any level covers exactly the same screen area as the ones below it.
+	/// </summary>
+	class HiZBuffer {
+	public:
+		//Occluder depth is drawn at the screen size divided by this
+		static const int SCREEN_DIVISOR = 2;
+
+		HiZBuffer(const char* reduceShaderPath, int screenWidth, int screenHeight);
+		~HiZBuffer();
+		void resize(int screenWidth, int screenHeight);
+
+		//Binds and clears the depth target, draw the occluders with the camera's view projection in between
+		void beginOccluders();
+		//Builds the pyramid. Leaves the framebuffer unbound and the viewport as it was
+		void endOccluders();
+
+		void bind(int unit) const;
+		//Pyramid size, the largest power of two that fits the occluder depth
+		int getWidth() const { return mWidth; }
+		int getHeight() const { return mHeight; }
+		int getNumLevels() const { return mNumLevels; }
+
+	private:
+		HiZBuffer(const HiZBuffer& r) = delete;
+		void createTextures();
+		void deleteTextures();
+
+		Shader mReduceShader;
+		GLuint mFBO, mDepthTexture, mPyramid;
+		int mDepthWidth, mDepthHeight;
+		int mWidth, mHeight;
+		int mNumLevels;
+		GLint mSavedViewport[4];
+	};
+}
@@ -0,0 +1,345 @@
+//Author: Sam Fox
+
+#include "JobSystem.h"
+#include "CPUProfiler.h"
+#include <algorithm>
+
+namespace ew {
+	//Index into mQueues of the thread this runs on, -1 for threads the job system didn't start
+	static thread_local int threadIndex = -1;
+
+	//Tries a worker makes at finding a job before it goes to sleep
+	static const int SPINS_BEFORE_SLEEP = 64;
+
+	JobSystem::Deque::Deque()
+		: mTop(0), mBottom(0)
+	{
+		for (int i = 0; i < MAX_JOBS_PER_THREAD; i++) {
+			mJobs[i].store(NULL, std::memory_order_relaxed);
+		}
+	}
+
+	bool JobSystem::Deque::isEmpty() const
+	{
+		return mBottom.load(std::memory_order_relaxed) <= mTop.load(std::memory_order_relaxed);
+	}
+
+	bool JobSystem::Deque::push(Job* job)
+	{
+		long long bottom = mBottom.load(std::memory_order_relaxed);
+		long long top = mTop.load(std::memory_order_acquire);
+		if (bottom - top >= MAX_JOBS_PER_THREAD) {
+			return false;
+		}
+		mJobs[bottom & (MAX_JOBS_PER_THREAD - 1)].store(job, std::memory_order_relaxed);
+		//Publishes the job and everything written to it before
+		mBottom.store(bottom + 1, std::memory_order_release);
+		return true;
+	}
+
+	JobSystem::Job* JobSystem::Deque::pop()
+	{
+		//Claims the bottom job before looking at top, a thief that read the old bottom races for it below.
+		//Sequentially consistent instead of fences, which race detectors can't follow
+		long long bottom = mBottom.load(std::memory_order_relaxed) - 1;
+		mBottom.store(bottom, std::memory_order_seq_cst);
+		long long top = mTop.load(std::memory_order_seq_cst);
+		if (top > bottom) {
+			mBottom.store(bottom + 1, std::memory_order_relaxed);
+			return NULL;
+		}
+		Job* job = mJobs[bottom & (MAX_JOBS_PER_THREAD - 1)].load(std::memory_order_relaxed);
+		if (top == bottom) {
+			//Last one, whoever moves top first gets it
+			if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				job = NULL;
+			}
+			mBottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	JobSystem::Job* JobSystem::Deque::steal()
+	{
+		long long top = mTop.load(std::memory_order_seq_cst);
+		long long bottom = mBottom.load(std::memory_order_seq_cst);
+		if (top >= bottom) {
+			return NULL;
+		}
+		Job* job = mJobs[top & (MAX_JOBS_PER_THREAD - 1)].load(std::memory_order_relaxed);
+		//Lost to the owner or another thief
+		if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			return NULL;
+		}
+		return job;
+	}
+
+	JobSystem& JobSystem::get()
+	{
+		static JobSystem jobSystem;
+		return jobSystem;
+	}
+
+	JobSystem::JobSystem()
+		: mNumWorkers(0), mQuit(false), mThreadLimit(0), mNumQueued(0), mNumSleeping(0), mNumStolen(0), mNumPending(0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		mNumWorkers = hardwareThreads > 1 ? (int)hardwareThreads - 1 : 0;
+		for (int i = 0; i <= mNumWorkers; i++)
+		{
+			ThreadQueue* queue = new ThreadQueue();
+			queue->nextJob = 0;
+			for (int j = 0; j < MAX_JOBS_PER_THREAD; j++) {
+				queue->jobs[j].busy.store(false, std::memory_order_relaxed);
+			}
+			mQueues.push_back(queue);
+		}
+		threadIndex = 0;
+		for (int i = 1; i <= mNumWorkers; i++) {
+			mThreads.push_back(std::thread(&JobSystem::workerLoop, this, i));
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mQuit = true;
+		}
+		mWake.notify_all();
+		for (size_t i = 0; i < mThreads.size(); i++) {
+			mThreads[i].join();
+		}
+		for (size_t i = 0; i < mQueues.size(); i++) {
+			delete mQueues[i];
+		}
+	}
+
+	void JobSystem::run(const JobFunc& func, JobCounter& counter, const JobCounter* dependency)
+	{
+		counter.count.fetch_add(1, std::memory_order_relaxed);
+		if (dependency == NULL || dependency->isDone()) {
+			queue(func, counter);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mPendingMutex);
+			PendingJob pending = { func, &counter, dependency };
+			mPending.push_back(pending);
+			mNumPending.fetch_add(1);
+		}
+		//Whoever finishes the dependency counts it down before looking for pending jobs, and this looks the other way
+		//round, so if it finished in between at least one of the two sees the other
+		if (dependency->count.load() == 0) {
+			releasePending();
+		}
+	}
+
+	void JobSystem::queue(const JobFunc& func, JobCounter& counter)
+	{
+		int thread = threadIndex;
+		if (thread >= 0)
+		{
+			ThreadQueue& queue = *mQueues[thread];
+			//Every job in the deque holds a slot, so a free slot also means the push fits
+			Job& job = queue.jobs[queue.nextJob & (MAX_JOBS_PER_THREAD - 1)];
+			if (!job.busy.load(std::memory_order_acquire))
+			{
+				job.busy.store(true, std::memory_order_relaxed);
+				job.func = func;
+				job.counter = &counter;
+				//Before the push, a thief could take it and count it down first
+				mNumQueued.fetch_add(1);
+				queue.deque.push(&job);
+				queue.nextJob++;
+
+				//A worker going to sleep bumps mNumSleeping before it checks mNumQueued, so one of the two sees the other
+				if (mNumSleeping.load() > 0) {
+					{
+						std::lock_guard<std::mutex> lock(mMutex);
+					}
+					//Only some workers may take it when there's a limit, any of them could be the one woken
+					if (mThreadLimit.load(std::memory_order_relaxed) > 0) {
+						mWake.notify_all();
+					}
+					else {
+						mWake.notify_one();
+					}
+				}
+				return;
+			}
+		}
+		func();
+		finish(counter);
+	}
+
+	void JobSystem::finish(JobCounter& counter)
+	{
+		//Nothing may touch counter after this, whoever waits on it can go on
+		if (counter.count.fetch_sub(1) == 1 && mNumPending.load() > 0) {
+			releasePending();
+		}
+	}
+
+	void JobSystem::releasePending()
+	{
+		std::vector<PendingJob> ready;
+		{
+			std::lock_guard<std::mutex> lock(mPendingMutex);
+			for (size_t i = 0; i < mPending.size(); )
+			{
+				if (mPending[i].dependency->isDone()) {
+					ready.push_back(mPending[i]);
+					mPending.erase(mPending.begin() + i);
+				}
+				else {
+					i++;
+				}
+			}
+			mNumPending.fetch_sub((int)ready.size());
+		}
+		for (size_t i = 0; i < ready.size(); i++) {
+			queue(ready[i].func, *ready[i].counter);
+		}
+	}
+
+	void JobSystem::wait(const JobCounter& counter)
+	{
+		int thread = threadIndex;
+		while (!counter.isDone())
+		{
+			int owner;
+			Job* job = findJob(thread, owner);
+			if (job != NULL) {
+				execute(job, thread, owner);
+			}
+			else {
+				//Whatever is left is running on other threads, or waiting for something that is
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void JobSystem::parallelFor(int count, int minBatch, const RangeFunc& func)
+	{
+		if (count <= 0) {
+			return;
+		}
+		int grain = std::max(minBatch, 1);
+		if (count <= grain || getNumThreads() == 1 || threadIndex < 0) {
+			func(0, count);
+			return;
+		}
+		JobCounter counter;
+		runRange(0, count, grain, &func, &counter);
+		wait(counter);
+	}
+
+	void JobSystem::runRange(int begin, int end, int grain, const RangeFunc* func, JobCounter* counter)
+	{
+		PROFILE_CPU("ParallelFor");
+		int thread = threadIndex;
+		bool canSplit = thread >= 0 && getNumThreads() > 1;
+		while (begin < end)
+		{
+			//Empty means a thief took the last half handed out, so there's someone to take another
+			if (canSplit && end - begin >= grain * 2 && mQueues[thread]->deque.isEmpty()) {
+				int middle = begin + (end - begin) / 2;
+				run([this, middle, end, grain, func, counter]() { runRange(middle, end, grain, func, counter); }, *counter);
+				end = middle;
+			}
+			else {
+				int stop = std::min(begin + grain, end);
+				(*func)(begin, stop);
+				begin = stop;
+			}
+		}
+	}
+
+	int JobSystem::getNumThreads() const
+	{
+		int numThreads = mNumWorkers + 1;
+		int limit = mThreadLimit.load(std::memory_order_relaxed);
+		return limit > 0 && limit < numThreads ? limit : numThreads;
+	}
+
+	void JobSystem::setThreadLimit(int numThreads)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mThreadLimit = numThreads > 0 ? numThreads : 0;
+		}
+		mWake.notify_all();
+	}
+
+	void JobSystem::workerLoop(int thread)
+	{
+		threadIndex = thread;
+		CPUProfiler::setThreadName("Worker");
+		int idleSpins = 0;
+		while (!mQuit.load())
+		{
+			if (thread < getNumThreads())
+			{
+				int owner;
+				Job* job = findJob(thread, owner);
+				if (job != NULL) {
+					execute(job, thread, owner);
+					idleSpins = 0;
+					continue;
+				}
+				if (++idleSpins < SPINS_BEFORE_SLEEP) {
+					std::this_thread::yield();
+					continue;
+				}
+			}
+			idleSpins = 0;
+			std::unique_lock<std::mutex> lock(mMutex);
+			mNumSleeping.fetch_add(1);
+			mWake.wait(lock, [&]() { return mQuit.load() || (thread < getNumThreads() && mNumQueued.load() > 0); });
+			mNumSleeping.fetch_sub(1);
+		}
+	}
+
+	JobSystem::Job* JobSystem::findJob(int thread, int& owner)
+	{
+		int numQueues = (int)mQueues.size();
+		if (thread >= 0) {
+			Job* job = mQueues[thread]->deque.pop();
+			if (job != NULL) {
+				owner = thread;
+				mNumQueued.fetch_sub(1);
+				return job;
+			}
+		}
+		//Starting after our own spreads thieves over the victims
+		for (int i = 1; i <= numQueues; i++)
+		{
+			int victim = (thread + i + numQueues) % numQueues;
+			if (victim == thread) {
+				continue;
+			}
+			Job* job = mQueues[victim]->deque.steal();
+			if (job != NULL) {
+				owner = victim;
+				mNumQueued.fetch_sub(1);
+				return job;
+			}
+		}
+		return NULL;
+	}
+
+	void JobSystem::execute(Job* job, int thread, int owner)
+	{
+		if (thread != owner) {
+			mNumStolen.fetch_add(1, std::memory_order_relaxed);
+		}
+		JobCounter* counter = job->counter;
+		job->func();
+		//Let go of whatever it captured now rather than when the slot comes around again
+		job->func = JobFunc();
+		//Last touch of the job, the thread that queued it can reuse the slot after this
+		job->busy.store(false, std::memory_order_release);
+		finish(*counter);
+	}
+}
@@ -0,0 +1,127 @@
+//Author: Sam Fox
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ew {
+	/// <summary>
+	/// Jobs started with it that haven't finished yet. Has to outlive every one of them, and every job that depends on it
+	/// </summary>
+	struct JobCounter {
+		std::atomic<int> count;
+
+		JobCounter() : count(0) {}
+		bool isDone() const { return count.load(std::memory_order_acquire) == 0; }
+	};
+
+	/// <summary>
+	/// A worker thread per core but one, plus whichever thread created it. Each of those has its own Chase-Lev deque of jobs:
+	/// it pushes and pops at the bottom, idle threads steal from the top, so no lock is taken unless a job has to wait for
+	/// another or a worker runs out of work and goes to sleep. A thread waiting on a counter runs jobs until it's done.
+	/// Jobs must not touch GL, only the thread that created the job system owns the context.
+	/// </summary>
+	class JobSystem {
+	public:
+		typedef std::function<void()> JobFunc;
+		typedef std::function<void(int, int)> RangeFunc;
+		//Per thread, jobs started and not finished. Past it jobs run on the spot
+		static const int MAX_JOBS_PER_THREAD = 4096;
+
+		static JobSystem& get();
+		~JobSystem();
+
+		//Queues func, counter goes up now and back down when it's done. With a dependency, func is held back until that
+		//counter is done. From a thread the job system doesn't know it runs on the spot
+		void run(const JobFunc& func, JobCounter& counter, const JobCounter* dependency = NULL);
+		//Runs queued jobs, its own first, until counter reaches 0
+		void wait(const JobCounter& counter);
+		//Calls func(begin, end) on sub ranges of [0, count), returns when all of them are done. Starts as one range that
+		//hands half of what's left to the deque whenever a thief emptied it, so ranges only get as small as idle threads
+		//make them and never below minBatch. Can be called from inside a job
+		void parallelFor(int count, int minBatch, const RangeFunc& func);
+
+		//Workers plus the thread that created the job system, capped by setThreadLimit
+		int getNumThreads() const;
+		//Workers past this many threads sleep until it's raised again, 0 for all of them. Meant for benchmarks
+		void setThreadLimit(int numThreads);
+		//Jobs that ran on a different thread than the one that queued them, since the last call
+		int takeNumStolen() { return mNumStolen.exchange(0); }
+
+	private:
+		JobSystem();
+		JobSystem(const JobSystem& r) = delete;
+
+		struct Job {
+			JobFunc func;
+			JobCounter* counter;
+			//Set while queued or running, the slot can't be reused until it's cleared
+			std::atomic<bool> busy;
+		};
+
+		/// <summary>
+		/// Chase-Lev deque over a fixed ring. Only the owner calls push and pop, anyone can call steal
+		/// </summary>
+		class Deque {
+		public:
+			Deque();
+			bool isEmpty() const;
+			//False if full
+			bool push(Job* job);
+			Job* pop();
+			Job* steal();
+
+		private:
+			std::atomic<long long> mTop;
+			std::atomic<long long> mBottom;
+			std::atomic<Job*> mJobs[MAX_JOBS_PER_THREAD];
+		};
+
+		//Everything one thread needs to queue jobs
+		struct ThreadQueue {
+			Deque deque;
+			Job jobs[MAX_JOBS_PER_THREAD];
+			unsigned int nextJob;
+		};
+
+		//A job whose dependency wasn't done when it was run
+		struct PendingJob {
+			JobFunc func;
+			JobCounter* counter;
+			const JobCounter* dependency;
+		};
+
+		//counter was already counted up
+		void queue(const JobFunc& func, JobCounter& counter);
+		void finish(JobCounter& counter);
+		//Queues every pending job whose dependency is done on the calling thread
+		void releasePending();
+		void runRange(int begin, int end, int grain, const RangeFunc* func, JobCounter* counter);
+
+		void workerLoop(int thread);
+		//Own deque first, then the others. Thread is -1 for threads the job system doesn't know, owner is the deque it came from
+		Job* findJob(int thread, int& owner);
+		void execute(Job* job, int thread, int owner);
+
+		//Fixed before the first worker starts, workers read it
+		int mNumWorkers;
+		std::vector<std::thread> mThreads;
+		std::vector<ThreadQueue*> mQueues;
+		std::atomic<bool> mQuit;
+		std::atomic<int> mThreadLimit;
+		//Jobs sitting in a deque, so a worker knows whether it can sleep
+		std::atomic<int> mNumQueued;
+		std::atomic<int> mNumSleeping;
+		std::atomic<int> mNumStolen;
+		std::mutex mMutex;
+		std::condition_variable mWake;
+
+		std::mutex mPendingMutex;
+		std::vector<PendingJob> mPending;
+		std::atomic<int> mNumPending;
+	};
+}
@@ -0,0 +1,38 @@
+//Author: Sam Fox
+
+#include "LOD.h"
+#include <float.h>
+#include <math.h>
+
+namespace ew {
+	LODSelector::LODSelector(float fullDetailPixels, float hysteresis)
+		: mFullDetailPixels(fullDetailPixels), mHysteresis(hysteresis), mCameraPosition(0), mProjectionScale(1)
+	{
+	}
+
+	void LODSelector::setView(const glm::vec3& cameraPosition, float fovDegrees, int screenHeight)
+	{
+		mCameraPosition = cameraPosition;
+		mProjectionScale = (float)screenHeight / tanf(glm::radians(fovDegrees) * 0.5f);
+	}
+
+	float LODSelector::getProjectedSize(const BoundingSphere& worldSphere) const
+	{
+		float distance = glm::length(worldSphere.center - mCameraPosition);
+		if (distance <= worldSphere.radius) {
+			return FLT_MAX;
+		}
+		return worldSphere.radius / distance * mProjectionScale;
+	}
+
+	int LODSelector::select(int currentLevel, int numLevels, const BoundingSphere& worldSphere) const
+	{
+		//Continuous level, level n covers [n, n + 1)
+		float level = log2f(mFullDetailPixels / getProjectedSize(worldSphere));
+		if (currentLevel >= 0 && currentLevel < numLevels
+			&& level > currentLevel - mHysteresis && level < currentLevel + 1 + mHysteresis) {
+			return currentLevel;
+		}
+		return glm::clamp((int)floorf(level), 0, numLevels - 1);
+	}
+}
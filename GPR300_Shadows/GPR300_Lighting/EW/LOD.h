@@ -0,0 +1,36 @@
+//Author: Sam Fox
+
+#pragma once
+#include <glm/glm.hpp>
+#include "Bounds.h"
+
+namespace ew {
+	/// <summary>
+	/// Picks a level of a LOD chain from how tall an object's bounding sphere is on screen.
+	/// Each level has half the segments of the one before it, so each is used over half the screen size of the one before it.
+	/// An object only changes level once it is a margin past the boundary, so one sitting right on it doesn't flicker between the two.
+	/// </summary>
+	class LODSelector {
+	public:
+		//fullDetailPixels: screen height (pixels) below which level 0 is no longer needed
+		//hysteresis: how far past a boundary (in levels) before switching
+		LODSelector(float fullDetailPixels = 256.0f, float hysteresis = 0.2f);
+
+		//Once per frame, before select
+		void setView(const glm::vec3& cameraPosition, float fovDegrees, int screenHeight);
+		void setFullDetailPixels(float pixels) { mFullDetailPixels = pixels; }
+		float getFullDetailPixels() const { return mFullDetailPixels; }
+
+		//Height in pixels of the sphere's projection, huge once the camera is inside it
+		float getProjectedSize(const BoundingSphere& worldSphere) const;
+		//Level to use now for an object that drew currentLevel last frame
+		int select(int currentLevel, int numLevels, const BoundingSphere& worldSphere) const;
+
+	private:
+		float mFullDetailPixels;
+		float mHysteresis;
+		glm::vec3 mCameraPosition;
+		//Screen height / tan(fov / 2)
+		float mProjectionScale;
+	};
+}
@@ -0,0 +1,528 @@
+//Author: Sam Fox
+
+//fopen and stat are fine here
+#define _CRT_SECURE_NO_WARNINGS
+#define _CRT_NONSTDC_NO_WARNINGS
+#include "Material.h"
+#include <algorithm>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace ew {
+	//Read only view of a whole file, empty if it can't be opened
+	class MappedFile {
+	public:
+		MappedFile(const std::string& path);
+		~MappedFile();
+		const unsigned char* getData() const { return mData; }
+		size_t getSize() const { return mSize; }
+	private:
+		MappedFile(const MappedFile& r) = delete;
+		const unsigned char* mData;
+		size_t mSize;
+#ifdef _WIN32
+		HANDLE mFile;
+		HANDLE mMapping;
+#endif
+	};
+
+#ifdef _WIN32
+	MappedFile::MappedFile(const std::string& path)
+		: mData(NULL), mSize(0), mFile(INVALID_HANDLE_VALUE), mMapping(NULL)
+	{
+		mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		LARGE_INTEGER size;
+		if (mFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(mFile, &size) || size.QuadPart == 0) {
+			return;
+		}
+		mMapping = CreateFileMappingA(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mMapping != NULL) {
+			mData = (const unsigned char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+			mSize = mData != NULL ? (size_t)size.QuadPart : 0;
+		}
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (mData != NULL) {
+			UnmapViewOfFile(mData);
+		}
+		if (mMapping != NULL) {
+			CloseHandle(mMapping);
+		}
+		if (mFile != INVALID_HANDLE_VALUE) {
+			CloseHandle(mFile);
+		}
+	}
+
+	static void listDirectory(const std::string& directory, std::vector<std::string>& files, std::vector<std::string>& folders)
+	{
+		WIN32_FIND_DATAA entry;
+		HANDLE find = FindFirstFileA((directory + "/*").c_str(), &entry);
+		if (find == INVALID_HANDLE_VALUE) {
+			return;
+		}
+		do {
+			if (strcmp(entry.cFileName, ".") == 0 || strcmp(entry.cFileName, "..") == 0) {
+				continue;
+			}
+			if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+				folders.push_back(directory + "/" + entry.cFileName);
+			}
+			else {
+				files.push_back(directory + "/" + entry.cFileName);
+			}
+		} while (FindNextFileA(find, &entry));
+		FindClose(find);
+	}
+#else
+	MappedFile::MappedFile(const std::string& path)
+		: mData(NULL), mSize(0)
+	{
+		int file = open(path.c_str(), O_RDONLY);
+		if (file < 0) {
+			return;
+		}
+		struct stat info;
+		if (fstat(file, &info) == 0 && info.st_size > 0) {
+			void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+			if (data != MAP_FAILED) {
+				mData = (const unsigned char*)data;
+				mSize = (size_t)info.st_size;
+			}
+		}
+		close(file);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (mData != NULL) {
+			munmap((void*)mData, mSize);
+		}
+	}
+
+	static void listDirectory(const std::string& directory, std::vector<std::string>& files, std::vector<std::string>& folders)
+	{
+		DIR* dir = opendir(directory.c_str());
+		if (dir == NULL) {
+			return;
+		}
+		while (dirent* entry = readdir(dir))
+		{
+			if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+				continue;
+			}
+			std::string path = directory + "/" + entry->d_name;
+			struct stat info;
+			if (stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+				folders.push_back(path);
+			}
+			else {
+				files.push_back(path);
+			}
+		}
+		closedir(dir);
+	}
+#endif
+
+	static bool endsWith(const std::string& text, const char* suffix)
+	{
+		size_t length = strlen(suffix);
+		return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+	}
+
+	static std::string trim(const std::string& text)
+	{
+		size_t begin = text.find_first_not_of(" \t\r\n");
+		if (begin == std::string::npos) {
+			return "";
+		}
+		return text.substr(begin, text.find_last_not_of(" \t\r\n") - begin + 1);
+	}
+
+	//Text between the first open and the next close character, "" if missing
+	static std::string between(const std::string& line, char open, char close)
+	{
+		size_t begin = line.find(open);
+		if (begin == std::string::npos) {
+			return "";
+		}
+		size_t end = line.find(close, begin + 1);
+		return end == std::string::npos ? "" : line.substr(begin + 1, end - begin - 1);
+	}
+
+	//"0.5" or "(0.8, 0.1, 0.1)", returns the number of components read
+	static int parseFloats(const std::string& text, float* values, int maxValues)
+	{
+		const char* c = text.c_str();
+		int count = 0;
+		while (*c != '\0' && count < maxValues)
+		{
+			if (strchr("0123456789.-+", *c) == NULL) {
+				c++;
+				continue;
+			}
+			char* end;
+			values[count++] = strtof(c, &end);
+			c = end == c ? c + 1 : end;
+		}
+		return count;
+	}
+
+	//Lines can be any length, fgets hands them over in pieces
+	static bool readLine(FILE* file, std::string& line)
+	{
+		line.clear();
+		char buffer[256];
+		while (fgets(buffer, sizeof(buffer), file) != NULL)
+		{
+			line += buffer;
+			if (line[line.size() - 1] == '\n') {
+				return true;
+			}
+		}
+		return !line.empty();
+	}
+
+	//What the parser keeps of one shader prim
+	struct UsdShaderPrim {
+		std::string id;
+		std::string file;
+		float fallback[4] = { 0, 0, 0, 1 };
+		bool hasFallback = false;
+		std::map<std::string, std::string> values;      //input -> constant
+		std::map<std::string, std::string> connections; //input -> connected attribute path
+	};
+
+	bool readUsdaMaterial(const std::string& usdaPath, Material& material)
+	{
+		FILE* file = fopen(usdaPath.c_str(), "r");
+		if (file == NULL) {
+			printf("Failed to open material %s\n", usdaPath.c_str());
+			return false;
+		}
+
+		std::map<std::string, UsdShaderPrim> prims; //prim path -> shader
+		std::vector<std::string> scopes;            //one per open brace, "" if it isn't a prim
+		std::string pendingPrim;                    //def seen, brace not yet
+		std::string line;
+		while (readLine(file, line))
+		{
+			line = trim(line);
+			if (line.empty() || line[0] == '#') {
+				continue;
+			}
+
+			if (line.compare(0, 4, "def ") == 0) {
+				pendingPrim = between(line, '"', '"');
+				if (material.name.empty() && line.compare(0, 13, "def Material ") == 0) {
+					material.name = pendingPrim;
+				}
+			}
+			else if (!scopes.empty() && !scopes.back().empty() && line.find('=') != std::string::npos)
+			{
+				std::string path;
+				for (size_t i = 0; i < scopes.size(); i++) {
+					if (!scopes[i].empty()) {
+						path += "/" + scopes[i];
+					}
+				}
+
+				size_t equals = line.find('=');
+				size_t inputs = line.find("inputs:");
+				if (line.find("info:id") != std::string::npos && line.find("info:id") < equals) {
+					prims[path].id = between(line, '"', '"');
+				}
+				else if (inputs != std::string::npos && inputs < equals)
+				{
+					std::string name = trim(line.substr(inputs + 7, equals - inputs - 7));
+					std::string value = trim(line.substr(equals + 1));
+					UsdShaderPrim& prim = prims[path];
+					if (endsWith(name, ".connect")) {
+						prim.connections[name.substr(0, name.size() - 8)] = between(value, '<', '>');
+					}
+					else if (name == "file") {
+						prim.file = between(value, '@', '@');
+					}
+					else if (name == "fallback") {
+						prim.hasFallback = parseFloats(value, prim.fallback, 4) > 0;
+					}
+					else {
+						prim.values[name] = value;
+					}
+				}
+			}
+
+			//Braces inside strings don't open scopes
+			bool quoted = false;
+			for (size_t i = 0; i < line.size(); i++)
+			{
+				if (line[i] == '"') {
+					quoted = !quoted;
+				}
+				else if (!quoted && line[i] == '{') {
+					scopes.push_back(pendingPrim);
+					pendingPrim.clear();
+				}
+				else if (!quoted && line[i] == '}' && !scopes.empty()) {
+					scopes.pop_back();
+				}
+			}
+		}
+		fclose(file);
+
+		std::map<std::string, UsdShaderPrim>::iterator surface = prims.begin();
+		while (surface != prims.end() && surface->second.id != "UsdPreviewSurface") {
+			surface++;
+		}
+		if (surface == prims.end()) {
+			printf("No UsdPreviewSurface in %s\n", usdaPath.c_str());
+			return false;
+		}
+
+		size_t slash = usdaPath.find_last_of("/\\");
+		std::string directory = slash == std::string::npos ? "" : usdaPath.substr(0, slash + 1);
+		struct { const char* input; std::string* map; float* value; int numComponents; } channels[] = {
+			{ "diffuseColor", &material.albedoMap, &material.diffuseColor.x, 3 },
+			{ "normal", &material.normalMap, NULL, 0 },
+			{ "occlusion", &material.occlusionMap, &material.occlusion, 1 },
+			{ "roughness", &material.roughnessMap, &material.roughness, 1 },
+			{ "metallic", &material.metalnessMap, &material.metallic, 1 },
+			{ "displacement", &material.displacementMap, &material.displacement, 1 },
+		};
+		for (size_t i = 0; i < sizeof(channels) / sizeof(channels[0]); i++)
+		{
+			const UsdShaderPrim& shader = surface->second;
+			std::map<std::string, std::string>::const_iterator connection = shader.connections.find(channels[i].input);
+			if (connection == shader.connections.end())
+			{
+				std::map<std::string, std::string>::const_iterator value = shader.values.find(channels[i].input);
+				if (value != shader.values.end() && channels[i].value != NULL) {
+					parseFloats(value->second, channels[i].value, channels[i].numComponents);
+				}
+				continue;
+			}
+
+			//</Material/roughness.outputs:r>
+			size_t outputs = connection->second.find(".outputs:");
+			std::map<std::string, UsdShaderPrim>::const_iterator texture = prims.find(connection->second.substr(0, outputs));
+			if (outputs == std::string::npos || texture == prims.end() || texture->second.file.empty()) {
+				continue;
+			}
+			std::string file = texture->second.file;
+			*channels[i].map = directory + (file.compare(0, 2, "./") == 0 ? file.substr(2) : file);
+
+			if (channels[i].value != NULL && texture->second.hasFallback)
+			{
+				//Single channel outputs pick their component of the fallback
+				static const char COMPONENTS[] = "rgba";
+				std::string output = connection->second.substr(outputs + 9);
+				const char* component = output.size() == 1 ? strchr(COMPONENTS, output[0]) : NULL;
+				int first = component != NULL ? (int)(component - COMPONENTS) : 0;
+				for (int c = 0; c < channels[i].numComponents; c++) {
+					channels[i].value[c] = texture->second.fallback[std::min(first + c, 3)];
+				}
+			}
+		}
+		return true;
+	}
+
+	//Cache layout: "EWMC", version, count, then per material the source path, its time and size and the Material fields.
+	//Strings are a uint16 length followed by the characters
+	static const unsigned int CACHE_VERSION = 1;
+
+	struct CachedMaterial {
+		unsigned long long modifiedTime;
+		unsigned long long fileSize;
+		Material material;
+	};
+
+	static void writeBytes(std::vector<unsigned char>& out, const void* data, size_t size)
+	{
+		out.insert(out.end(), (const unsigned char*)data, (const unsigned char*)data + size);
+	}
+
+	static void writeString(std::vector<unsigned char>& out, const std::string& text)
+	{
+		unsigned short length = (unsigned short)std::min(text.size(), (size_t)0xFFFF);
+		writeBytes(out, &length, sizeof(length));
+		writeBytes(out, text.c_str(), length);
+	}
+
+	//Bounds checked cursor over the mapped cache
+	class CacheReader {
+	public:
+		CacheReader(const unsigned char* data, size_t size) : mData(data), mSize(size), mPos(0), mValid(data != NULL) {}
+		bool isValid() const { return mValid; }
+		void read(void* out, size_t size) {
+			if (!mValid || mSize - mPos < size) {
+				mValid = false;
+				memset(out, 0, size);
+				return;
+			}
+			memcpy(out, mData + mPos, size);
+			mPos += size;
+		}
+		std::string readString() {
+			unsigned short length = 0;
+			read(&length, sizeof(length));
+			if (!mValid || mSize - mPos < length) {
+				mValid = false;
+				return "";
+			}
+			mPos += length;
+			return std::string((const char*)mData + mPos - length, length);
+		}
+	private:
+		const unsigned char* mData;
+		size_t mSize;
+		size_t mPos;
+		bool mValid;
+	};
+
+	static std::string* materialStrings(Material& material, int i)
+	{
+		std::string* strings[] = { &material.name, &material.albedoMap, &material.normalMap, &material.occlusionMap,
+			&material.roughnessMap, &material.metalnessMap, &material.displacementMap };
+		return i < 7 ? strings[i] : NULL;
+	}
+
+	static float* materialFloats(Material& material, int i)
+	{
+		float* floats[] = { &material.diffuseColor.x, &material.diffuseColor.y, &material.diffuseColor.z,
+			&material.occlusion, &material.roughness, &material.metallic, &material.displacement };
+		return i < 7 ? floats[i] : NULL;
+	}
+
+	static void readCache(const std::string& cachePath, std::map<std::string, CachedMaterial>& cache)
+	{
+		MappedFile file(cachePath);
+		CacheReader reader(file.getData(), file.getSize());
+		char magic[4];
+		unsigned int version, count;
+		reader.read(magic, 4);
+		reader.read(&version, sizeof(version));
+		reader.read(&count, sizeof(count));
+		if (!reader.isValid() || memcmp(magic, "EWMC", 4) != 0 || version != CACHE_VERSION) {
+			return;
+		}
+		for (unsigned int i = 0; i < count && reader.isValid(); i++)
+		{
+			std::string path = reader.readString();
+			CachedMaterial entry;
+			reader.read(&entry.modifiedTime, sizeof(entry.modifiedTime));
+			reader.read(&entry.fileSize, sizeof(entry.fileSize));
+			for (int s = 0; materialStrings(entry.material, s) != NULL; s++) {
+				*materialStrings(entry.material, s) = reader.readString();
+			}
+			for (int f = 0; materialFloats(entry.material, f) != NULL; f++) {
+				reader.read(materialFloats(entry.material, f), sizeof(float));
+			}
+			if (reader.isValid()) {
+				cache[path] = entry;
+			}
+		}
+	}
+
+	static void writeCache(const std::string& cachePath, std::map<std::string, CachedMaterial>& cache)
+	{
+		std::vector<unsigned char> out;
+		unsigned int version = CACHE_VERSION, count = (unsigned int)cache.size();
+		writeBytes(out, "EWMC", 4);
+		writeBytes(out, &version, sizeof(version));
+		writeBytes(out, &count, sizeof(count));
+		for (std::map<std::string, CachedMaterial>::iterator it = cache.begin(); it != cache.end(); it++)
+		{
+			writeString(out, it->first);
+			writeBytes(out, &it->second.modifiedTime, sizeof(it->second.modifiedTime));
+			writeBytes(out, &it->second.fileSize, sizeof(it->second.fileSize));
+			for (int s = 0; materialStrings(it->second.material, s) != NULL; s++) {
+				writeString(out, *materialStrings(it->second.material, s));
+			}
+			for (int f = 0; materialFloats(it->second.material, f) != NULL; f++) {
+				writeBytes(out, materialFloats(it->second.material, f), sizeof(float));
+			}
+		}
+
+		FILE* file = fopen(cachePath.c_str(), "wb");
+		if (file == NULL) {
+			printf("Failed to write material cache %s\n", cachePath.c_str());
+			return;
+		}
+		fwrite(&out[0], 1, out.size(), file);
+		fclose(file);
+	}
+
+	int findMaterials(const std::string& directory, std::vector<Material>& materials)
+	{
+		//Texture sets are one folder deep
+		std::vector<std::string> files, folders;
+		listDirectory(directory, files, folders);
+		for (size_t i = 0; i < folders.size(); i++) {
+			std::vector<std::string> nestedFolders;
+			listDirectory(folders[i], files, nestedFolders);
+		}
+
+		std::vector<std::string> usdaPaths;
+		for (size_t i = 0; i < files.size(); i++) {
+			if (endsWith(files[i], ".usda")) {
+				usdaPaths.push_back(files[i]);
+			}
+		}
+		std::sort(usdaPaths.begin(), usdaPaths.end());
+
+		std::string cachePath = directory + "/" + MATERIAL_CACHE_NAME;
+		std::map<std::string, CachedMaterial> cache;
+		readCache(cachePath, cache);
+
+		std::map<std::string, CachedMaterial> found;
+		int numParsed = 0;
+		for (size_t i = 0; i < usdaPaths.size(); i++)
+		{
+			struct stat info;
+			if (stat(usdaPaths[i].c_str(), &info) != 0) {
+				continue;
+			}
+			std::map<std::string, CachedMaterial>::iterator cached = cache.find(usdaPaths[i]);
+			if (cached != cache.end() && cached->second.modifiedTime == (unsigned long long)info.st_mtime
+				&& cached->second.fileSize == (unsigned long long)info.st_size) {
+				found[usdaPaths[i]] = cached->second;
+			}
+			else
+			{
+				CachedMaterial entry;
+				entry.modifiedTime = (unsigned long long)info.st_mtime;
+				entry.fileSize = (unsigned long long)info.st_size;
+				if (!readUsdaMaterial(usdaPaths[i], entry.material)) {
+					continue;
+				}
+				found[usdaPaths[i]] = entry;
+				numParsed++;
+			}
+			materials.push_back(found[usdaPaths[i]].material);
+		}
+
+		//Also drops entries for deleted files
+		if (numParsed > 0 || found.size() != cache.size()) {
+			writeCache(cachePath, found);
+		}
+		printf("Found %d materials in %s (%d parsed, %d cached)\n", (int)found.size(), directory.c_str(),
+			numParsed, (int)found.size() - numParsed);
+		return (int)found.size();
+	}
+}
@@ -0,0 +1,38 @@
+//Author: Sam Fox
+
+#pragma once
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace ew {
+	/// <summary>
+	/// The UsdPreviewSurface inputs of one material. Texture paths are resolved so the program can open them, empty = not connected.
+	/// Values are the input's constant, or the texture's fallback when it is connected to one.
+	/// </summary>
+	struct Material {
+		std::string name;
+		std::string albedoMap;
+		std::string normalMap;
+		std::string occlusionMap;
+		std::string roughnessMap;
+		std::string metalnessMap;
+		std::string displacementMap;
+		//UsdPreviewSurface defaults
+		glm::vec3 diffuseColor = glm::vec3(0.18f);
+		float occlusion = 1.0f;
+		float roughness = 0.5f;
+		float metallic = 0.0f;
+		float displacement = 0.0f;
+	};
+
+	//Written next to the scanned folders, rebuilt whenever a .usda changes
+	const char* const MATERIAL_CACHE_NAME = "materials.ewcache";
+
+	//Reads the file line by line, no scene description is kept in memory. Only ASCII .usda, not binary .usdc
+	bool readUsdaMaterial(const std::string& usdaPath, Material& material);
+
+	//Finds the .usda files in directory and its sub folders, e.g. ./PavingStones130_1K-JPG/PavingStones130_1K-JPG.usda.
+	//Unchanged files are read from the memory mapped cache instead of being parsed. Returns the number appended to materials
+	int findMaterials(const std::string& directory, std::vector<Material>& materials);
+}
@@ -0,0 +1,163 @@
+//Author: Sam Fox
+
+#include "MaterialTable.h"
+#include "GLState.h"
+#include "Texture.h"
+#include "Parallel.h"
+#include <stdio.h>
+
+namespace ew {
+	MaterialTable::MaterialTable()
+		: mBindless(false), mMaterialBuffer(0), mTextureArray(0)
+	{
+		glGenBuffers(1, &mMaterialBuffer);
+	}
+
+	MaterialTable::~MaterialTable()
+	{
+		for (size_t i = 0; i < mHandles.size(); i++) {
+			glMakeTextureHandleNonResidentARB(mHandles[i]);
+		}
+		if (!mTextures.empty()) {
+			GLState::get().deleteTextures((GLsizei)mTextures.size(), &mTextures[0]);
+		}
+		GLState::get().deleteTextures(1, &mTextureArray);
+		glDeleteBuffers(1, &mMaterialBuffer);
+	}
+
+	int MaterialTable::findOrAddTexture(const std::string& path)
+	{
+		for (size_t i = 0; i < mSources.size(); i++) {
+			if (mSources[i].key == path) {
+				return (int)i;
+			}
+		}
+		TextureSource source;
+		source.key = path;
+		source.packed = false;
+		mSources.push_back(source);
+		return (int)mSources.size() - 1;
+	}
+
+	int MaterialTable::findOrAddPackedTexture(const Material& material)
+	{
+		std::string key = "orm:" + material.occlusionMap + "|" + material.roughnessMap + "|" + material.metalnessMap + "|" + material.displacementMap;
+		for (size_t i = 0; i < mSources.size(); i++) {
+			if (mSources[i].key == key) {
+				return (int)i;
+			}
+		}
+		TextureSource source;
+		source.key = key;
+		source.material = material;
+		source.packed = true;
+		mSources.push_back(source);
+		return (int)mSources.size() - 1;
+	}
+
+	int MaterialTable::addMaterial(const std::string& albedoPath, const glm::vec3& color)
+	{
+		Material material;
+		material.albedoMap = albedoPath;
+		return addMaterial(material, color);
+	}
+
+	int MaterialTable::addMaterial(const Material& material, const glm::vec3& color)
+	{
+		MaterialDesc desc;
+		//Color only, e.g. USD materials with just a diffuse color
+		desc.albedoTexture = material.albedoMap.empty() ? -1 : findOrAddTexture(material.albedoMap);
+		desc.isVirtual = false;
+		desc.ormTexture = hasORM(material) ? findOrAddPackedTexture(material) : -1;
+		desc.color = material.albedoMap.empty() ? material.diffuseColor * color : color;
+		mMaterials.push_back(desc);
+		return (int)mMaterials.size() - 1;
+	}
+
+	bool MaterialTable::loadSource(int source, ImageData& image)
+	{
+		if (mSources[source].packed) {
+			return packORM(mSources[source].material, image);
+		}
+		return loadImage(mSources[source].key.c_str(), image, 4);
+	}
+
+	int MaterialTable::addVirtualMaterial(const glm::vec3& color)
+	{
+		MaterialDesc material;
+		material.albedoTexture = -1;
+		material.isVirtual = true;
+		material.ormTexture = -1;
+		material.color = color;
+		mMaterials.push_back(material);
+		return (int)mMaterials.size() - 1;
+	}
+
+	void MaterialTable::upload(bool allowBindless)
+	{
+		mBindless = allowBindless && GLEW_ARB_bindless_texture;
+
+		//Decoding is most of the load time and no two sources share anything
+		std::vector<ImageData> images(mSources.size());
+		std::vector<unsigned char> loaded(mSources.size());
+		parallelFor((int)mSources.size(), 1, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				loaded[i] = loadSource(i, images[i]) ? 1 : 0;
+			}
+		});
+		for (size_t i = 0; i < mSources.size(); i++)
+		{
+			if (!loaded[i]) {
+				//Keep indices stable, a white texel stands in for the missing file
+				images[i].width = images[i].height = 1;
+				images[i].numComponents = 4;
+				images[i].pixels.assign(4, 255);
+			}
+		}
+
+		if (mBindless)
+		{
+			for (size_t i = 0; i < images.size(); i++)
+			{
+				//Sampler state is frozen once a handle exists, so createTexture2D sets it first
+				GLuint texture = createTexture2D(images[i]);
+				GLuint64 handle = glGetTextureHandleARB(texture);
+				glMakeTextureHandleResidentARB(handle);
+				mTextures.push_back(texture);
+				mHandles.push_back(handle);
+			}
+		}
+		else if (!images.empty())
+		{
+			mTextureArray = createTextureArray(images);
+		}
+
+		std::vector<GPUMaterial> gpuMaterials(mMaterials.size());
+		for (size_t i = 0; i < mMaterials.size(); i++)
+		{
+			int albedo = mMaterials[i].albedoTexture;
+			int orm = mMaterials[i].ormTexture;
+			gpuMaterials[i].albedoHandle = mBindless && albedo >= 0 ? mHandles[albedo] : 0;
+			gpuMaterials[i].ormHandle = mBindless && orm >= 0 ? mHandles[orm] : 0;
+			gpuMaterials[i].albedoLayer = (float)glm::max(albedo, 0);
+			gpuMaterials[i].ormLayer = (float)glm::max(orm, 0);
+			gpuMaterials[i].flags = (mMaterials[i].isVirtual ? MATERIAL_VIRTUAL : 0) | (orm >= 0 ? MATERIAL_ORM : 0) | (albedo >= 0 ? MATERIAL_ALBEDO : 0);
+			gpuMaterials[i].pad = 0;
+			gpuMaterials[i].color = glm::vec4(mMaterials[i].color, 1);
+		}
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mMaterialBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, gpuMaterials.size() * sizeof(GPUMaterial), gpuMaterials.empty() ? NULL : &gpuMaterials[0], GL_STATIC_DRAW);
+
+		printf("Material table: %d materials, %d textures, %s\n", (int)mMaterials.size(), (int)mSources.size(),
+			mBindless ? "bindless" : "texture array fallback");
+	}
+
+	void MaterialTable::bind(GLuint arrayTextureUnit)
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, mMaterialBuffer);
+		if (!mBindless) {
+			GLState::get().bindTexture(arrayTextureUnit, GL_TEXTURE_2D_ARRAY, mTextureArray);
+		}
+	}
+}
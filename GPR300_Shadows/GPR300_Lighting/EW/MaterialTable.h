@@ -0,0 +1,80 @@
+//Author: Sam Fox
+
+#pragma once
+#include "GL/glew.h"
+#include "TexturePacking.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace ew {
+	/// <summary>
+	/// All materials of a scene in one SSBO (std430, binding 1).
+	/// With GL_ARB_bindless_texture each material stores a resident texture handle,
+	/// otherwise every texture becomes a layer of one array texture and the material stores the layer.
+	/// Occlusion, roughness, metalness and displacement are channel packed into one ORM texture per material.
+	/// </summary>
+	class MaterialTable {
+	public:
+		static const GLuint MATERIAL_BINDING = 1;
+		//GPUMaterial::flags
+		static const GLuint MATERIAL_VIRTUAL = 1;
+		static const GLuint MATERIAL_ORM = 2;
+		static const GLuint MATERIAL_ALBEDO = 4;
+
+		MaterialTable();
+		~MaterialTable();
+		//Returns the index shaders use to look the material up. Only valid before upload()
+		int addMaterial(const std::string& albedoPath, const glm::vec3& color = glm::vec3(1));
+		//Without an albedo map the material's diffuse color is used instead
+		int addMaterial(const Material& material, const glm::vec3& color = glm::vec3(1));
+		//Material whose albedo comes from the bound virtual texture instead of the table
+		int addVirtualMaterial(const glm::vec3& color = glm::vec3(1));
+		//Loads every texture. allowBindless = false forces the array texture fallback
+		void upload(bool allowBindless = true);
+		//arrayTextureUnit is only used by the fallback path
+		void bind(GLuint arrayTextureUnit);
+		bool isBindless() const { return mBindless; }
+		int getNumMaterials() const { return (int)mMaterials.size(); }
+		//Defines the batched shaders need to pick the matching path
+		std::string getShaderDefines() const { return mBindless ? "#define BINDLESS" : ""; }
+	private:
+		MaterialTable(const MaterialTable& r) = delete;
+		int findOrAddTexture(const std::string& path);
+		int findOrAddPackedTexture(const Material& material);
+		bool loadSource(int source, ImageData& image);
+
+		//Mirrors the Material struct in the batched shaders (std430)
+		struct GPUMaterial {
+			GLuint64 albedoHandle;
+			GLuint64 ormHandle;
+			float albedoLayer;
+			float ormLayer;
+			GLuint flags;
+			GLuint pad;
+			glm::vec4 color;
+		};
+
+		//Either a plain file or channel maps to pack into ORM
+		struct TextureSource {
+			std::string key;
+			Material material;
+			bool packed;
+		};
+
+		struct MaterialDesc {
+			int albedoTexture; //-1 for virtual materials and materials without an albedo map
+			bool isVirtual;
+			int ormTexture;    //-1 if the material has no channel maps
+			glm::vec3 color;
+		};
+
+		bool mBindless;
+		GLuint mMaterialBuffer;
+		GLuint mTextureArray;
+		std::vector<TextureSource> mSources;
+		std::vector<GLuint> mTextures;
+		std::vector<GLuint64> mHandles;
+		std::vector<MaterialDesc> mMaterials;
+	};
+}
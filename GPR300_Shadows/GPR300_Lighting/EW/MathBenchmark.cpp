@@ -0,0 +1,460 @@
+//Author: Sam Fox
+
+#include "MathBenchmark.h"
+#include "EwMath.h"
+#include "SimdMath.h"
+#include "Quaternion.h"
+#include "TransformStore.h"
+#include "Parallel.h"
+#include "JobSystem.h"
+#include "Culling.h"
+#include "CPUProfiler.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace ew {
+	static const int BENCHMARK_RUNS = 5;
+
+	static float randomRange(float min, float max)
+	{
+		return min + (max - min) * (float)rand() / (float)RAND_MAX;
+	}
+
+	//Best of BENCHMARK_RUNS in ns per item, the first run also warms the caches
+	template<typename Func>
+	static double timeBest(int count, Func func)
+	{
+		double best = 1e30;
+		for (int run = 0; run < BENCHMARK_RUNS; run++)
+		{
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			func();
+			std::chrono::duration<double, std::nano> elapsed = std::chrono::high_resolution_clock::now() - start;
+			best = glm::min(best, elapsed.count() / count);
+		}
+		return best;
+	}
+
+	//Reading the results keeps the optimizer from dropping the loops
+	static float checksum(const std::vector<glm::mat4>& matrices)
+	{
+		float sum = 0;
+		for (size_t i = 0; i < matrices.size(); i++) {
+			sum += matrices[i][3][0] + matrices[i][0][0];
+		}
+		return sum;
+	}
+
+	static bool check(const char* name, bool passed)
+	{
+		printf("  %-48s %s\n", name, passed ? "ok" : "FAILED");
+		return passed;
+	}
+
+	bool runMathBenchmark(int count)
+	{
+		std::vector<glm::vec3> positions(count), rotations(count), scales(count);
+		std::vector<glm::mat4> matrices(count), results(count);
+		std::vector<glm::vec4> points(count), transformed(count);
+		srand(1);
+		for (int i = 0; i < count; i++) {
+			positions[i] = glm::vec3(randomRange(-50, 50), randomRange(-50, 50), randomRange(-50, 50));
+			rotations[i] = glm::vec3(randomRange(-3.14f, 3.14f), randomRange(-3.14f, 3.14f), randomRange(-3.14f, 3.14f));
+			scales[i] = glm::vec3(randomRange(0.5f, 2), randomRange(0.5f, 2), randomRange(0.5f, 2));
+			points[i] = glm::vec4(positions[i], 1);
+		}
+		glm::mat4 viewProjection = glm::perspective(1.0f, 1.5f, 0.1f, 100.0f) * glm::lookAt(glm::vec3(0, 5, 10), glm::vec3(0), glm::vec3(0, 1, 0));
+
+		printf("Math benchmark, %d transforms, %s batches\n", count, getSimdPath());
+		float sink = 0;
+
+		//TRS: the ewMath.h chain, the glm equivalent, the direct builder
+		double ewTRS = timeBest(count, [&]() {
+			for (int i = 0; i < count; i++) {
+				results[i] = ew::translate(positions[i]) * ew::rotateX(rotations[i].x) * ew::rotateY(rotations[i].y)
+					* ew::rotateZ(rotations[i].z) * ew::scale(scales[i]);
+			}
+		});
+		sink += checksum(results);
+		double glmTRS = timeBest(count, [&]() {
+			for (int i = 0; i < count; i++) {
+				glm::mat4 m = glm::translate(glm::mat4(1), positions[i]);
+				m = glm::rotate(m, rotations[i].x, glm::vec3(1, 0, 0));
+				m = glm::rotate(m, -rotations[i].y, glm::vec3(0, 1, 0));
+				m = glm::rotate(m, rotations[i].z, glm::vec3(0, 0, 1));
+				results[i] = glm::scale(m, scales[i]);
+			}
+		});
+		sink += checksum(results);
+		double simdTRS = timeBest(count, [&]() {
+			composeTRS(&positions[0], &rotations[0], &scales[0], &matrices[0], count);
+		});
+		sink += checksum(matrices);
+
+		//The builder has to match the chain it replaces
+		float maxError = 0;
+		for (int i = 0; i < count; i++) {
+			glm::mat4 reference = ew::translate(positions[i]) * ew::rotateX(rotations[i].x) * ew::rotateY(rotations[i].y)
+				* ew::rotateZ(rotations[i].z) * ew::scale(scales[i]);
+			for (int c = 0; c < 4; c++) {
+				glm::vec4 difference = glm::abs(reference[c] - matrices[i][c]);
+				maxError = glm::max(maxError, glm::max(glm::max(difference.x, difference.y), glm::max(difference.z, difference.w)));
+			}
+		}
+
+		//Quaternion storage: matrix build, and how close it stays to the Euler convention
+		std::vector<glm::quat> quats(count);
+		for (int i = 0; i < count; i++) {
+			quats[i] = eulerToQuat(rotations[i]);
+		}
+		double quatTRS = timeBest(count, [&]() {
+			composeTRS(&positions[0], &quats[0], &scales[0], &results[0], count);
+		});
+		float quatError = 0, eulerRoundTrip = 0, packError = 0;
+		for (int i = 0; i < count; i++) {
+			glm::mat4 fromEuler = composeTRS(positions[i], quatToEuler(quats[i]), scales[i]);
+			for (int c = 0; c < 4; c++) {
+				quatError = glm::max(quatError, glm::length(results[i][c] - matrices[i][c]));
+				eulerRoundTrip = glm::max(eulerRoundTrip, glm::length(fromEuler[c] - matrices[i][c]));
+			}
+			glm::quat unpacked = unpackQuat(packQuat(quats[i]));
+			packError = glm::max(packError, 1.0f - glm::abs(glm::dot(unpacked, quats[i])));
+		}
+
+		//Euler angles read back for the UI and written again must not turn anything, also at and next to gimbal lock
+		float gimbalRoundTrip = 0;
+		const float pitchOffsets[] = { 0.0f, 1e-6f, 1e-5f, 1e-4f, 1e-3f };
+		for (int sign = -1; sign <= 1; sign += 2) {
+			for (int o = 0; o < 5; o++) {
+				for (int i = 0; i < 64; i++)
+				{
+					glm::vec3 euler(randomRange(-3.14f, 3.14f), sign * (1.5707963f - pitchOffsets[o]), randomRange(-3.14f, 3.14f));
+					glm::quat q = eulerToQuat(euler);
+					gimbalRoundTrip = glm::max(gimbalRoundTrip, 1.0f - glm::abs(glm::dot(q, eulerToQuat(quatToEuler(q)))));
+				}
+			}
+		}
+
+		//Composing a small rotation every frame for an hour at 60fps
+		const int DRIFT_STEPS = 60 * 60 * 60;
+		glm::quat step = eulerToQuat(glm::vec3(0.013f, 0.007f, -0.011f));
+		glm::quat accumulated = glm::quat(1, 0, 0, 0);
+		glm::mat4 matrixAccumulated = glm::mat4(1);
+		glm::mat4 stepMatrix = composeTRS(glm::vec3(0), step, glm::vec3(1));
+		for (int i = 0; i < DRIFT_STEPS; i++) {
+			accumulated = glm::normalize(accumulated * step);
+			matrixAccumulated = mul(matrixAccumulated, stepMatrix);
+		}
+		glm::mat3 rotationPart = glm::mat3(matrixAccumulated);
+		glm::mat3 orthogonality = glm::transpose(rotationPart) * rotationPart;
+		float matrixDrift = glm::length(orthogonality[0] - glm::vec3(1, 0, 0)) + glm::length(orthogonality[1] - glm::vec3(0, 1, 0))
+			+ glm::length(orthogonality[2] - glm::vec3(0, 0, 1));
+		float quatDrift = glm::abs(1.0f - glm::length(accumulated));
+
+		//mat4 * mat4
+		double glmMul = timeBest(count, [&]() {
+			for (int i = 0; i < count; i++) {
+				results[i] = viewProjection * matrices[i];
+			}
+		});
+		sink += checksum(results);
+		double simdMul = timeBest(count, [&]() {
+			for (int i = 0; i < count; i++) {
+				results[i] = mul(viewProjection, matrices[i]);
+			}
+		});
+		sink += checksum(results);
+		double batchMul = timeBest(count, [&]() {
+			mul(viewProjection, &matrices[0], &results[0], count);
+		});
+		sink += checksum(results);
+
+		//mat4 * vec4
+		double glmVec = timeBest(count, [&]() {
+			for (int i = 0; i < count; i++) {
+				transformed[i] = viewProjection * points[i];
+			}
+		});
+		sink += transformed[count / 2].x;
+		double simdVec = timeBest(count, [&]() {
+			for (int i = 0; i < count; i++) {
+				transformed[i] = mul(viewProjection, points[i]);
+			}
+		});
+		sink += transformed[count / 2].x;
+		double batchVec = timeBest(count, [&]() {
+			mul(viewProjection, &points[0], &transformed[0], count);
+		});
+		sink += transformed[count / 2].x;
+
+		printf("  TRS        ewMath chain %7.2f ns   glm chain %7.2f ns   composeTRS %7.2f ns   (max error %g)\n", ewTRS, glmTRS, simdTRS, maxError);
+		printf("  quat TRS   %7.2f ns   (vs Euler %g, Euler round trip %g, packed 1 - |dot| %g)\n", quatTRS, quatError, eulerRoundTrip, packError);
+		printf("  %d composed steps: matrix orthogonality error %g, quaternion length error %g\n", DRIFT_STEPS, matrixDrift, quatDrift);
+		printf("  mat4*mat4  glm %7.2f ns   ew::mul %7.2f ns   batched %7.2f ns\n", glmMul, simdMul, batchMul);
+		printf("  mat4*vec4  glm %7.2f ns   ew::mul %7.2f ns   batched %7.2f ns\n", glmVec, simdVec, batchVec);
+		printf("  (checksum %g)\n", sink);
+		return check("Euler round trip at +-90 degrees pitch, 1 - |dot| < 1e-5", gimbalRoundTrip < 1e-5f);
+	}
+
+	void runTransformBenchmark(int count)
+	{
+		TransformStore store;
+		srand(1);
+		for (int i = 0; i < count; i++) {
+			Transform transform;
+			transform.position = glm::vec3(randomRange(-50, 50), randomRange(-50, 50), randomRange(-50, 50));
+			transform.setEulerAngles(glm::vec3(randomRange(-3.14f, 3.14f), randomRange(-3.14f, 3.14f), randomRange(-3.14f, 3.14f)));
+			store.create(transform);
+		}
+		store.update();
+
+		printf("Transform benchmark, %d transforms, %d threads\n", count, getNumThreads());
+		glm::quat step = glm::angleAxis(0.01f, glm::vec3(0, 1, 0));
+		double all = timeBest(1, [&]() {
+			for (int i = 0; i < count; i++) {
+				store.setRotation(i, store.getRotation(i) * step);
+			}
+			store.update();
+		});
+		double some = timeBest(1, [&]() {
+			for (int i = 0; i < count; i += 10) {
+				store.setRotation(i, store.getRotation(i) * step);
+			}
+			store.update();
+		});
+		double none = timeBest(1, [&]() {
+			store.update();
+		});
+		printf("  all dirty %.3f ms   10%% dirty %.3f ms   clean %.3f ms\n", all / 1e6, some / 1e6, none / 1e6);
+		printf("  (checksum %g)\n", store.getModelMatrix(count / 2)[3][0]);
+	}
+
+	void runCullingBenchmark(int count)
+	{
+		CullingSet set;
+		set.resize(count);
+		std::vector<AABB> boxes(count);
+		std::vector<BoundingSphere> spheres(count);
+		srand(1);
+		for (int i = 0; i < count; i++) {
+			glm::vec3 center(randomRange(-200, 200), randomRange(-20, 20), randomRange(-200, 200));
+			glm::vec3 extents(randomRange(0.25f, 2), randomRange(0.25f, 2), randomRange(0.25f, 2));
+			boxes[i].min = center - extents;
+			boxes[i].max = center + extents;
+			spheres[i].center = center;
+			spheres[i].radius = glm::length(extents);
+			set.setWorldBounds(i, boxes[i], spheres[i]);
+		}
+		Frustum frustum = Frustum::fromMatrix(glm::perspective(glm::radians(60.0f), 1.5f, 0.1f, 300.0f)
+			* glm::lookAt(glm::vec3(0, 10, 0), glm::vec3(1, 9, 1), glm::vec3(0, 1, 0)));
+
+		//Plain loop over the structs to check the result against
+		int expected = 0;
+		for (int i = 0; i < count; i++) {
+			bool inside = true;
+			for (int p = 0; p < FRUSTUM_NUM_PLANES && inside; p++) {
+				glm::vec3 normal = glm::vec3(frustum.planes[p]);
+				float distance = glm::dot(normal, boxes[i].getCenter()) + frustum.planes[p].w;
+				inside = distance + glm::dot(glm::abs(normal), boxes[i].getExtents()) >= 0.0f
+					&& glm::dot(normal, spheres[i].center) + frustum.planes[p].w + spheres[i].radius >= 0.0f;
+			}
+			expected += inside ? 1 : 0;
+		}
+
+#ifdef EW_SIMD_SSE
+		const char* path = "SSE";
+#else
+		const char* path = "Scalar";
+#endif
+		int maxThreads = getNumThreads();
+		printf("Culling benchmark, %d boxes, %s, %d visible\n", count, path, expected);
+		std::vector<int> visible;
+		for (int threads = 1; ; threads = glm::min(threads * 2, maxThreads))
+		{
+			setThreadLimit(threads);
+			int numVisible = 0;
+			double best = timeBest(1, [&]() {
+				numVisible = set.cull(frustum, visible);
+			});
+			printf("  %2d threads %7.3f ms   %5.2f ns per box%s\n", threads, best / 1e6, best / count,
+				numVisible == expected ? "" : "   (visible count differs!)");
+			if (threads == maxThreads) {
+				break;
+			}
+		}
+		setThreadLimit(0);
+	}
+
+	void runProfilerBenchmark(int count)
+	{
+		//Scopes land in the ring, which wraps long before count is reached, so nothing grows
+		bool wasEnabled = CPUProfiler::isEnabled();
+		CPUProfiler::setEnabled(true);
+		double enabled = timeBest(count, [&]() {
+			for (int i = 0; i < count; i++) {
+				PROFILE_CPU("Bench");
+			}
+		});
+		CPUProfiler::setEnabled(false);
+		double disabled = timeBest(count, [&]() {
+			for (int i = 0; i < count; i++) {
+				PROFILE_CPU("Bench");
+			}
+		});
+		CPUProfiler::setEnabled(wasEnabled);
+		//A scope reads the clock twice, under a hypervisor that alone can be most of the cost
+		uint64_t sink = 0;
+		double clock = timeBest(count, [&]() {
+			for (int i = 0; i < count; i++) {
+				sink += CPUProfiler::now();
+			}
+		});
+		printf("Profiler benchmark, %d scopes\n", count);
+		printf("  enabled %6.2f ns per scope   disabled %6.2f ns per scope   (budget 50 ns)\n", enabled, disabled);
+		printf("  clock read %6.2f ns   (checksum %d)\n", clock, (int)(sink & 1));
+	}
+
+	//Costs more the higher i is, so ranges of the same length don't take the same time
+	static float unevenWork(int i, int count)
+	{
+		float x = (float)i;
+		int steps = 1 + (int)(128LL * i / count);
+		for (int step = 0; step < steps; step++) {
+			x = sinf(x) + 1.0f;
+		}
+		return x;
+	}
+
+	bool runJobBenchmark(int count)
+	{
+		JobSystem& jobs = JobSystem::get();
+		int maxThreads = jobs.getNumThreads();
+		printf("Job benchmark, %d threads\n", maxThreads);
+		bool passed = true;
+
+		//Counting hits instead of setting flags, so a range handed out twice shows up
+		bool covered = true;
+		const int sizes[] = { 1, 7, 1000, 100003 };
+		const int grains[] = { 1, 16, 5000 };
+		for (int s = 0; s < 4; s++) {
+			for (int g = 0; g < 3; g++)
+			{
+				int size = sizes[s];
+				int grain = grains[g];
+				std::vector<int> hits(size, 0);
+				jobs.parallelFor(size, grain, [&](int begin, int end) {
+					for (int i = begin; i < end; i++) {
+						hits[i]++;
+					}
+				});
+				for (int i = 0; i < size; i++) {
+					covered = covered && hits[i] == 1;
+				}
+			}
+		}
+		passed &= check("parallelFor runs every index once", covered);
+
+		const int outer = 64, inner = 1000;
+		std::vector<int> nestedHits(outer * inner, 0);
+		jobs.parallelFor(outer, 1, [&](int begin, int end) {
+			for (int o = begin; o < end; o++) {
+				jobs.parallelFor(inner, 10, [&](int innerBegin, int innerEnd) {
+					for (int i = innerBegin; i < innerEnd; i++) {
+						nestedHits[o * inner + i]++;
+					}
+				});
+			}
+		});
+		bool nested = true;
+		for (size_t i = 0; i < nestedHits.size(); i++) {
+			nested = nested && nestedHits[i] == 1;
+		}
+		passed &= check("nested parallelFor runs every index once", nested);
+
+		//Each stage only moves its chain on if the stage before it already ran
+		const int numChains = 256, numStages = 3;
+		std::vector<JobCounter> stages(numChains * numStages);
+		std::vector<int> steps(numChains, 0);
+		for (int stage = 0; stage < numStages; stage++) {
+			for (int chain = 0; chain < numChains; chain++)
+			{
+				const JobCounter* dependency = stage > 0 ? &stages[chain * numStages + stage - 1] : NULL;
+				jobs.run([&, stage, chain]() {
+					volatile float sink = unevenWork(chain, numChains);
+					(void)sink;
+					if (steps[chain] == stage) {
+						steps[chain] = stage + 1;
+					}
+				}, stages[chain * numStages + stage], dependency);
+			}
+		}
+		for (int chain = 0; chain < numChains; chain++) {
+			jobs.wait(stages[chain * numStages + numStages - 1]);
+		}
+		bool ordered = true;
+		for (int chain = 0; chain < numChains; chain++) {
+			ordered = ordered && steps[chain] == numStages;
+		}
+		passed &= check("dependent jobs run after what they depend on", ordered);
+
+		//Past what a deque holds the rest run on the spot
+		std::atomic<int> numRan(0);
+		JobCounter overflow;
+		int numOverflowJobs = JobSystem::MAX_JOBS_PER_THREAD * 3;
+		for (int i = 0; i < numOverflowJobs; i++) {
+			jobs.run([&]() { numRan.fetch_add(1); }, overflow);
+		}
+		jobs.wait(overflow);
+		passed &= check("more jobs than a deque holds all run", numRan.load() == numOverflowJobs);
+
+		//Batches small enough that no deque fills up
+		const int spawnBatch = 1000;
+		const int numSpawned = 100 * spawnBatch;
+		double spawn = timeBest(numSpawned, [&]() {
+			for (int batch = 0; batch < numSpawned; batch += spawnBatch)
+			{
+				JobCounter counter;
+				for (int i = 0; i < spawnBatch; i++) {
+					jobs.run([]() {}, counter);
+				}
+				jobs.wait(counter);
+			}
+		});
+		printf("  run + wait  %6.1f ns per empty job\n", spawn);
+
+		std::vector<float> results(count);
+		float serialSum = 0;
+		for (int i = 0; i < count; i++) {
+			serialSum += unevenWork(i, count);
+		}
+		printf("  uneven parallelFor, %d items, minBatch 64\n", count);
+		jobs.takeNumStolen();
+		for (int threads = 1; ; threads = glm::min(threads * 2, maxThreads))
+		{
+			jobs.setThreadLimit(threads);
+			double best = timeBest(1, [&]() {
+				jobs.parallelFor(count, 64, [&](int begin, int end) {
+					for (int i = begin; i < end; i++) {
+						results[i] = unevenWork(i, count);
+					}
+				});
+			});
+			int numStolen = jobs.takeNumStolen();
+			float sum = 0;
+			for (int i = 0; i < count; i++) {
+				sum += results[i];
+			}
+			printf("  %2d threads %8.3f ms   %5d jobs stolen over %d runs%s\n", threads, best / 1e6, numStolen, BENCHMARK_RUNS,
+				sum == serialSum ? "" : "   (results differ!)");
+			if (threads == maxThreads) {
+				break;
+			}
+		}
+		jobs.setThreadLimit(0);
+		return passed;
+	}
+}
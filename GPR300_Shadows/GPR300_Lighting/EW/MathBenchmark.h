@@ -0,0 +1,27 @@
+//Author: Sam Fox
+
+#pragma once
+
+namespace ew {
+	//Times ewMath.h, glm and SimdMath.h on count random transforms and prints ns per operation. False if quaternions
+	//read back as Euler angles turn by more than float noise, gimbal lock included.
+	//Run with --bench-math
+	bool runMathBenchmark(int count = 100000);
+
+	//Times TransformStore::update with every transform and with 10% of them changed.
+	//Run with --bench-transforms
+	void runTransformBenchmark(int count = 100000);
+
+	//Culls count random boxes against a camera frustum on 1, 2, 4... threads and prints ms per cull.
+	//Run with --bench-culling
+	void runCullingBenchmark(int count = 1000000);
+
+	//Times an empty PROFILE_CPU scope, enabled and disabled, and prints ns per scope.
+	//Run with --bench-profiler
+	void runProfilerBenchmark(int count = 10000000);
+
+	//Checks the job system first: every index of a parallelFor runs once, nested loops, dependencies and more jobs than a
+	//deque holds. Then times spawning jobs and an uneven parallelFor on 1, 2, 4... threads. False if a check failed.
+	//Run with --bench-jobs
+	bool runJobBenchmark(int count = 200000);
+}
\ No newline at end of file
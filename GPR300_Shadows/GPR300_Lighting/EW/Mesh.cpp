@@ -1,19 +1,39 @@
 //Author: Eric Winebrenner
 
 #include "Mesh.h"
+#include "GLState.h"
 namespace ew {
 	Mesh::Mesh(MeshData* meshData) {
+		create(meshData, 1);
+	}
+
+	Mesh::Mesh(const std::vector<MeshData>& levels) {
+		create(&levels[0], (int)levels.size());
+	}
+
+	void Mesh::create(const MeshData* levels, int numLevels) {
+		//Every level goes back to back into the same buffers
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		mLevels.resize(numLevels);
+		for (int i = 0; i < numLevels; i++) {
+			mLevels[i].numIndices = (GLsizei)levels[i].indices.size();
+			mLevels[i].firstIndex = (GLsizei)indices.size();
+			mLevels[i].baseVertex = (GLint)vertices.size();
+			vertices.insert(vertices.end(), levels[i].vertices.begin(), levels[i].vertices.end());
+			indices.insert(indices.end(), levels[i].indices.begin(), levels[i].indices.end());
+		}
 
 		glGenVertexArrays(1, &mVAO);
-		glBindVertexArray(mVAO);
+		GLState::get().bindVertexArray(mVAO);
 
 		glGenBuffers(1, &mVBO);
 		glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-		glBufferData(GL_ARRAY_BUFFER, meshData->vertices.size() * sizeof(Vertex), &meshData->vertices[0], GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
 		glGenBuffers(1, &mEBO);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, meshData->indices.size() * sizeof(unsigned int), &meshData->indices[0], GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, position)));
 		glEnableVertexAttribArray(0);
@@ -24,21 +44,46 @@ namespace ew {
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, uv)));
 		glEnableVertexAttribArray(2);
 
-		mNumIndices = (GLsizei)meshData->indices.size();
-		mNumVertices = (GLsizei)meshData->vertices.size();
+		mNumVertices = (GLsizei)vertices.size();
+		mBounds = levels[0].bounds;
+		mSphere = levels[0].sphere;
 	}
 
 	Mesh::~Mesh()
 	{
-		glDeleteVertexArrays(1, &mVAO);
+		GLState::get().deleteVertexArrays(1, &mVAO);
 		glDeleteBuffers(1, &mVBO);
 		glDeleteBuffers(1, &mEBO);
 	}
 
-	void Mesh::draw()
+	void Mesh::draw(int level)
 	{
-		glBindVertexArray(mVAO);
-		glDrawElements(GL_TRIANGLES, mNumIndices, GL_UNSIGNED_INT, 0);
+		const Level& range = mLevels[level];
+		GLState::get().bindVertexArray(mVAO);
+		glDrawElementsBaseVertex(GL_TRIANGLES, range.numIndices, GL_UNSIGNED_INT,
+			(void*)(range.firstIndex * sizeof(unsigned int)), range.baseVertex);
 	}
 
+	void MeshData::computeBounds()
+	{
+		if (vertices.empty()) {
+			bounds = AABB();
+			sphere = BoundingSphere();
+			return;
+		}
+		bounds.min = bounds.max = vertices[0].position;
+		for (size_t i = 1; i < vertices.size(); i++) {
+			bounds.min = glm::min(bounds.min, vertices[i].position);
+			bounds.max = glm::max(bounds.max, vertices[i].position);
+		}
+
+		//Centered on the box, not minimal but exact for the shapes ShapeGen makes
+		sphere.center = bounds.getCenter();
+		float radius2 = 0;
+		for (size_t i = 0; i < vertices.size(); i++) {
+			glm::vec3 offset = vertices[i].position - sphere.center;
+			radius2 = glm::max(radius2, glm::dot(offset, offset));
+		}
+		sphere.radius = sqrtf(radius2);
+	}
 }
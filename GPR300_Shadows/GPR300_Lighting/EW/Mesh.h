@@ -4,6 +4,7 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <vector>
+#include "Bounds.h"
 
 namespace ew {
 	struct Vertex {
@@ -21,19 +22,41 @@ namespace ew {
 	struct MeshData {
 		std::vector<Vertex> vertices;
 		std::vector<unsigned int> indices;
+		//Local space bounds, filled by computeBounds()
+		AABB bounds;
+		BoundingSphere sphere;
+
+		void computeBounds();
 	};
 
 	/// <summary>
-	/// Holds OpenGL buffers, can be drawn
+	/// Holds OpenGL buffers, can be drawn. A LOD chain shares one vertex and one index buffer, level 0 is the most detailed
 	/// </summary>
 	class Mesh {
 	public:
 		Mesh(MeshData* meshData);
+		Mesh(const std::vector<MeshData>& levels);
 		~Mesh();
-		void draw();
+		void draw(int level = 0);
+		int getNumLevels() const { return (int)mLevels.size(); }
+		int getNumTriangles(int level = 0) const { return mLevels[level].numIndices / 3; }
+		//Level 0's bounds, the coarser levels fit inside them
+		const AABB& getBounds() const { return mBounds; }
+		const BoundingSphere& getBoundingSphere() const { return mSphere; }
 	private:
+		Mesh(const Mesh& r) = delete;
+		void create(const MeshData* levels, int numLevels);
+
+		struct Level {
+			GLsizei numIndices;
+			GLsizei firstIndex;
+			GLint baseVertex;
+		};
+
 		GLuint mVAO, mVBO, mEBO;
-		GLsizei mNumIndices;
 		GLsizei mNumVertices;
+		std::vector<Level> mLevels;
+		AABB mBounds;
+		BoundingSphere mSphere;
 	};
 }
@@ -0,0 +1,263 @@
+//Author: Sam Fox
+
+#include "MeshBatch.h"
+#include "GLState.h"
+
+namespace ew {
+	MeshBatch::MeshBatch()
+		: mDrawIDCapacity(0), mIndirectCapacity(0), mObjectCapacity(0), mDirtyBegin(0), mDirtyEnd(0)
+	{
+		glGenVertexArrays(1, &mVAO);
+		glGenBuffers(1, &mVBO);
+		glGenBuffers(1, &mEBO);
+		glGenBuffers(1, &mDrawIDBuffer);
+		glGenBuffers(1, &mIndirectBuffer);
+		glGenBuffers(1, &mObjectBuffer);
+		glGenBuffers(1, &mMeshBuffer);
+	}
+
+	MeshBatch::~MeshBatch()
+	{
+		GLState::get().deleteVertexArrays(1, &mVAO);
+		glDeleteBuffers(1, &mVBO);
+		glDeleteBuffers(1, &mEBO);
+		glDeleteBuffers(1, &mDrawIDBuffer);
+		glDeleteBuffers(1, &mIndirectBuffer);
+		glDeleteBuffers(1, &mObjectBuffer);
+		glDeleteBuffers(1, &mMeshBuffer);
+	}
+
+	int MeshBatch::addMesh(const MeshData& meshData)
+	{
+		MeshRange range;
+		range.firstIndex = (GLuint)mIndices.size();
+		range.numIndices = (GLuint)meshData.indices.size();
+		range.baseVertex = (GLint)mVertices.size();
+
+		mVertices.insert(mVertices.end(), meshData.vertices.begin(), meshData.vertices.end());
+		mIndices.insert(mIndices.end(), meshData.indices.begin(), meshData.indices.end());
+		mRanges.push_back(range);
+		mBounds.push_back(meshData.bounds);
+		mSpheres.push_back(meshData.sphere);
+		mNumLODs.push_back(1);
+		return (int)mRanges.size() - 1;
+	}
+
+	int MeshBatch::addMeshLODs(const std::vector<MeshData>& levels)
+	{
+		int first = addMesh(levels[0]);
+		for (size_t i = 1; i < levels.size(); i++) {
+			int level = addMesh(levels[i]);
+			//Switching level must not change what culling sees
+			mBounds[level] = mBounds[first];
+			mSpheres[level] = mSpheres[first];
+		}
+		mNumLODs[first] = (int)levels.size();
+		return first;
+	}
+
+	void MeshBatch::upload()
+	{
+		GLState::get().bindVertexArray(mVAO);
+
+		glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+		glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(Vertex), &mVertices[0], GL_STATIC_DRAW);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndices.size() * sizeof(unsigned int), &mIndices[0], GL_STATIC_DRAW);
+
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, position)));
+		glEnableVertexAttribArray(0);
+
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, normal)));
+		glEnableVertexAttribArray(1);
+
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, uv)));
+		glEnableVertexAttribArray(2);
+
+		reserveDrawIDs(64);
+
+		std::vector<MeshInfo> meshes(mRanges.size());
+		for (size_t i = 0; i < mRanges.size(); i++) {
+			meshes[i].center = glm::vec4(mBounds[i].getCenter(), 0.0f);
+			meshes[i].extents = glm::vec4(mBounds[i].getExtents(), 0.0f);
+			meshes[i].numIndices = mRanges[i].numIndices;
+			meshes[i].firstIndex = mRanges[i].firstIndex;
+			meshes[i].baseVertex = mRanges[i].baseVertex;
+			meshes[i].pad = 0;
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mMeshBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, meshes.size() * sizeof(MeshInfo), &meshes[0], GL_STATIC_DRAW);
+
+		//CPU copies are no longer needed once the GPU has them
+		mVertices.clear();
+		mVertices.shrink_to_fit();
+		mIndices.clear();
+		mIndices.shrink_to_fit();
+
+		GLState::get().bindVertexArray(0);
+	}
+
+	void MeshBatch::reserveDrawIDs(int count)
+	{
+		if (count <= mDrawIDCapacity) {
+			return;
+		}
+		int capacity = mDrawIDCapacity > 0 ? mDrawIDCapacity : 64;
+		while (capacity < count) {
+			capacity *= 2;
+		}
+
+		//drawID[i] = i, fetched once per instance starting at baseInstance
+		std::vector<GLuint> drawIDs(capacity);
+		for (int i = 0; i < capacity; i++) {
+			drawIDs[i] = i;
+		}
+
+		GLState::get().bindVertexArray(mVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, mDrawIDBuffer);
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(GLuint), &drawIDs[0], GL_STATIC_DRAW);
+		glVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (const void*)0);
+		glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+		glEnableVertexAttribArray(DRAW_ID_LOCATION);
+		GLState::get().bindVertexArray(0);
+
+		mDrawIDCapacity = capacity;
+	}
+
+	void MeshBatch::clearDraws()
+	{
+		//Lists keep their memory from frame to frame
+		for (size_t i = 0; i < mLists.size(); i++) {
+			mLists[i].clear();
+		}
+	}
+
+	int MeshBatch::addObject(int mesh, const glm::mat4& model, GLuint materialIndex)
+	{
+		ObjectData object;
+		object.model = model;
+		object.materialIndex = materialIndex;
+		object.meshIndex = (GLuint)mesh;
+		object.pad[0] = object.pad[1] = 0;
+		mObjects.push_back(object);
+		mObjectMeshes.push_back(mesh);
+		markObjectDirty((int)mObjects.size() - 1);
+		return (int)mObjects.size() - 1;
+	}
+
+	void MeshBatch::setObject(int object, const glm::mat4& model, GLuint materialIndex)
+	{
+		mObjects[object].model = model;
+		mObjects[object].materialIndex = materialIndex;
+		markObjectDirty(object);
+	}
+
+	void MeshBatch::setObjectMesh(int object, int mesh)
+	{
+		if (mObjectMeshes[object] == mesh) {
+			return;
+		}
+		mObjects[object].meshIndex = (GLuint)mesh;
+		mObjectMeshes[object] = mesh;
+		markObjectDirty(object);
+	}
+
+	void MeshBatch::clearObjects()
+	{
+		mObjects.clear();
+		mObjectMeshes.clear();
+		mDirtyBegin = mDirtyEnd = 0;
+		clearDraws();
+	}
+
+	void MeshBatch::markObjectDirty(int object)
+	{
+		if (mDirtyBegin == mDirtyEnd) {
+			mDirtyBegin = object;
+			mDirtyEnd = object + 1;
+			return;
+		}
+		mDirtyBegin = glm::min(mDirtyBegin, object);
+		mDirtyEnd = glm::max(mDirtyEnd, object + 1);
+	}
+
+	void MeshBatch::addDraw(int list, int object)
+	{
+		if (list >= (int)mLists.size()) {
+			mLists.resize(list + 1);
+		}
+		const MeshRange& range = mRanges[mObjectMeshes[object]];
+
+		DrawElementsIndirectCommand command;
+		command.count = range.numIndices;
+		command.instanceCount = 1;
+		command.firstIndex = range.firstIndex;
+		command.baseVertex = range.baseVertex;
+		command.baseInstance = (GLuint)object; //drawID is the object, whichever list draws it
+		mLists[list].push_back(command);
+	}
+
+	void MeshBatch::submit()
+	{
+		mCommands.clear();
+		mListOffsets.resize(mLists.size());
+		for (size_t i = 0; i < mLists.size(); i++) {
+			mListOffsets[i] = (int)mCommands.size();
+			mCommands.insert(mCommands.end(), mLists[i].begin(), mLists[i].end());
+		}
+		reserveDrawIDs((int)mObjects.size());
+
+		//Buffers only grow. A new buffer needs every object, otherwise only the ones that changed go up
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mObjectBuffer);
+		if ((int)mObjects.size() > mObjectCapacity) {
+			mObjectCapacity = (int)mObjects.capacity();
+			glBufferData(GL_SHADER_STORAGE_BUFFER, mObjectCapacity * sizeof(ObjectData), NULL, GL_DYNAMIC_DRAW);
+			mDirtyBegin = 0;
+			mDirtyEnd = (int)mObjects.size();
+		}
+		if (mDirtyEnd > mDirtyBegin) {
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, mDirtyBegin * sizeof(ObjectData),
+				(mDirtyEnd - mDirtyBegin) * sizeof(ObjectData), &mObjects[mDirtyBegin]);
+			mDirtyBegin = mDirtyEnd = 0;
+		}
+
+		if (mCommands.empty()) {
+			return;
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mIndirectBuffer);
+		if ((int)mCommands.size() > mIndirectCapacity) {
+			mIndirectCapacity = (int)mCommands.capacity();
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, mIndirectCapacity * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+		}
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, mCommands.size() * sizeof(DrawElementsIndirectCommand), &mCommands[0]);
+	}
+
+	void MeshBatch::draw(int list)
+	{
+		int numDraws = getNumDraws(list);
+		if (numDraws == 0) {
+			return;
+		}
+		bind();
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mIndirectBuffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+			(const void*)(mListOffsets[list] * sizeof(DrawElementsIndirectCommand)), numDraws, 0);
+	}
+
+	int MeshBatch::getNumTriangles(int list) const
+	{
+		int numTriangles = 0;
+		for (int i = 0; i < getNumDraws(list); i++) {
+			numTriangles += mLists[list][i].count / 3;
+		}
+		return numTriangles;
+	}
+
+	void MeshBatch::bind()
+	{
+		GLState::get().bindVertexArray(mVAO);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, mObjectBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_BINDING, mMeshBuffer);
+	}
+}
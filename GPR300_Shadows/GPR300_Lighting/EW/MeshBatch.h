@@ -0,0 +1,122 @@
+//Author: Sam Fox
+
+#pragma once
+#include "Mesh.h"
+
+namespace ew {
+	/// <summary>
+	/// Layout of one command in GL_DRAW_INDIRECT_BUFFER
+	/// </summary>
+	struct DrawElementsIndirectCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	/// <summary>
+	/// Where one mesh lives inside the shared vertex/index buffers
+	/// </summary>
+	struct MeshRange {
+		GLuint firstIndex;
+		GLuint numIndices;
+		GLint baseVertex;
+	};
+
+	/// <summary>
+	/// Per draw data read by the batched shaders (std430, binding 0)
+	/// </summary>
+	struct ObjectData {
+		glm::mat4 model;
+		GLuint materialIndex;
+		GLuint meshIndex;
+		GLuint pad[2];
+	};
+
+	/// <summary>
+	/// Per mesh data for GPU culling (std430, binding 3): local bounds and the command that draws it
+	/// </summary>
+	struct MeshInfo {
+		glm::vec4 center;
+		glm::vec4 extents;
+		GLuint numIndices;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint pad;
+	};
+
+	/// <summary>
+	/// Packs many meshes into one VAO so a whole pass can be drawn with one glMultiDrawElementsIndirect.
+	/// Each draw's object index is passed to the shader through a per instance attribute at location 4 (baseInstance trick).
+	/// Objects stay in the batch from frame to frame and only the ones that changed are uploaded again.
+	/// Each pass draws its own list of them (e.g. what its frustum can see).
+	/// </summary>
+	class MeshBatch {
+	public:
+		static const GLuint DRAW_ID_LOCATION = 4;
+		static const GLuint OBJECT_BINDING = 0;
+		static const GLuint MESH_BINDING = 3;
+
+		MeshBatch();
+		~MeshBatch();
+		//Returns the id used by addDraw. Only valid before upload()
+		int addMesh(const MeshData& meshData);
+		//Adds every level as its own mesh with consecutive ids, returns level 0's. All levels get level 0's bounds
+		int addMeshLODs(const std::vector<MeshData>& levels);
+		//1 for meshes that aren't the start of a LOD chain
+		int getNumLODs(int mesh) const { return mNumLODs[mesh]; }
+		void upload();
+		const MeshRange& getRange(int mesh) const { return mRanges[mesh]; }
+		//Local space bounds of the mesh, from MeshData::computeBounds
+		const AABB& getBounds(int mesh) const { return mBounds[mesh]; }
+		const BoundingSphere& getBoundingSphere(int mesh) const { return mSpheres[mesh]; }
+		int getNumMeshes() const { return (int)mRanges.size(); }
+		int getMeshTriangles(int mesh) const { return mRanges[mesh].numIndices / 3; }
+
+		//Returns the index addDraw takes. Objects are kept until clearObjects()
+		int addObject(int mesh, const glm::mat4& model, GLuint materialIndex);
+		void setObject(int object, const glm::mat4& model, GLuint materialIndex);
+		//Swaps what the object draws, e.g. another level of its LOD chain
+		void setObjectMesh(int object, int mesh);
+		int getObjectMesh(int object) const { return mObjectMeshes[object]; }
+		void clearObjects();
+
+		//Per frame: record the lists, submit once, then draw each list in its pass
+		void clearDraws();
+		void addDraw(int list, int object);
+		void submit();
+		void draw(int list = 0);
+		//VAO and object / mesh buffers, for draws whose commands come from somewhere else (GPUCuller)
+		void bind();
+		int getNumObjects() const { return (int)mObjects.size(); }
+		int getNumDraws(int list = 0) const { return list < (int)mLists.size() ? (int)mLists[list].size() : 0; }
+		int getNumTriangles(int list = 0) const;
+	private:
+		MeshBatch(const MeshBatch& r) = delete;
+		void reserveDrawIDs(int count);
+		void markObjectDirty(int object);
+
+		GLuint mVAO, mVBO, mEBO;
+		GLuint mDrawIDBuffer, mIndirectBuffer, mObjectBuffer, mMeshBuffer;
+		int mDrawIDCapacity;
+		int mIndirectCapacity;
+		int mObjectCapacity;
+
+		std::vector<Vertex> mVertices;
+		std::vector<unsigned int> mIndices;
+		std::vector<MeshRange> mRanges;
+		std::vector<AABB> mBounds;
+		std::vector<BoundingSphere> mSpheres;
+		std::vector<int> mNumLODs;
+
+		std::vector<int> mObjectMeshes;
+		std::vector<ObjectData> mObjects;
+		//Objects changed since the last submit, [begin, end)
+		int mDirtyBegin, mDirtyEnd;
+		//Commands of every list back to back in the indirect buffer
+		std::vector<std::vector<DrawElementsIndirectCommand> > mLists;
+		std::vector<DrawElementsIndirectCommand> mCommands;
+		std::vector<int> mListOffsets;
+	};
+}
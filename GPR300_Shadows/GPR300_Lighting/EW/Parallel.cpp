@@ -0,0 +1,21 @@
+//Author: Sam Fox
+
+#include "Parallel.h"
+#include "JobSystem.h"
+
+namespace ew {
+	void parallelFor(int count, int minBatch, const std::function<void(int, int)>& func)
+	{
+		JobSystem::get().parallelFor(count, minBatch, func);
+	}
+
+	int getNumThreads()
+	{
+		return JobSystem::get().getNumThreads();
+	}
+
+	void setThreadLimit(int numThreads)
+	{
+		JobSystem::get().setThreadLimit(numThreads);
+	}
+}
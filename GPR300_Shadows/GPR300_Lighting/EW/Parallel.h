@@ -0,0 +1,16 @@
+//Author: Sam Fox
+
+#pragma once
+#include <functional>
+
+namespace ew {
+	//Calls func(begin, end) on sub ranges of [0, count) spread over the job system's threads and the caller.
+	//Returns once every range is done. Ranges are at least minBatch long, so small loops stay on the calling thread.
+	//Safe to nest, an inner call runs its ranges as jobs too.
+	void parallelFor(int count, int minBatch, const std::function<void(int, int)>& func);
+
+	//Worker threads plus the calling thread, capped by setThreadLimit
+	int getNumThreads();
+	//Caps how many threads later parallelFor calls use, 0 for all of them. Meant for benchmarks
+	void setThreadLimit(int numThreads);
+}
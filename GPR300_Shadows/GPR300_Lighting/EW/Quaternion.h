@@ -0,0 +1,93 @@
+//Author: Sam Fox
+
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <stdint.h>
+
+namespace ew {
+	//Euler angles in radians, same order and directions as ew::rotateX * ew::rotateY * ew::rotateZ
+	inline glm::quat eulerToQuat(const glm::vec3& euler) {
+		//ew::rotateY turns the opposite way of glm::angleAxis
+		return glm::angleAxis(euler.x, glm::vec3(1, 0, 0)) * glm::angleAxis(-euler.y, glm::vec3(0, 1, 0)) * glm::angleAxis(euler.z, glm::vec3(0, 0, 1));
+	}
+
+	inline glm::vec3 quatToEuler(const glm::quat& q) {
+		glm::mat3 m = glm::mat3_cast(q);
+		//atan2 instead of asin for y keeps precision near +-90 degrees
+		float cosY = sqrtf(m[2][1] * m[2][1] + m[2][2] * m[2][2]);
+		float y = atan2f(-m[2][0], cosY);
+		//Gimbal lock at +-90 degrees: x and z turn about the same axis and the pairs above are only rounding noise.
+		//Puts all of it in x. The cutoff is well above float noise, 1e-6 from the pole the general case is still 1e-2 off
+		if (cosY < 1e-4f) {
+			return glm::vec3(atan2f(m[0][1] * m[2][0], m[1][1]), y, 0.0f);
+		}
+		return glm::vec3(atan2f(-m[2][1], m[2][2]), y, atan2f(-m[1][0], m[0][0]));
+	}
+
+	//Normalized lerp along the shorter arc. Not constant speed, but close for the small steps of animation
+	inline glm::quat nlerp(const glm::quat& a, const glm::quat& b, float t) {
+		float sign = glm::dot(a, b) < 0.0f ? -1.0f : 1.0f;
+		return glm::normalize(glm::quat(
+			a.w + (b.w * sign - a.w) * t,
+			a.x + (b.x * sign - a.x) * t,
+			a.y + (b.y * sign - a.y) * t,
+			a.z + (b.z * sign - a.z) * t));
+	}
+
+	//Constant speed along the shorter arc, falls back to nlerp where the two are the same to float precision
+	inline glm::quat slerp(const glm::quat& a, const glm::quat& b, float t) {
+		float cosAngle = glm::dot(a, b);
+		glm::quat target = cosAngle < 0.0f ? -b : b;
+		cosAngle = glm::abs(cosAngle);
+		if (cosAngle > 0.9995f) {
+			return nlerp(a, target, t);
+		}
+		float angle = acosf(cosAngle);
+		float invSin = 1.0f / sinf(angle);
+		return a * (sinf((1.0f - t) * angle) * invSin) + target * (sinf(t * angle) * invSin);
+	}
+
+	//"Smallest three" encoding for per instance GPU data: the largest component is dropped and rebuilt from the
+	//other three, which always lie in [-1/sqrt(2), 1/sqrt(2)]. 10 bits each plus 2 bits for which one was dropped.
+	//Max error per component is about 0.0007
+	inline uint32_t packQuat(const glm::quat& q) {
+		float c[4] = { q.x, q.y, q.z, q.w };
+		int largest = 0;
+		for (int i = 1; i < 4; i++) {
+			if (glm::abs(c[i]) > glm::abs(c[largest])) {
+				largest = i;
+			}
+		}
+		//q and -q are the same rotation, keep the dropped one positive
+		float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+		uint32_t packed = (uint32_t)largest << 30;
+		int shift = 20;
+		for (int i = 0; i < 4; i++) {
+			if (i == largest) {
+				continue;
+			}
+			float unit = glm::clamp(c[i] * sign * 0.70710678f + 0.5f, 0.0f, 1.0f);
+			packed |= (uint32_t)(unit * 1023.0f + 0.5f) << shift;
+			shift -= 10;
+		}
+		return packed;
+	}
+
+	inline glm::quat unpackQuat(uint32_t packed) {
+		int largest = (int)(packed >> 30);
+		float c[4];
+		float sum = 0.0f;
+		int shift = 20;
+		for (int i = 0; i < 4; i++) {
+			if (i == largest) {
+				continue;
+			}
+			c[i] = (((packed >> shift) & 1023) / 1023.0f - 0.5f) * 1.41421356f;
+			sum += c[i] * c[i];
+			shift -= 10;
+		}
+		c[largest] = sqrtf(glm::max(0.0f, 1.0f - sum));
+		return glm::quat(c[3], c[0], c[1], c[2]);
+	}
+}
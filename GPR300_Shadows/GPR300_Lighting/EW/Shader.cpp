@@ -1,6 +1,8 @@
 //Author: Eric Winebrenner
 
 #include "Shader.h"
+#include "GLState.h"
+#include "CPUProfiler.h"
 #include <fstream>
 #include <sstream>
 
@@ -11,11 +13,17 @@
 #include <glm/gtc/type_ptr.hpp>
 
 Shader::Shader(std::string vertexShaderPath, std::string fragmentShaderPath)
+	: Shader(vertexShaderPath, fragmentShaderPath, "")
 {
-	std::string vertexShaderString = readFile(vertexShaderPath);
+}
+
+Shader::Shader(std::string vertexShaderPath, std::string fragmentShaderPath, std::string defines)
+{
+	PROFILE_CPU("CompileShader");
+	std::string vertexShaderString = injectDefines(readFile(vertexShaderPath), defines);
 	GLuint vertexShader = compileShader(vertexShaderString.c_str(), GL_VERTEX_SHADER);
 
-	std::string fragmentShaderString = readFile(fragmentShaderPath);
+	std::string fragmentShaderString = injectDefines(readFile(fragmentShaderPath), defines);
 	GLuint fragmentShader = compileShader(fragmentShaderString.c_str(), GL_FRAGMENT_SHADER);
 
 	//Create an empty shader program
@@ -25,6 +33,24 @@ Shader::Shader(std::string vertexShaderPath, std::string fragmentShaderPath)
 	glAttachShader(m_id, vertexShader);
 	glAttachShader(m_id, fragmentShader);
 
+	linkProgram();
+
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+}
+
+Shader::Shader(std::string computeShaderPath)
+{
+	PROFILE_CPU("CompileShader");
+	GLuint computeShader = compileShader(readFile(computeShaderPath).c_str(), GL_COMPUTE_SHADER);
+	m_id = glCreateProgram();
+	glAttachShader(m_id, computeShader);
+	linkProgram();
+	glDeleteShader(computeShader);
+}
+
+void Shader::linkProgram()
+{
 	//Link program - will create an executable program with the attached shaders
 	glLinkProgram(m_id);
 
@@ -37,14 +63,11 @@ Shader::Shader(std::string vertexShaderPath, std::string fragmentShaderPath)
 		glGetProgramInfoLog(m_id, 512, NULL, infoLog);
 		printf("Failed to link shader program: %s", infoLog);
 	}
-
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
 }
 
 void Shader::use()
 {
-	glUseProgram(m_id);
+	ew::GLState::get().useProgram(m_id);
 }
 
 void Shader::setFloat(std::string name, float value)
@@ -66,6 +89,11 @@ void Shader::setVec3(std::string name, const glm::vec3& value)
 	glProgramUniform3f(m_id, glGetUniformLocation(m_id, name.c_str()), value.x, value.y, value.z);
 }
 
+void Shader::setVec4(std::string name, const glm::vec4& value)
+{
+	glProgramUniform4f(m_id, glGetUniformLocation(m_id, name.c_str()), value.x, value.y, value.z, value.w);
+}
+
 void Shader::setVec2(std::string name, const glm::vec2& value)
 {
 	glProgramUniform2f(m_id, glGetUniformLocation(m_id, name.c_str()), value.x, value.y);
@@ -85,6 +113,23 @@ std::string Shader::readFile(const std::string& filePath)
 	return stringStream.str();
 }
 
+std::string Shader::injectDefines(const std::string& source, const std::string& defines)
+{
+	if (defines.empty()) {
+		return source;
+	}
+	//#version has to stay the first line, so defines go directly after it
+	size_t versionLine = source.find("#version");
+	size_t insertAt = versionLine == std::string::npos ? 0 : source.find('\n', versionLine);
+	if (insertAt == std::string::npos) {
+		return source + "\n" + defines + "\n";
+	}
+	if (versionLine != std::string::npos) {
+		insertAt++;
+	}
+	return source.substr(0, insertAt) + defines + "\n" + source.substr(insertAt);
+}
+
 GLuint Shader::compileShader(const char* shaderSource, GLenum shaderType)
 {
 	GLuint shader = glCreateShader(shaderType);
@@ -97,7 +142,7 @@ GLuint Shader::compileShader(const char* shaderSource, GLenum shaderType)
 	GLint success;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 	if (!success) {
-		const char* shaderName = shaderType == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT";
+		const char* shaderName = shaderType == GL_VERTEX_SHADER ? "VERTEX" : shaderType == GL_COMPUTE_SHADER ? "COMPUTE" : "FRAGMENT";
 		//Dump logs into a char array - 512 is an arbitrary length
 		GLchar infoLog[512];
 		glGetShaderInfoLog(shader, 512, NULL, infoLog);
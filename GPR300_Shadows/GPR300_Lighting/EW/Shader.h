@@ -9,16 +9,23 @@ class Shader
 {
 public:
 	Shader(std::string vertexShaderPath, std::string fragmentShaderPath);
+	//defines are inserted right after the #version line of both stages
+	Shader(std::string vertexShaderPath, std::string fragmentShaderPath, std::string defines);
+	//Compute program
+	explicit Shader(std::string computeShaderPath);
 	void use();
 	void setFloat(std::string name, float value);
 	void setInt(std::string name, int value);
 	void setMat4(std::string name, const glm::mat4& value);
 	void setVec2(std::string name, const glm::vec2& value);
 	void setVec3(std::string name, const glm::vec3& value);
+	void setVec4(std::string name, const glm::vec4& value);
 private:
 	Shader(const Shader& r) = delete;
 	std::string readFile(const std::string& filePath);
+	std::string injectDefines(const std::string& source, const std::string& defines);
 	GLuint compileShader(const char* shaderSource, GLenum type);
+	void linkProgram();
 	GLuint m_id;
 };
 
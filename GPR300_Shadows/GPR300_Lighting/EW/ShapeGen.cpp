@@ -1,6 +1,7 @@
 //Author: Eric Winebrenner
 
 #include "ShapeGen.h"
+#include "Parallel.h"
 #include <glm/gtc/type_ptr.hpp>
 
 namespace ew {
@@ -23,6 +24,7 @@ namespace ew {
 			0, 3, 2
 		};
 		meshData.indices.assign(&indices[0], &indices[6]);
+		meshData.computeBounds();
 	};
 
 	void createQuad(float width, float height, MeshData& meshData) {
@@ -44,6 +46,7 @@ namespace ew {
 			0, 2, 3
 		};
 		meshData.indices.assign(&indices[0], &indices[6]);
+		meshData.computeBounds();
 	};
 
 	void createCube(float width, float height, float depth, MeshData& meshData)
@@ -125,6 +128,7 @@ namespace ew {
 			22, 23, 20
 		};
 		meshData.indices.assign(&indices[0], &indices[36]);
+		meshData.computeBounds();
 	}
 
 	void createSphere(float radius, int numSegments, MeshData& meshData)
@@ -205,6 +209,7 @@ namespace ew {
 			meshData.indices.push_back(start + i);
 			meshData.indices.push_back(bottomIndex); //bottom cap center 
 		}
+		meshData.computeBounds();
 	}
 
 	void createCylinder(float height, float radius, int numSegments, MeshData& meshData)
@@ -296,6 +301,40 @@ namespace ew {
 			meshData.indices.push_back(start + 1);
 			meshData.indices.push_back(start + numSegments + 2);
 		}
+		meshData.computeBounds();
 	}
 
+	//Segment counts of a LOD chain
+	static int getLODSegments(int numSegments, int maxLevels, std::vector<int>& segments)
+	{
+		segments.clear();
+		segments.push_back(numSegments);
+		while ((int)segments.size() < maxLevels && segments.back() / 2 >= MIN_LOD_SEGMENTS) {
+			segments.push_back(segments.back() / 2);
+		}
+		return (int)segments.size();
+	}
+
+	void createSphereLODs(float radius, int numSegments, int maxLevels, std::vector<MeshData>& levels)
+	{
+		std::vector<int> segments;
+		levels.resize(getLODSegments(numSegments, maxLevels, segments));
+		//Levels share nothing, each one can be built on its own thread
+		parallelFor((int)levels.size(), 1, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				createSphere(radius, segments[i], levels[i]);
+			}
+		});
+	}
+
+	void createCylinderLODs(float height, float radius, int numSegments, int maxLevels, std::vector<MeshData>& levels)
+	{
+		std::vector<int> segments;
+		levels.resize(getLODSegments(numSegments, maxLevels, segments));
+		parallelFor((int)levels.size(), 1, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				createCylinder(height, radius, segments[i], levels[i]);
+			}
+		});
+	}
 }
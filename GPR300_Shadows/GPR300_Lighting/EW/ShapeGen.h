@@ -1,6 +1,7 @@
 //Author: Eric Winebrenner
 
 #pragma once
+#include <vector>
 #include "Mesh.h"
 
 namespace ew {
@@ -9,4 +10,10 @@ namespace ew {
 	void createCube(float width, float height, float depth, MeshData& meshData);
 	void createSphere(float radius, int numSegments, MeshData& meshData);
 	void createCylinder(float height, float radius, int numSegments, MeshData& meshData);
+
+	//Fewest segments a level of detail chain goes down to
+	const int MIN_LOD_SEGMENTS = 8;
+	//LOD chains, level 0 has numSegments and each level after it half as many, stopping at MIN_LOD_SEGMENTS
+	void createSphereLODs(float radius, int numSegments, int maxLevels, std::vector<MeshData>& levels);
+	void createCylinderLODs(float height, float radius, int numSegments, int maxLevels, std::vector<MeshData>& levels);
 }
@@ -0,0 +1,162 @@
+//Author: Sam Fox
+
+#include "SimdMath.h"
+
+#ifdef EW_SIMD_SSE
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+//MSVC compiles AVX intrinsics in any function
+#define EW_AVX2_TARGET
+#else
+#define EW_AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+namespace ew {
+#ifdef EW_SIMD_SSE
+	//The instructions and the OS saving the upper halves of the registers both need checking
+	static bool detectAVX2()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) {
+			return false;
+		}
+		__cpuid(info, 1);
+		bool fma = (info[2] & (1 << 12)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		if (!fma || !osxsave || (_xgetbv(0) & 6) != 6) {
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}
+
+	static const bool HAS_AVX2 = detectAVX2();
+
+	//Columns c and c + 1 of a product: lane k of each 128 bit half broadcast and multiplied with column k of a
+	EW_AVX2_TARGET static inline __m256 mulColumnPair(const __m256 a[4], __m256 columns)
+	{
+		__m256 r = _mm256_mul_ps(a[0], _mm256_shuffle_ps(columns, columns, 0x00));
+		r = _mm256_fmadd_ps(a[1], _mm256_shuffle_ps(columns, columns, 0x55), r);
+		r = _mm256_fmadd_ps(a[2], _mm256_shuffle_ps(columns, columns, 0xAA), r);
+		return _mm256_fmadd_ps(a[3], _mm256_shuffle_ps(columns, columns, 0xFF), r);
+	}
+
+	//Column k of the matrix in both halves
+	EW_AVX2_TARGET static inline void loadColumnsTwice(const glm::mat4& m, __m256 out[4])
+	{
+		for (int k = 0; k < 4; k++) {
+			out[k] = _mm256_broadcast_ps((const __m128*)&m[k][0]);
+		}
+	}
+
+	EW_AVX2_TARGET static void mulAVX2(const glm::mat4& a, const glm::mat4* b, glm::mat4* out, size_t count)
+	{
+		__m256 columns[4];
+		loadColumnsTwice(a, columns);
+		for (size_t i = 0; i < count; i++) {
+			const float* src = &b[i][0][0];
+			float* dst = &out[i][0][0];
+			_mm256_storeu_ps(dst, mulColumnPair(columns, _mm256_loadu_ps(src)));
+			_mm256_storeu_ps(dst + 8, mulColumnPair(columns, _mm256_loadu_ps(src + 8)));
+		}
+	}
+
+	EW_AVX2_TARGET static void mulAVX2(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count)
+	{
+		__m256 columns[4];
+		for (size_t i = 0; i < count; i++) {
+			loadColumnsTwice(a[i], columns);
+			const float* src = &b[i][0][0];
+			float* dst = &out[i][0][0];
+			//out may alias b, both halves are read before either is written
+			__m256 low = mulColumnPair(columns, _mm256_loadu_ps(src));
+			__m256 high = mulColumnPair(columns, _mm256_loadu_ps(src + 8));
+			_mm256_storeu_ps(dst, low);
+			_mm256_storeu_ps(dst + 8, high);
+		}
+	}
+
+	EW_AVX2_TARGET static void mulAVX2(const glm::mat4& m, const glm::vec4* v, glm::vec4* out, size_t count)
+	{
+		__m256 columns[4];
+		loadColumnsTwice(m, columns);
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2) {
+			_mm256_storeu_ps(&out[i].x, mulColumnPair(columns, _mm256_loadu_ps(&v[i].x)));
+		}
+		for (; i < count; i++) {
+			out[i] = mul(m, v[i]);
+		}
+	}
+#endif
+
+	void composeTRS(const glm::vec3* positions, const glm::vec3* rotations, const glm::vec3* scales, glm::mat4* out, size_t count)
+	{
+		//Bound by sinf/cosf, the matrix itself is a handful of multiplies
+		for (size_t i = 0; i < count; i++) {
+			out[i] = composeTRS(positions[i], rotations[i], scales[i]);
+		}
+	}
+
+	void composeTRS(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* out, size_t count)
+	{
+		for (size_t i = 0; i < count; i++) {
+			out[i] = composeTRS(positions[i], rotations[i], scales[i]);
+		}
+	}
+
+	void mul(const glm::mat4& a, const glm::mat4* b, glm::mat4* out, size_t count)
+	{
+#ifdef EW_SIMD_SSE
+		if (HAS_AVX2) {
+			mulAVX2(a, b, out, count);
+			return;
+		}
+#endif
+		for (size_t i = 0; i < count; i++) {
+			out[i] = mul(a, b[i]);
+		}
+	}
+
+	void mul(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count)
+	{
+#ifdef EW_SIMD_SSE
+		if (HAS_AVX2) {
+			mulAVX2(a, b, out, count);
+			return;
+		}
+#endif
+		for (size_t i = 0; i < count; i++) {
+			out[i] = mul(a[i], b[i]);
+		}
+	}
+
+	void mul(const glm::mat4& m, const glm::vec4* v, glm::vec4* out, size_t count)
+	{
+#ifdef EW_SIMD_SSE
+		if (HAS_AVX2) {
+			mulAVX2(m, v, out, count);
+			return;
+		}
+#endif
+		for (size_t i = 0; i < count; i++) {
+			out[i] = mul(m, v[i]);
+		}
+	}
+
+	const char* getSimdPath()
+	{
+#ifdef EW_SIMD_SSE
+		return HAS_AVX2 ? "AVX2" : "SSE";
+#else
+		return "Scalar";
+#endif
+	}
+}
@@ -0,0 +1,111 @@
+//Author: Sam Fox
+
+#include "Texture.h"
+#include "GLState.h"
+#include "CPUProfiler.h"
+#include "stb_image.h"
+#include <glm/glm.hpp>
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	bool loadImage(const char* filePath, ImageData& image, int numComponents)
+	{
+		PROFILE_CPU("LoadImage");
+		int fileComponents;
+		//Per thread, images decode on the job system's workers
+		stbi_set_flip_vertically_on_load_thread(true);
+		unsigned char* textureData = stbi_load(filePath, &image.width, &image.height, &fileComponents, numComponents);
+		if (textureData == NULL) {
+			printf("Failed to load image %s\n", filePath);
+			return false;
+		}
+		image.numComponents = numComponents > 0 ? numComponents : fileComponents;
+		image.pixels.assign(textureData, textureData + (size_t)image.width * image.height * image.numComponents);
+		stbi_image_free(textureData);
+		return true;
+	}
+
+	void resampleImage(const unsigned char* src, int srcWidth, int srcHeight, unsigned char* dst, int dstWidth, int dstHeight, int numComponents)
+	{
+		for (int y = 0; y < dstHeight; y++)
+		{
+			float v = (y + 0.5f) * srcHeight / dstHeight - 0.5f;
+			int y0 = glm::clamp((int)floor(v), 0, srcHeight - 1);
+			int y1 = glm::min(y0 + 1, srcHeight - 1);
+			float ty = glm::clamp(v - y0, 0.0f, 1.0f);
+
+			for (int x = 0; x < dstWidth; x++)
+			{
+				float u = (x + 0.5f) * srcWidth / dstWidth - 0.5f;
+				int x0 = glm::clamp((int)floor(u), 0, srcWidth - 1);
+				int x1 = glm::min(x0 + 1, srcWidth - 1);
+				float tx = glm::clamp(u - x0, 0.0f, 1.0f);
+
+				for (int c = 0; c < numComponents; c++)
+				{
+					float top = glm::mix((float)src[(y0 * srcWidth + x0) * numComponents + c], (float)src[(y0 * srcWidth + x1) * numComponents + c], tx);
+					float bottom = glm::mix((float)src[(y1 * srcWidth + x0) * numComponents + c], (float)src[(y1 * srcWidth + x1) * numComponents + c], tx);
+					dst[(y * dstWidth + x) * numComponents + c] = (unsigned char)(glm::mix(top, bottom, ty) + 0.5f);
+				}
+			}
+		}
+	}
+
+	int getMipLevels(int width, int height)
+	{
+		return 1 + (int)floor(log2((float)glm::max(width, height)));
+	}
+
+	GLuint createTexture2D(const ImageData& image)
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		GLState::get().bindTexture(GL_TEXTURE_2D, texture);
+		glTexStorage2D(GL_TEXTURE_2D, getMipLevels(image.width, image.height), GL_RGBA8, image.width, image.height);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, &image.pixels[0]);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		return texture;
+	}
+
+	GLuint createTextureArray(const std::vector<ImageData>& images)
+	{
+		if (images.empty()) {
+			return 0;
+		}
+		const int numComponents = 4;
+		int width = images[0].width;
+		int height = images[0].height;
+		int count = (int)images.size();
+		size_t layerSize = (size_t)width * height * numComponents;
+
+		std::vector<unsigned char> layers(layerSize * count);
+		for (int i = 0; i < count; i++)
+		{
+			const ImageData& image = images[i];
+			unsigned char* dst = &layers[layerSize * i];
+			if (image.width == width && image.height == height)
+				memcpy(dst, &image.pixels[0], layerSize);
+			else
+				resampleImage(&image.pixels[0], image.width, image.height, dst, width, height, numComponents);
+		}
+
+		GLuint texture;
+		glGenTextures(1, &texture);
+		GLState::get().bindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, getMipLevels(width, height), GL_RGBA8, width, height, count);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, width, height, count, GL_RGBA, GL_UNSIGNED_BYTE, &layers[0]);
+
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		return texture;
+	}
+}
@@ -0,0 +1,28 @@
+//Author: Sam Fox
+
+#pragma once
+#include "GL/glew.h"
+#include <vector>
+
+namespace ew {
+	/// <summary>
+	/// 8 bit image in CPU memory, rows bottom to top like OpenGL expects
+	/// </summary>
+	struct ImageData {
+		int width = 0;
+		int height = 0;
+		int numComponents = 0;
+		std::vector<unsigned char> pixels;
+	};
+
+	//Returns false if the file could not be read. numComponents forces a channel count (0 = keep file's)
+	bool loadImage(const char* filePath, ImageData& image, int numComponents = 0);
+	//Bilinear resample so images of different sizes can share an array texture
+	void resampleImage(const unsigned char* src, int srcWidth, int srcHeight, unsigned char* dst, int dstWidth, int dstHeight, int numComponents);
+	int getMipLevels(int width, int height);
+
+	//Mipmapped, repeating 2D texture from an RGBA8 image
+	GLuint createTexture2D(const ImageData& image);
+	//Mipmapped GL_TEXTURE_2D_ARRAY, layer i = images[i]. Layers are resampled to the size of the first image
+	GLuint createTextureArray(const std::vector<ImageData>& images);
+}
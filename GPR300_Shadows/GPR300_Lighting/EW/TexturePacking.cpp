@@ -0,0 +1,58 @@
+//Author: Sam Fox
+
+#include "TexturePacking.h"
+#include <glm/glm.hpp>
+
+namespace ew {
+	bool packORM(const Material& material, ImageData& packed)
+	{
+		const std::string* paths[4] = { &material.occlusionMap, &material.roughnessMap, &material.metalnessMap, &material.displacementMap };
+		const float fallbacks[4] = { material.occlusion, material.roughness, material.metallic, material.displacement };
+
+		//Single channel loads, a greyscale jpg would otherwise cost a full RGB texture each
+		ImageData channels[4];
+		bool loaded[4] = { false, false, false, false };
+		int width = 0, height = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			if (paths[c]->empty() || !loadImage(paths[c]->c_str(), channels[c], 1)) {
+				continue;
+			}
+			loaded[c] = true;
+			if (channels[c].width * channels[c].height > width * height) {
+				width = channels[c].width;
+				height = channels[c].height;
+			}
+		}
+		if (width == 0) {
+			return false;
+		}
+
+		packed.width = width;
+		packed.height = height;
+		packed.numComponents = 4;
+		packed.pixels.resize((size_t)width * height * 4);
+
+		std::vector<unsigned char> resampled;
+		for (int c = 0; c < 4; c++)
+		{
+			const unsigned char* src = NULL;
+			if (loaded[c])
+			{
+				if (channels[c].width == width && channels[c].height == height) {
+					src = &channels[c].pixels[0];
+				}
+				else {
+					resampled.resize((size_t)width * height);
+					resampleImage(&channels[c].pixels[0], channels[c].width, channels[c].height, &resampled[0], width, height, 1);
+					src = &resampled[0];
+				}
+			}
+			unsigned char fallback = (unsigned char)(glm::clamp(fallbacks[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+			for (size_t i = 0; i < (size_t)width * height; i++) {
+				packed.pixels[i * 4 + c] = src != NULL ? src[i] : fallback;
+			}
+		}
+		return true;
+	}
+}
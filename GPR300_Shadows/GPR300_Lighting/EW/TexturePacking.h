@@ -0,0 +1,15 @@
+//Author: Sam Fox
+
+#pragma once
+#include "Texture.h"
+#include "Material.h"
+
+namespace ew {
+	//Packs the single channel maps into one RGBA8 image: R = occlusion, G = roughness, B = metalness, A = displacement.
+	//Maps are resampled to the largest one, channels without a map use the material's value.
+	//Returns false if none of the four files exist.
+	bool packORM(const Material& material, ImageData& packed);
+	inline bool hasORM(const Material& material) {
+		return !material.occlusionMap.empty() || !material.roughnessMap.empty() || !material.metalnessMap.empty() || !material.displacementMap.empty();
+	}
+}
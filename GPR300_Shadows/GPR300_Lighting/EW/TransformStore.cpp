@@ -0,0 +1,70 @@
+//Author: Sam Fox
+
+#include "TransformStore.h"
+#include "Parallel.h"
+#include "SimdMath.h"
+#include <atomic>
+
+namespace ew {
+	//Dirty words handed to one thread at a time, 64 transforms each
+	static const int UPDATE_BATCH_WORDS = 32;
+
+	int TransformStore::create(const Transform& transform)
+	{
+		int index = (int)mPositions.size();
+		mPositions.push_back(transform.position);
+		mRotations.push_back(transform.rotation);
+		mScales.push_back(transform.scale);
+		mModelMatrices.push_back(glm::mat4(1));
+		if ((size_t)(index >> 6) >= mDirtyBits.size()) {
+			mDirtyBits.push_back(0);
+			mUpdatedBits.push_back(0);
+		}
+		markDirty(index);
+		return index;
+	}
+
+	void TransformStore::set(int index, const Transform& transform)
+	{
+		mPositions[index] = transform.position;
+		mRotations[index] = transform.rotation;
+		mScales[index] = transform.scale;
+		markDirty(index);
+	}
+
+	void TransformStore::update()
+	{
+		std::atomic<int> numUpdated(0);
+		parallelFor((int)mDirtyBits.size(), UPDATE_BATCH_WORDS, [&](int begin, int end) {
+			int updated = 0;
+			for (int word = begin; word < end; word++)
+			{
+				uint64_t bits = mDirtyBits[word];
+				mUpdatedBits[word] = bits;
+				if (bits == ~0ull)
+				{
+					//Whole word dirty, e.g. everything after creation: one straight batch
+					int first = word << 6;
+					int count = glm::min(64, (int)mPositions.size() - first);
+					composeTRS(&mPositions[first], &mRotations[first], &mScales[first], &mModelMatrices[first], count);
+					updated += count;
+				}
+				else
+				{
+					for (int bit = 0; bits != 0; bit++, bits >>= 1)
+					{
+						if ((bits & 1) == 0) {
+							continue;
+						}
+						int index = (word << 6) + bit;
+						mModelMatrices[index] = composeTRS(mPositions[index], mRotations[index], mScales[index]);
+						updated++;
+					}
+				}
+				mDirtyBits[word] = 0;
+			}
+			numUpdated += updated;
+		});
+		mNumUpdated = numUpdated;
+	}
+}
@@ -0,0 +1,52 @@
+//Author: Sam Fox
+
+#pragma once
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+#include "Transform.h"
+
+namespace ew {
+	/// <summary>
+	/// Every transform of the scene as parallel position / rotation / scale arrays plus their cached model matrices.
+	/// Setters only flag the transform, update() rebuilds the flagged matrices once per frame on all threads,
+	/// every pass after that reads the cached result.
+	/// </summary>
+	class TransformStore {
+	public:
+		//Returns the index used by everything else
+		int create(const Transform& transform = Transform());
+		int getNumTransforms() const { return (int)mPositions.size(); }
+
+		void setPosition(int index, const glm::vec3& position) { mPositions[index] = position; markDirty(index); }
+		void setRotation(int index, const glm::quat& rotation) { mRotations[index] = rotation; markDirty(index); }
+		void setEulerAngles(int index, const glm::vec3& euler) { mRotations[index] = eulerToQuat(euler); markDirty(index); }
+		void setScale(int index, const glm::vec3& scale) { mScales[index] = scale; markDirty(index); }
+		void set(int index, const Transform& transform);
+		const glm::vec3& getPosition(int index) const { return mPositions[index]; }
+		const glm::quat& getRotation(int index) const { return mRotations[index]; }
+		glm::vec3 getEulerAngles(int index) const { return quatToEuler(mRotations[index]); }
+		const glm::vec3& getScale(int index) const { return mScales[index]; }
+
+		//Rebuilds the matrices changed since the last update
+		void update();
+		//Valid after update()
+		const glm::mat4& getModelMatrix(int index) const { return mModelMatrices[index]; }
+		//Matrices rebuilt by the last update()
+		int getNumUpdated() const { return mNumUpdated; }
+		//Whether the last update() rebuilt this one, so copies of the matrix elsewhere know to refresh
+		bool wasUpdated(int index) const { return ((mUpdatedBits[index >> 6] >> (index & 63)) & 1) != 0; }
+
+	private:
+		//One bit per transform, 64 to a word so threads never share a word
+		void markDirty(int index) { mDirtyBits[index >> 6] |= 1ull << (index & 63); }
+
+		std::vector<glm::vec3> mPositions;
+		std::vector<glm::quat> mRotations;
+		std::vector<glm::vec3> mScales;
+		std::vector<glm::mat4> mModelMatrices;
+		std::vector<uint64_t> mDirtyBits;
+		std::vector<uint64_t> mUpdatedBits;
+		int mNumUpdated = 0;
+	};
+}
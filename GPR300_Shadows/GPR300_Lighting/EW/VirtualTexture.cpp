@@ -0,0 +1,486 @@
+//Author: Sam Fox
+
+#include "VirtualTexture.h"
+#include "GLState.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <stdio.h>
+
+namespace ew {
+	TiledImagePageProvider::TiledImagePageProvider(const ImageData& tile, int virtualSize)
+		: mVirtualSize(virtualSize)
+	{
+		ImageData base = tile;
+		if (base.pixels.empty() || base.numComponents != 4) {
+			//Missing tile, stream white instead of crashing the worker
+			base.width = base.height = 1;
+			base.numComponents = 4;
+			base.pixels.assign(4, 255);
+		}
+		mMips.push_back(base);
+
+		//Box filtered chain down to 1x1
+		while (mMips.back().width > 1 || mMips.back().height > 1)
+		{
+			const ImageData& src = mMips.back();
+			ImageData dst;
+			dst.width = glm::max(src.width / 2, 1);
+			dst.height = glm::max(src.height / 2, 1);
+			dst.numComponents = 4;
+			dst.pixels.resize((size_t)dst.width * dst.height * 4);
+			for (int y = 0; y < dst.height; y++)
+			{
+				int y0 = glm::min(y * 2, src.height - 1), y1 = glm::min(y * 2 + 1, src.height - 1);
+				for (int x = 0; x < dst.width; x++)
+				{
+					int x0 = glm::min(x * 2, src.width - 1), x1 = glm::min(x * 2 + 1, src.width - 1);
+					for (int c = 0; c < 4; c++)
+					{
+						int sum = src.pixels[(y0 * src.width + x0) * 4 + c] + src.pixels[(y0 * src.width + x1) * 4 + c]
+							+ src.pixels[(y1 * src.width + x0) * 4 + c] + src.pixels[(y1 * src.width + x1) * 4 + c];
+						dst.pixels[(y * dst.width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+					}
+				}
+			}
+			mMips.push_back(dst);
+		}
+	}
+
+	void TiledImagePageProvider::loadPage(int mip, int pageX, int pageY, int pageSize, int border, unsigned char* rgba)
+	{
+		//Past the end of the chain the tile is smaller than a texel, the 1x1 level is the right answer
+		const ImageData& src = mMips[glm::min(mip, (int)mMips.size() - 1)];
+		int levelSize = glm::max(mVirtualSize >> mip, 1);
+		int slotSize = pageSize + border * 2;
+
+		for (int ty = 0; ty < slotSize; ty++)
+		{
+			int vy = ((pageY * pageSize + ty - border) % levelSize + levelSize) % levelSize;
+			int sy = vy % src.height;
+			for (int tx = 0; tx < slotSize; tx++)
+			{
+				int vx = ((pageX * pageSize + tx - border) % levelSize + levelSize) % levelSize;
+				int sx = vx % src.width;
+				const unsigned char* texel = &src.pixels[((size_t)sy * src.width + sx) * 4];
+				unsigned char* dst = &rgba[((size_t)ty * slotSize + tx) * 4];
+				dst[0] = texel[0];
+				dst[1] = texel[1];
+				dst[2] = texel[2];
+				dst[3] = texel[3];
+			}
+		}
+	}
+
+	VirtualTexture::VirtualTexture(PageProvider* provider, int virtualSize, int pageSize, int budgetMB, bool allowSparse)
+		: mProvider(provider), mVirtualSize(virtualSize), mPageSize(pageSize), mFrame(0), mMaxUploadsPerFrame(8),
+		mSparse(false), mSparsePageX(1), mSparsePageY(1),
+		mFeedbackFBO(0), mFeedbackDepth(0), mFeedbackWidth(0), mFeedbackHeight(0), mFeedbackIndex(0),
+		mPageTableDirty(true), mQuit(false)
+	{
+		mSlotSize = mPageSize + BORDER * 2;
+		mPagesPerSide = glm::max(mVirtualSize / mPageSize, 1);
+		mMaxMip = (int)floor(log2((float)mPagesPerSide));
+
+		//Fixed budget: as many slots as fit, at least 2x2 so the pinned root page never starves the cache
+		long long budgetBytes = (long long)budgetMB * 1024 * 1024;
+		mSlotsPerSide = glm::clamp((int)sqrt((double)budgetBytes / ((double)mSlotSize * mSlotSize * 4)), 2, 255);
+		mCacheSize = mSlotsPerSide * mSlotSize;
+
+		mTotalPages = 0;
+		for (int mip = 0; mip <= mMaxMip; mip++)
+		{
+			int n = mPagesPerSide >> mip;
+			mMipOffsets.push_back(mTotalPages);
+			mTotalPages += n * n;
+		}
+
+		mSparse = allowSparse && GLEW_ARB_sparse_texture;
+		if (mSparse)
+		{
+			glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, GL_VIRTUAL_PAGE_SIZE_X_ARB, 1, &mSparsePageX);
+			glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, GL_VIRTUAL_PAGE_SIZE_Y_ARB, 1, &mSparsePageY);
+			mSparse = mSparsePageX > 0 && mSparsePageY > 0;
+		}
+
+		int cacheWidth = mCacheSize, cacheHeight = mCacheSize;
+		if (mSparse)
+		{
+			//Sparse textures have to be a whole number of pages
+			cacheWidth = (mCacheSize + mSparsePageX - 1) / mSparsePageX * mSparsePageX;
+			cacheHeight = (mCacheSize + mSparsePageY - 1) / mSparsePageY * mSparsePageY;
+			mSparseRefCounts.assign((cacheWidth / mSparsePageX) * (cacheHeight / mSparsePageY), 0);
+		}
+
+		glGenTextures(1, &mCache);
+		GLState::get().bindTexture(GL_TEXTURE_2D, mCache);
+		if (mSparse) {
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
+		}
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, cacheWidth, cacheHeight);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		mCacheSize = cacheWidth;
+
+		//Integer texture, one mip per page mip: (slot x, slot y, mip actually mapped, valid)
+		glGenTextures(1, &mPageTable);
+		GLState::get().bindTexture(GL_TEXTURE_2D, mPageTable);
+		glTexStorage2D(GL_TEXTURE_2D, mMaxMip + 1, GL_RGBA8UI, mPagesPerSide, mPagesPerSide);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		mPageTableLevels.resize(mMaxMip + 1);
+
+		GLsizeiptr feedbackBytes = ((mTotalPages + 31) / 32) * sizeof(GLuint);
+		glGenBuffers(2, mFeedbackBuffers);
+		for (int i = 0; i < 2; i++)
+		{
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, mFeedbackBuffers[i]);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, feedbackBytes, NULL, GL_DYNAMIC_READ);
+			mFeedbackFences[i] = 0;
+		}
+
+		Slot empty;
+		empty.key = 0;
+		empty.lastUsedFrame = 0;
+		empty.used = false;
+		mSlots.assign(mSlotsPerSide * mSlotsPerSide, empty);
+
+		//The root page is loaded up front and never evicted, so every lookup has something to fall back to
+		LoadedPage root;
+		root.key = makeKey(mMaxMip, 0, 0);
+		root.pixels.resize((size_t)mSlotSize * mSlotSize * 4);
+		mProvider->loadPage(mMaxMip, 0, 0, mPageSize, BORDER, &root.pixels[0]);
+		mPending.insert(root.key);
+		uploadPage(root);
+		rebuildPageTable();
+
+		mThread = std::thread(&VirtualTexture::streamingThread, this);
+
+		printf("Virtual texture: %dx%d, %d pages per side, %d cache slots (%.1f MB budget)%s\n", mVirtualSize, mVirtualSize,
+			mPagesPerSide, getCapacity(), (float)mCacheSize * mCacheSize * 4 / (1024 * 1024), mSparse ? ", sparse" : "");
+	}
+
+	VirtualTexture::~VirtualTexture()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mQuit = true;
+		}
+		mCondition.notify_all();
+		mThread.join();
+
+		for (int i = 0; i < 2; i++) {
+			if (mFeedbackFences[i] != 0) {
+				glDeleteSync(mFeedbackFences[i]);
+			}
+		}
+		glDeleteBuffers(2, mFeedbackBuffers);
+		GLState::get().deleteFramebuffers(1, &mFeedbackFBO);
+		glDeleteRenderbuffers(1, &mFeedbackDepth);
+		GLState::get().deleteTextures(1, &mPageTable);
+		GLState::get().deleteTextures(1, &mCache);
+	}
+
+	void VirtualTexture::streamingThread()
+	{
+		while (true)
+		{
+			PageRequest request;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mCondition.wait(lock, [this] { return mQuit || !mRequests.empty(); });
+				if (mQuit) {
+					return;
+				}
+				request = mRequests.top();
+				mRequests.pop();
+			}
+
+			LoadedPage page;
+			page.key = request.key;
+			page.pixels.resize((size_t)mSlotSize * mSlotSize * 4);
+			mProvider->loadPage(keyMip(request.key), keyX(request.key), keyY(request.key), mPageSize, BORDER, &page.pixels[0]);
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			mLoaded.push_back(std::move(page));
+		}
+	}
+
+	void VirtualTexture::beginFeedback(int screenWidth, int screenHeight)
+	{
+		int width = glm::max(screenWidth / FEEDBACK_SCALE, 1);
+		int height = glm::max(screenHeight / FEEDBACK_SCALE, 1);
+		if (width != mFeedbackWidth || height != mFeedbackHeight)
+		{
+			if (mFeedbackFBO == 0) {
+				glGenFramebuffers(1, &mFeedbackFBO);
+				glGenRenderbuffers(1, &mFeedbackDepth);
+			}
+			glBindRenderbuffer(GL_RENDERBUFFER, mFeedbackDepth);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+			GLState::get().bindFramebuffer(GL_FRAMEBUFFER, mFeedbackFBO);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mFeedbackDepth);
+			GLState::get().drawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+			mFeedbackWidth = width;
+			mFeedbackHeight = height;
+		}
+
+		//This buffer's previous contents were either read by update() or are too old to matter
+		if (mFeedbackFences[mFeedbackIndex] != 0) {
+			glDeleteSync(mFeedbackFences[mFeedbackIndex]);
+			mFeedbackFences[mFeedbackIndex] = 0;
+		}
+		GLuint buffer = mFeedbackBuffers[mFeedbackIndex];
+		glClearNamedBufferData(buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FEEDBACK_BINDING, buffer);
+
+		GLState::get().getViewport(mPrevViewport);
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, mFeedbackFBO);
+		GLState::get().viewport(0, 0, mFeedbackWidth, mFeedbackHeight);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	void VirtualTexture::endFeedback()
+	{
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		mFeedbackFences[mFeedbackIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		mFeedbackIndex = 1 - mFeedbackIndex;
+
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::get().viewport(mPrevViewport[0], mPrevViewport[1], mPrevViewport[2], mPrevViewport[3]);
+	}
+
+	void VirtualTexture::update()
+	{
+		mFrame++;
+
+		//mFeedbackIndex now points at the buffer written last frame
+		GLsync fence = mFeedbackFences[mFeedbackIndex];
+		if (fence != 0)
+		{
+			GLenum status = glClientWaitSync(fence, 0, 0);
+			if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+			{
+				std::vector<GLuint> bits((mTotalPages + 31) / 32);
+				glGetNamedBufferSubData(mFeedbackBuffers[mFeedbackIndex], 0, bits.size() * sizeof(GLuint), &bits[0]);
+				glDeleteSync(fence);
+				mFeedbackFences[mFeedbackIndex] = 0;
+				readFeedback(&bits[0]);
+			}
+		}
+
+		std::vector<LoadedPage> ready;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			int count = glm::min((int)mLoaded.size(), mMaxUploadsPerFrame);
+			ready.assign(std::make_move_iterator(mLoaded.begin()), std::make_move_iterator(mLoaded.begin() + count));
+			mLoaded.erase(mLoaded.begin(), mLoaded.begin() + count);
+		}
+		for (size_t i = 0; i < ready.size(); i++) {
+			uploadPage(ready[i]);
+		}
+
+		if (mPageTableDirty) {
+			rebuildPageTable();
+		}
+	}
+
+	void VirtualTexture::readFeedback(const GLuint* bits)
+	{
+		std::vector<PageRequest> requests;
+		int numWords = (mTotalPages + 31) / 32;
+		for (int word = 0; word < numWords; word++)
+		{
+			GLuint value = bits[word];
+			while (value != 0)
+			{
+				int bit = 0;
+				while (((value >> bit) & 1u) == 0) {
+					bit++;
+				}
+				value &= ~(1u << bit);
+				int index = word * 32 + bit;
+
+				int mip = mMaxMip;
+				while (mip > 0 && index < mMipOffsets[mip]) {
+					mip--;
+				}
+				int n = mPagesPerSide >> mip;
+				int local = index - mMipOffsets[mip];
+				int x = local % n;
+				int y = local / n;
+
+				//The page and its ancestors are all in use, either directly or as the fallback
+				for (; mip <= mMaxMip; mip++, x >>= 1, y >>= 1)
+				{
+					unsigned int key = makeKey(mip, x, y);
+					std::unordered_map<unsigned int, int>::iterator resident = mResident.find(key);
+					if (resident != mResident.end()) {
+						mSlots[resident->second].lastUsedFrame = mFrame;
+					}
+					else if (mPending.insert(key).second) {
+						//Coarse pages first, they cover the most screen and unblock the finer ones
+						PageRequest request;
+						request.key = key;
+						request.priority = mip;
+						requests.push_back(request);
+					}
+				}
+			}
+		}
+
+		if (!requests.empty())
+		{
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				for (size_t i = 0; i < requests.size(); i++) {
+					mRequests.push(requests[i]);
+				}
+			}
+			mCondition.notify_one();
+		}
+	}
+
+	int VirtualTexture::allocateSlot()
+	{
+		int best = -1;
+		for (int i = 0; i < (int)mSlots.size(); i++)
+		{
+			const Slot& slot = mSlots[i];
+			if (!slot.used) {
+				return i;
+			}
+			//Never evict the root or anything still visible this frame
+			if (keyMip(slot.key) == mMaxMip || slot.lastUsedFrame >= mFrame) {
+				continue;
+			}
+			if (best < 0 || slot.lastUsedFrame < mSlots[best].lastUsedFrame) {
+				best = i;
+			}
+		}
+		return best;
+	}
+
+	void VirtualTexture::commitSlot(int slot)
+	{
+		int x0 = (slot % mSlotsPerSide) * mSlotSize;
+		int y0 = (slot / mSlotsPerSide) * mSlotSize;
+		int pagesPerRow = mCacheSize / mSparsePageX;
+
+		GLState::get().bindTexture(GL_TEXTURE_2D, mCache);
+		for (int py = y0 / mSparsePageY; py <= (y0 + mSlotSize - 1) / mSparsePageY; py++)
+		{
+			for (int px = x0 / mSparsePageX; px <= (x0 + mSlotSize - 1) / mSparsePageX; px++)
+			{
+				//Neighbouring slots share sparse pages, so commit on the first reference only
+				if (mSparseRefCounts[py * pagesPerRow + px]++ == 0) {
+					glTexPageCommitmentARB(GL_TEXTURE_2D, 0, px * mSparsePageX, py * mSparsePageY, 0, mSparsePageX, mSparsePageY, 1, GL_TRUE);
+				}
+			}
+		}
+	}
+
+	void VirtualTexture::uploadPage(const LoadedPage& page)
+	{
+		mPending.erase(page.key);
+		if (mResident.count(page.key) != 0) {
+			return;
+		}
+		int slotIndex = allocateSlot();
+		if (slotIndex < 0) {
+			//Cache is full of visible pages, feedback will ask again next frame
+			return;
+		}
+
+		Slot& slot = mSlots[slotIndex];
+		if (slot.used) {
+			mResident.erase(slot.key);
+		}
+		else if (mSparse) {
+			commitSlot(slotIndex);
+		}
+		slot.key = page.key;
+		slot.lastUsedFrame = mFrame;
+		slot.used = true;
+		mResident[page.key] = slotIndex;
+
+		int x = (slotIndex % mSlotsPerSide) * mSlotSize;
+		int y = (slotIndex / mSlotsPerSide) * mSlotSize;
+		glTextureSubImage2D(mCache, 0, x, y, mSlotSize, mSlotSize, GL_RGBA, GL_UNSIGNED_BYTE, &page.pixels[0]);
+		mPageTableDirty = true;
+	}
+
+	void VirtualTexture::rebuildPageTable()
+	{
+		//Coarse to fine, a missing page inherits its parent's mapping
+		for (int mip = mMaxMip; mip >= 0; mip--)
+		{
+			int n = mPagesPerSide >> mip;
+			std::vector<unsigned char>& level = mPageTableLevels[mip];
+			level.resize((size_t)n * n * 4);
+
+			for (int y = 0; y < n; y++)
+			{
+				for (int x = 0; x < n; x++)
+				{
+					unsigned char* entry = &level[((size_t)y * n + x) * 4];
+					std::unordered_map<unsigned int, int>::const_iterator resident = mResident.find(makeKey(mip, x, y));
+					if (resident != mResident.end())
+					{
+						entry[0] = (unsigned char)(resident->second % mSlotsPerSide);
+						entry[1] = (unsigned char)(resident->second / mSlotsPerSide);
+						entry[2] = (unsigned char)mip;
+						entry[3] = 255;
+					}
+					else if (mip < mMaxMip)
+					{
+						const unsigned char* parent = &mPageTableLevels[mip + 1][((size_t)(y / 2) * (n / 2) + x / 2) * 4];
+						entry[0] = parent[0];
+						entry[1] = parent[1];
+						entry[2] = parent[2];
+						entry[3] = parent[3];
+					}
+					else
+					{
+						entry[0] = entry[1] = entry[2] = entry[3] = 0;
+					}
+				}
+			}
+			glTextureSubImage2D(mPageTable, mip, 0, 0, n, n, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, &level[0]);
+		}
+		mPageTableDirty = false;
+	}
+
+	void VirtualTexture::bind(GLuint pageTableUnit, GLuint cacheUnit)
+	{
+		GLState::get().bindTexture(pageTableUnit, GL_TEXTURE_2D, mPageTable);
+		GLState::get().bindTexture(cacheUnit, GL_TEXTURE_2D, mCache);
+	}
+
+	void VirtualTexture::setUniforms(Shader& shader, GLuint pageTableUnit, GLuint cacheUnit)
+	{
+		shader.setInt("_VTPageTable", pageTableUnit);
+		shader.setInt("_VTCache", cacheUnit);
+		shader.setFloat("_VTVirtualSize", (float)mVirtualSize);
+		shader.setFloat("_VTPageSize", (float)mPageSize);
+		shader.setFloat("_VTSlotSize", (float)mSlotSize);
+		shader.setFloat("_VTBorder", (float)BORDER);
+		shader.setFloat("_VTCacheSize", (float)mCacheSize);
+		shader.setInt("_VTMaxMip", mMaxMip);
+		shader.setFloat("_VTMipBias", 0.0f);
+	}
+
+	float VirtualTexture::getCacheMB() const
+	{
+		if (!mSparse) {
+			return (float)mCacheSize * mCacheSize * 4 / (1024 * 1024);
+		}
+		int committed = 0;
+		for (size_t i = 0; i < mSparseRefCounts.size(); i++) {
+			committed += mSparseRefCounts[i] > 0 ? 1 : 0;
+		}
+		return (float)committed * mSparsePageX * mSparsePageY * 4 / (1024 * 1024);
+	}
+}
@@ -0,0 +1,139 @@
+//Author: Sam Fox
+
+#pragma once
+#include "GL/glew.h"
+#include "Shader.h"
+#include "Texture.h"
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace ew {
+	/// <summary>
+	/// Produces the texels of one virtual texture page. Called from the streaming thread.
+	/// rgba is (pageSize + 2 * border)^2 texels, the border repeats the neighbouring pages so bilinear filtering works.
+	/// </summary>
+	class PageProvider {
+	public:
+		virtual ~PageProvider() {}
+		virtual void loadPage(int mip, int pageX, int pageY, int pageSize, int border, unsigned char* rgba) = 0;
+	};
+
+	/// <summary>
+	/// Repeats one image across the whole virtual texture, using a box filtered mip chain of the image
+	/// </summary>
+	class TiledImagePageProvider : public PageProvider {
+	public:
+		TiledImagePageProvider(const ImageData& tile, int virtualSize);
+		void loadPage(int mip, int pageX, int pageY, int pageSize, int border, unsigned char* rgba) override;
+	private:
+		std::vector<ImageData> mMips;
+		int mVirtualSize;
+	};
+
+	/// <summary>
+	/// Virtual texture with a fixed size physical page cache.
+	/// A low resolution feedback pass records which pages are visible, a worker thread decodes them by priority
+	/// and update() uploads finished pages and rewrites the page table.
+	/// With GL_ARB_sparse_texture only the cache slots in use are committed.
+	/// </summary>
+	class VirtualTexture {
+	public:
+		static const int BORDER = 4;
+		static const int FEEDBACK_SCALE = 8;
+		static const GLuint FEEDBACK_BINDING = 2;
+
+		//provider is not owned and has to outlive the virtual texture
+		VirtualTexture(PageProvider* provider, int virtualSize, int pageSize = 128, int budgetMB = 32, bool allowSparse = true);
+		~VirtualTexture();
+
+		//Draw everything that samples the virtual texture between these, with a feedback shader
+		void beginFeedback(int screenWidth, int screenHeight);
+		void endFeedback();
+		//Reads back last frame's requests, queues missing pages and uploads decoded ones
+		void update();
+
+		void bind(GLuint pageTableUnit, GLuint cacheUnit);
+		void setUniforms(Shader& shader, GLuint pageTableUnit, GLuint cacheUnit);
+
+		int getResidentPages() const { return (int)mResident.size(); }
+		int getCapacity() const { return mSlotsPerSide * mSlotsPerSide; }
+		int getPendingPages() const { return (int)mPending.size(); }
+		float getCacheMB() const;
+		bool isSparse() const { return mSparse; }
+		int getVirtualSize() const { return mVirtualSize; }
+	private:
+		VirtualTexture(const VirtualTexture& r) = delete;
+
+		struct PageRequest {
+			unsigned int key;
+			int priority;
+			bool operator<(const PageRequest& r) const { return priority < r.priority; }
+		};
+		struct LoadedPage {
+			unsigned int key;
+			std::vector<unsigned char> pixels;
+		};
+		struct Slot {
+			unsigned int key;
+			unsigned int lastUsedFrame;
+			bool used;
+		};
+
+		static unsigned int makeKey(int mip, int x, int y) { return ((unsigned int)mip << 28) | ((unsigned int)y << 14) | (unsigned int)x; }
+		static int keyMip(unsigned int key) { return (int)(key >> 28); }
+		static int keyY(unsigned int key) { return (int)((key >> 14) & 0x3FFF); }
+		static int keyX(unsigned int key) { return (int)(key & 0x3FFF); }
+
+		void streamingThread();
+		void readFeedback(const GLuint* bits);
+		int allocateSlot();
+		void uploadPage(const LoadedPage& page);
+		void commitSlot(int slot);
+		void rebuildPageTable();
+
+		PageProvider* mProvider;
+		int mVirtualSize;
+		int mPageSize;
+		int mSlotSize;
+		int mPagesPerSide;
+		int mMaxMip;
+		int mSlotsPerSide;
+		int mCacheSize;
+		int mTotalPages;
+		std::vector<int> mMipOffsets;
+		unsigned int mFrame;
+		int mMaxUploadsPerFrame;
+
+		GLuint mPageTable;
+		GLuint mCache;
+		bool mSparse;
+		int mSparsePageX, mSparsePageY;
+		std::vector<int> mSparseRefCounts;
+
+		//Feedback is double buffered so the readback is always a frame old and never stalls
+		GLuint mFeedbackFBO, mFeedbackDepth;
+		int mFeedbackWidth, mFeedbackHeight;
+		GLuint mFeedbackBuffers[2];
+		GLsync mFeedbackFences[2];
+		int mFeedbackIndex;
+		GLint mPrevViewport[4];
+
+		std::vector<Slot> mSlots;
+		std::unordered_map<unsigned int, int> mResident; //page key -> slot
+		std::unordered_set<unsigned int> mPending;
+		bool mPageTableDirty;
+		std::vector<std::vector<unsigned char> > mPageTableLevels;
+
+		std::thread mThread;
+		std::mutex mMutex;
+		std::condition_variable mCondition;
+		std::priority_queue<PageRequest> mRequests;
+		std::vector<LoadedPage> mLoaded;
+		bool mQuit;
+	};
+}
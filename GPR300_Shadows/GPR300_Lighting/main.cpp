@@ -7,6 +7,7 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <stdio.h>
+#include <string.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -20,11 +21,25 @@
 #include "EW/Camera.h"
 #include "EW/Mesh.h"
 #include "EW/Transform.h"
+#include "EW/TransformStore.h"
 #include "EW/ShapeGen.h"
+#include "EW/MeshBatch.h"
+#include "EW/BVH.h"
+#include "EW/GPUCulling.h"
+#include "EW/HiZ.h"
+#include "EW/LOD.h"
+#include "EW/Headless.h"
+#include "EW/GPUProfiler.h"
+#include "EW/CPUProfiler.h"
+#include "EW/GLState.h"
+#include "EW/FrameGraph.h"
+#include "EW/MaterialTable.h"
+#include "EW/Material.h"
+#include "EW/MathBenchmark.h"
+#include "EW/VirtualTexture.h"
 
 #include <iostream>
 
-void renderObjectInScene(Shader& shader, ew::Transform& transform, ew::Mesh& mesh);
 GLuint createTexture(const char* filePath);
 void processInput(GLFWwindow* window);
 void resizeFrameBufferCallback(GLFWwindow* window, int width, int height);
@@ -57,6 +72,12 @@ const float CAMERA_ZOOM_SPEED = 3.0f;
 
 Camera camera((float)SCREEN_WIDTH / (float)SCREEN_HEIGHT);
 
+//Scene objects by MeshBatch object index. The BVH answers culling and what's under the mouse
+const int NUM_OBJECTS = 4;
+const char* OBJECT_NAMES[NUM_OBJECTS] = { "Cube", "Sphere", "Cylinder", "Ground" };
+ew::BVH sceneBVH;
+int hoveredObject = -1;
+
 glm::vec3 bgColor = glm::vec3(0);
 glm::vec3 materialColor = glm::vec3(1.0f);
 float ambientK = 0.5;
@@ -65,6 +86,12 @@ float specularK = 0.5;
 float shininess = 250;
 
 bool wireFrame = false;
+//Cull and build the draw lists in a compute shader instead of walking the BVH
+bool gpuCulling = false;
+//Also drop what the big occluders hide, GPU culling only
+bool occlusionCulling = true;
+//Draw the sphere and cylinder with fewer segments the smaller they are on screen
+bool useLOD = true;
 
 struct DirectionalLight
 {
@@ -82,14 +109,69 @@ float minBias = 0.005f;
 float maxBias = 0.05f;
 
 const char* TEXTURE = "./PavingStones130_1K-JPG/PavingStones130_1K_Color.jpg";
+//Every texture folder with a .usda in here becomes a material
+const char* MATERIAL_DIRECTORY = ".";
+const char* GROUND_TEXTURE = "./Grass.jpg";
+
+//Texture unit the material array texture uses when bindless textures aren't supported
+const int MATERIAL_ARRAY_UNIT = 0;
+const int SCREEN_TEXTURE_UNIT = 2;
+const int SHADOW_MAP_UNIT = 3;
+
+//0 draws the scene as it is, the rest are framebuffer.frag's effects
+int postEffect = 0;
+const char* POST_EFFECTS = "None\0Grey Scale\0Edge Detection\0Inverse\0Deep Fried Like\0";
+
+//The ground tile repeated across a 16K x 16K virtual texture with a fixed cache budget
+const int VIRTUAL_GROUND_SIZE = 16384;
+const int VIRTUAL_CACHE_MB = 32;
+const int VT_PAGE_TABLE_UNIT = 4;
+const int VT_CACHE_UNIT = 5;
+
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--bench-math") == 0) {
+			return ew::runMathBenchmark() ? 0 : 1;
+		}
+		if (strcmp(argv[i], "--bench-transforms") == 0) {
+			ew::runTransformBenchmark();
+			return 0;
+		}
+		if (strcmp(argv[i], "--bench-culling") == 0) {
+			ew::runCullingBenchmark();
+			return 0;
+		}
+		if (strcmp(argv[i], "--bench-profiler") == 0) {
+			ew::runProfilerBenchmark();
+			return 0;
+		}
+		if (strcmp(argv[i], "--bench-jobs") == 0) {
+			return ew::runJobBenchmark() ? 0 : 1;
+		}
+	}
+	ew::HeadlessOptions headlessOptions;
+	if (!ew::parseHeadlessOptions(argc, argv, headlessOptions)) {
+		return 1;
+	}
+
+	ew::CPUProfiler::setThreadName("Main");
 
-int main() {
 	if (!glfwInit()) {
 		printf("glfw failed to init");
 		return 1;
 	}
 
+	//Headless still needs a context, it just never shows the window
+	if (headlessOptions.enabled) {
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	}
 	GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Lighting", 0, 0);
+	if (window == NULL) {
+		printf("glfw failed to create a window");
+		glfwTerminate();
+		return 1;
+	}
 	glfwMakeContextCurrent(window);
 
 	if (glewInit() != GLEW_OK) {
@@ -104,7 +186,13 @@ int main() {
 	glfwSetMouseButtonCallback(window, mouseButtonCallback);
 
 	//Hide cursor
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	if (!headlessOptions.enabled) {
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	}
+	else {
+		//Frame times shouldn't be capped by vsync
+		glfwSwapInterval(0);
+	}
 
 	// Setup UI Platform/Renderer backends
 	IMGUI_CHECKVERSION();
@@ -115,8 +203,27 @@ int main() {
 	//Dark UI theme.
 	ImGui::StyleColorsDark();
 
+	//Every lit object samples its textures through the material table
+	ew::MaterialTable materials;
+	std::vector<ew::Material> foundMaterials;
+	ew::findMaterials(MATERIAL_DIRECTORY, foundMaterials);
+	std::vector<int> shapeMaterials;
+	for (size_t i = 0; i < foundMaterials.size(); i++) {
+		shapeMaterials.push_back(materials.addMaterial(foundMaterials[i]));
+	}
+	if (shapeMaterials.empty()) {
+		shapeMaterials.push_back(materials.addMaterial(TEXTURE));
+	}
+	int groundMaterial = materials.addVirtualMaterial();
+	materials.upload();
+
+	ew::ImageData groundTile;
+	ew::loadImage(GROUND_TEXTURE, groundTile, 4);
+	ew::TiledImagePageProvider groundPages(groundTile, VIRTUAL_GROUND_SIZE);
+	ew::VirtualTexture groundTexture(&groundPages, VIRTUAL_GROUND_SIZE, 128, VIRTUAL_CACHE_MB);
+
 	//Used to draw shapes. This is the shader you will be completing.
-	Shader litShader("shaders/defaultLit.vert", "shaders/defaultLit.frag");
+	Shader litShader("shaders/defaultLit.vert", "shaders/defaultLit.frag", materials.getShaderDefines());
 
 	//Used to draw light sphere
 	Shader unlitShader("shaders/defaultLit.vert", "shaders/unlit.frag");
@@ -127,127 +234,191 @@ int main() {
 	//depth shader
 	Shader depthShader("shaders/depthPass.vert", "shaders/depthPass.frag");
 
+	//virtual texture page requests
+	Shader feedbackShader("shaders/defaultLit.vert", "shaders/vtFeedback.frag");
+
 	ew::MeshData quadMeshData;
 	ew::createQuad(2, 2, quadMeshData);
 	ew::Mesh quadMesh(&quadMeshData);
 
 	ew::MeshData cubeMeshData;
 	ew::createCube(1.0f, 1.0f, 1.0f, cubeMeshData);
-	ew::MeshData sphereMeshData;
-	ew::createSphere(0.5f, 64, sphereMeshData);
-	ew::MeshData cylinderMeshData;
-	ew::createCylinder(1.0f, 0.5f, 64, cylinderMeshData);
+	//64, 32, 16 and 8 segments
+	std::vector<ew::MeshData> sphereLODs;
+	ew::createSphereLODs(0.5f, 64, 4, sphereLODs);
+	std::vector<ew::MeshData> cylinderLODs;
+	ew::createCylinderLODs(1.0f, 0.5f, 64, 4, cylinderLODs);
 	ew::MeshData planeMeshData;
 	ew::createPlane(1.0f, 1.0f, planeMeshData);
 
-	ew::Mesh cubeMesh(&cubeMeshData);
-	ew::Mesh sphereMesh(&sphereMeshData);
-	ew::Mesh planeMesh(&planeMeshData);
-	ew::Mesh cylinderMesh(&cylinderMeshData);
+	//All scene meshes share one VAO so each pass is a single multi-draw
+	ew::MeshBatch sceneBatch;
+	int cubeMesh = sceneBatch.addMesh(cubeMeshData);
+	int sphereMesh = sceneBatch.addMeshLODs(sphereLODs);
+	int cylinderMesh = sceneBatch.addMeshLODs(cylinderLODs);
+	int planeMesh = sceneBatch.addMesh(planeMeshData);
+	sceneBatch.upload();
+
+	//Everything the frame binds or enables goes through here, so calls that change nothing are dropped
+	ew::GLState& glState = ew::GLState::get();
 
 	//Enable back face culling
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
+	glState.enable(GL_CULL_FACE);
+	glState.cullFace(GL_BACK);
 
 	//Enable blending
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glState.enable(GL_BLEND);
+	glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	//Enable depth testing
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS);
-
-	//Initialize shape transforms
-	ew::Transform cubeTransform;
-	ew::Transform sphereTransform;
-	ew::Transform planeTransform;
-	ew::Transform cylinderTransform;
-
-	cubeTransform.position = glm::vec3(-2.0f, 0.0f, 0.0f);
-	sphereTransform.position = glm::vec3(0.0f, 0.0f, 0.0f);
-
-	planeTransform.position = glm::vec3(0.0f, -1.0f, 0.0f);
-	planeTransform.scale = glm::vec3(10.0f);
-
-	cylinderTransform.position = glm::vec3(2.0f, 0.0f, 0.0f);
+	glState.enable(GL_DEPTH_TEST);
+	glState.depthFunc(GL_LESS);
+
+	//Initialize shape transforms. Matrices are rebuilt once per frame, only for what changed
+	ew::TransformStore transforms;
+	ew::Transform transform;
+	transform.position = glm::vec3(-2.0f, 0.0f, 0.0f);
+	int cubeTransform = transforms.create(transform);
+	transform.position = glm::vec3(0.0f, 0.0f, 0.0f);
+	int sphereTransform = transforms.create(transform);
+	transform.position = glm::vec3(2.0f, 0.0f, 0.0f);
+	int cylinderTransform = transforms.create(transform);
+	transform.position = glm::vec3(0.0f, -1.0f, 0.0f);
+	transform.scale = glm::vec3(10.0f);
+	int planeTransform = transforms.create(transform);
+
+	//Everything the passes can draw. Each pass only draws what its own frustum contains
+	int objectMeshes[NUM_OBJECTS] = { cubeMesh, sphereMesh, cylinderMesh, planeMesh };
+	int objectTransforms[NUM_OBJECTS] = { cubeTransform, sphereTransform, cylinderTransform, planeTransform };
+	GLuint objectMaterials[NUM_OBJECTS] = { (GLuint)shapeMaterials[0], (GLuint)shapeMaterials[1 % shapeMaterials.size()],
+		(GLuint)shapeMaterials[2 % shapeMaterials.size()], (GLuint)groundMaterial };
+	const int CAMERA_LIST = 0;
+	const int SHADOW_LIST = 1;
+	//Drawn by the CPU into the Hi-Z depth, the GPU culler only has the first two
+	const int OCCLUDER_LIST = 2;
+	//Anything this big is worth drawing up front as an occluder, that's the cube and the ground
+	const float OCCLUDER_MIN_RADIUS = 0.8f;
+	bool isOccluder[NUM_OBJECTS];
+	//objectMeshes holds level 0, the object draws objectMeshes[i] + objectLevels[i]
+	int objectLevels[NUM_OBJECTS] = { 0 };
+	ew::LODSelector lodSelector;
+	std::vector<int> visibleObjects;
+	std::vector<int> shadowCasters;
+
+	//Objects and the BVH are built once, after that only what moved is touched
+	transforms.update();
+	ew::AABB objectBounds[NUM_OBJECTS];
+	for (int i = 0; i < NUM_OBJECTS; i++) {
+		const glm::mat4& model = transforms.getModelMatrix(objectTransforms[i]);
+		sceneBatch.addObject(objectMeshes[i], model, objectMaterials[i]);
+		objectBounds[i] = sceneBatch.getBounds(objectMeshes[i]).transformed(model);
+		isOccluder[i] = sceneBatch.getBoundingSphere(objectMeshes[i]).transformed(model).radius >= OCCLUDER_MIN_RADIUS;
+	}
+	sceneBVH.build(objectBounds, NUM_OBJECTS);
+
+	bool gpuCullingSupported = ew::GPUCuller::isSupported();
+	gpuCulling = gpuCullingSupported;
+	ew::GPUCuller gpuCuller("shaders/cullObjects.comp", 2);
+	ew::HiZBuffer hiZ("shaders/hiZReduce.comp", SCREEN_WIDTH, SCREEN_HEIGHT);
+	auto drawScene = [&](int list) {
+		if (gpuCulling) {
+			gpuCuller.draw(sceneBatch, list);
+		}
+		else {
+			sceneBatch.draw(list);
+		}
+	};
 
 	dirLight.intensity = lightIntensity;
 	dirLight.color = glm::vec3(1, 1, 1);
 
-	//Bind our name to GL_TEXTURE_2D to make it a 2D texture
-	GLuint texture = createTexture(TEXTURE);
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture);
-
-	if (texture == NULL)
-		std::cout << "Failed to load texture!" << std::endl;
-
-	// Create Frame Buffer Object
-	unsigned int fbo;
-	glGenFramebuffers(1, &fbo);
-
-	// Create Framebuffer Texture
-	unsigned int dbTexture;
-	glGenTextures(1, &dbTexture);
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, dbTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_MAP_WIDTH, SHADOW_MAP_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, dbTexture, 0);
-	glDrawBuffer(GL_NONE);
-	glReadBuffer(GL_NONE);
-
-	// Error checking framebuffer
-	GLenum fboStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-	if (fboStatus != GL_FRAMEBUFFER_COMPLETE)
-		std::cout << "Framebuffer error: " << fboStatus << std::endl;
-
-	while (!glfwWindowShouldClose(window)) {
-		processInput(window);
-
-		glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-		glClearColor(bgColor.r, bgColor.g, bgColor.b, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glEnable(GL_DEPTH_TEST);
-
-		GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-		glDrawBuffers(2, buffers);
-
-		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
-
-		float time = (float)glfwGetTime();
-		deltaTime = time - lastFrameTime;
-		lastFrameTime = time;
-
-		float near_plane = 0.1f, far_plane = 100.5f;
-		glm::mat4 lightProjection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, near_plane, far_plane);
-		glm::mat4 lightView = glm::lookAt(lightPosition,
-											glm::vec3(0),
-											glm::vec3(0.0f, 1.0f, 0.0f));
-		glm::mat4 lightSpaceMatrix = lightProjection * lightView;
-
+	//Renders into its own framebuffer with a scripted camera when headless
+	ew::HeadlessRun headlessRun(headlessOptions, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+	//Worked out each frame before the passes run
+	glm::mat4 lightSpaceMatrix;
+	ew::Frustum lightFrustum;
+	bool useOcclusion = false;
+
+	//The frame's passes and what they hand each other. The graph creates the targets and resizes them with the window
+	ew::FrameGraph frameGraph(SCREEN_WIDTH, SCREEN_HEIGHT);
+	ew::FrameTextureDesc shadowMapDesc;
+	shadowMapDesc.format = GL_DEPTH_COMPONENT24;
+	shadowMapDesc.width = SHADOW_MAP_WIDTH;
+	shadowMapDesc.height = SHADOW_MAP_HEIGHT;
+	shadowMapDesc.filter = GL_NEAREST;
+	shadowMapDesc.wrap = GL_REPEAT;
+	int shadowMap = frameGraph.createTexture("ShadowMap", shadowMapDesc);
+	ew::FrameTextureDesc sceneColorDesc;
+	sceneColorDesc.screenScale = 1.0f;
+	int sceneColor = frameGraph.createTexture("SceneColor", sceneColorDesc);
+	ew::FrameTextureDesc sceneDepthDesc;
+	sceneDepthDesc.format = GL_DEPTH_COMPONENT24;
+	sceneDepthDesc.screenScale = 1.0f;
+	sceneDepthDesc.filter = GL_NEAREST;
+	int sceneDepth = frameGraph.createTexture("SceneDepth", sceneDepthDesc);
+	//Built by the CPU before the graph runs, or by the GPU culling pass
+	int drawLists = frameGraph.importExternal("DrawLists");
+	//The ground's page table and cache, uploaded to after the feedback pass
+	int groundResidency = frameGraph.importExternal("GroundResidency");
+	int screen = frameGraph.importFramebuffer("Screen", headlessRun.getFramebuffer());
+
+	int cullingPass = frameGraph.addPass("GPUCulling", [&]() {
+		PROFILE_CPU("GPUCulling");
+		PROFILE_GPU("GPUCulling");
+		//Occluder depth prepass from this frame's camera, so nothing lags behind when the camera moves
+		if (useOcclusion) {
+			PROFILE_GPU("HiZ");
+			hiZ.resize(SCREEN_WIDTH, SCREEN_HEIGHT);
+			hiZ.beginOccluders();
+			depthShader.use();
+			depthShader.setMat4("_LightSpaceMatrix", camera.getViewProjectionMatrix());
+			sceneBatch.draw(OCCLUDER_LIST);
+			hiZ.endOccluders();
+		}
+		gpuCuller.begin();
+		gpuCuller.cull(sceneBatch, CAMERA_LIST, camera.getFrustum(), useOcclusion ? &hiZ : NULL, camera.getViewProjectionMatrix());
+		//Occluders seen from the camera say nothing about what casts shadows
+		gpuCuller.cull(sceneBatch, SHADOW_LIST, lightFrustum);
+	});
+	frameGraph.write(cullingPass, drawLists, ew::FRAME_ACCESS_STORAGE);
+
+	int shadowPass = frameGraph.addPass("ShadowPass", [&]() {
+		PROFILE_CPU("ShadowPass");
+		PROFILE_GPU("ShadowPass");
+		glClear(GL_DEPTH_BUFFER_BIT);
 		depthShader.use();
 		depthShader.setMat4("_LightSpaceMatrix", lightSpaceMatrix);
-
-		renderObjectInScene(depthShader, cubeTransform, cubeMesh);
-		renderObjectInScene(depthShader, sphereTransform, sphereMesh);
-		renderObjectInScene(depthShader, cylinderTransform, cylinderMesh);
-		renderObjectInScene(depthShader, planeTransform, planeMesh);
-
-		// Bind the default framebuffer
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		//glDisable(GL_DEPTH_TEST); // prevents framebuffer rectangle from being discarded
+		drawScene(SHADOW_LIST);
+	});
+	frameGraph.read(shadowPass, drawLists, ew::FRAME_ACCESS_INDIRECT);
+	frameGraph.writeDepth(shadowPass, shadowMap);
+
+	//Low resolution pass that tells the virtual texture which pages are on screen. Draws into the texture's own target
+	int feedbackPass = frameGraph.addPass("VTFeedback", [&]() {
+		PROFILE_CPU("VTFeedback");
+		PROFILE_GPU("VTFeedback");
+		groundTexture.beginFeedback(SCREEN_WIDTH, SCREEN_HEIGHT);
+		feedbackShader.use();
+		feedbackShader.setMat4("_Projection", camera.getProjectionMatrix());
+		feedbackShader.setMat4("_View", camera.getViewMatrix());
+		groundTexture.setUniforms(feedbackShader, VT_PAGE_TABLE_UNIT, VT_CACHE_UNIT);
+		feedbackShader.setFloat("_VTMipBias", -log2((float)ew::VirtualTexture::FEEDBACK_SCALE));
+		materials.bind(MATERIAL_ARRAY_UNIT);
+		drawScene(CAMERA_LIST);
+		groundTexture.endFeedback();
+		groundTexture.update();
+	});
+	frameGraph.read(feedbackPass, drawLists, ew::FRAME_ACCESS_INDIRECT);
+	frameGraph.write(feedbackPass, groundResidency, ew::FRAME_ACCESS_COPY);
+
+	int litPass = frameGraph.addPass("LitPass", [&]() {
+		PROFILE_CPU("LitPass");
+		PROFILE_GPU("LitPass");
+		glClearColor(bgColor.r, bgColor.g, bgColor.b, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		ew::CPUProfiler::beginScope("LitUniforms");
 		litShader.use();
 		litShader.setMat4("_Projection", camera.getProjectionMatrix());
 		litShader.setMat4("_View", camera.getViewMatrix());
@@ -267,20 +438,134 @@ int main() {
 		litShader.setFloat("_SpecularK", specularK);
 		litShader.setFloat("_Shininess", shininess);
 
-		litShader.setInt("_Texture", 0);
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, dbTexture);
-		litShader.setInt("_ShadowMap", 3);
+		materials.bind(MATERIAL_ARRAY_UNIT);
+		litShader.setInt("_MaterialArray", MATERIAL_ARRAY_UNIT);
+		groundTexture.bind(VT_PAGE_TABLE_UNIT, VT_CACHE_UNIT);
+		groundTexture.setUniforms(litShader, VT_PAGE_TABLE_UNIT, VT_CACHE_UNIT);
+		glState.bindTexture(SHADOW_MAP_UNIT, GL_TEXTURE_2D, frameGraph.getTexture(shadowMap));
+		litShader.setInt("_ShadowMap", SHADOW_MAP_UNIT);
 
 		litShader.setFloat("_MinBias", minBias);
 		litShader.setFloat("_MaxBias", maxBias);
+		ew::CPUProfiler::endScope();
+
+		drawScene(CAMERA_LIST);
+	});
+	frameGraph.read(litPass, drawLists, ew::FRAME_ACCESS_INDIRECT);
+	frameGraph.read(litPass, groundResidency);
+	frameGraph.read(litPass, shadowMap);
+	frameGraph.writeColor(litPass, sceneColor);
+	frameGraph.writeDepth(litPass, sceneDepth);
+
+	//The lit scene onto the screen through one of the framebuffer effects
+	int postPass = frameGraph.addPass("PostPass", [&]() {
+		PROFILE_CPU("PostPass");
+		PROFILE_GPU("PostPass");
+		glState.disable(GL_DEPTH_TEST);
+		glClear(GL_COLOR_BUFFER_BIT);
+		framebufferShader.use();
+		framebufferShader.setInt("_ApplyEffect", postEffect > 0 ? 1 : 0);
+		framebufferShader.setInt("_CurrentEffect", postEffect - 1);
+		framebufferShader.setFloat("_ScreenWidth", (float)frameGraph.getWidth(sceneColor));
+		framebufferShader.setFloat("_ScreenHeight", (float)frameGraph.getHeight(sceneColor));
+		glState.bindTexture(SCREEN_TEXTURE_UNIT, GL_TEXTURE_2D, frameGraph.getTexture(sceneColor));
+		framebufferShader.setInt("_ScreenTexture", SCREEN_TEXTURE_UNIT);
+		quadMesh.draw();
+		glState.enable(GL_DEPTH_TEST);
+	});
+	frameGraph.read(postPass, sceneColor);
+	frameGraph.writeColor(postPass, screen);
+
+	while (!glfwWindowShouldClose(window) && !headlessRun.isDone()) {
+		PROFILE_CPU("Frame");
+		if (headlessRun.isEnabled()) {
+			headlessRun.beginFrame();
+			headlessRun.applyCamera(camera);
+		}
+		else {
+			PROFILE_CPU("ProcessInput");
+			processInput(window);
+		}
+		ew::GPUProfiler::get().beginFrame();
+		glState.newFrame();
 
-		renderObjectInScene(litShader, cubeTransform, cubeMesh);
-		renderObjectInScene(litShader, sphereTransform, sphereMesh);
-		renderObjectInScene(litShader, cylinderTransform, cylinderMesh);
-		renderObjectInScene(litShader, planeTransform, planeMesh);
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui_ImplGlfw_NewFrame();
+		ImGui::NewFrame();
+
+		//Headless frames all step the same amount so every run is the same
+		float time = headlessRun.isEnabled() ? headlessRun.getFrame() / 60.0f : (float)glfwGetTime();
+		deltaTime = time - lastFrameTime;
+		lastFrameTime = time;
+
+		float near_plane = 0.1f, far_plane = 100.5f;
+		glm::mat4 lightProjection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, near_plane, far_plane);
+		glm::mat4 lightView = glm::lookAt(lightPosition,
+											glm::vec3(0),
+											glm::vec3(0.0f, 1.0f, 0.0f));
+		lightSpaceMatrix = lightProjection * lightView;
+
+		ew::CPUProfiler::beginScope("Transforms");
+		transforms.update();
+
+		for (int i = 0; i < NUM_OBJECTS; i++) {
+			if (!transforms.wasUpdated(objectTransforms[i])) {
+				continue;
+			}
+			const glm::mat4& model = transforms.getModelMatrix(objectTransforms[i]);
+			sceneBatch.setObject(i, model, objectMaterials[i]);
+			sceneBVH.update(i, sceneBatch.getBounds(objectMeshes[i]).transformed(model));
+		}
+		ew::CPUProfiler::endScope();
+
+		//Level of detail from this frame's size on screen, before anything reads the objects' meshes
+		ew::CPUProfiler::beginScope("LOD");
+		lodSelector.setView(camera.getPosition(), camera.getFov(), SCREEN_HEIGHT);
+		for (int i = 0; i < NUM_OBJECTS; i++) {
+			int numLODs = sceneBatch.getNumLODs(objectMeshes[i]);
+			if (numLODs == 1) {
+				continue;
+			}
+			ew::BoundingSphere sphere = sceneBatch.getBoundingSphere(objectMeshes[i]).transformed(transforms.getModelMatrix(objectTransforms[i]));
+			objectLevels[i] = useLOD ? lodSelector.select(objectLevels[i], numLODs, sphere) : 0;
+			sceneBatch.setObjectMesh(i, objectMeshes[i] + objectLevels[i]);
+		}
+		ew::CPUProfiler::endScope();
+
+		//A draw list per view with only what that view can see
+		ew::CPUProfiler::beginScope("DrawLists");
+		lightFrustum = ew::Frustum::fromMatrix(lightSpaceMatrix);
+		sceneBatch.clearDraws();
+		if (!gpuCulling) {
+			visibleObjects.clear();
+			sceneBVH.queryFrustum(camera.getFrustum(), visibleObjects);
+			shadowCasters.clear();
+			sceneBVH.queryFrustum(lightFrustum, shadowCasters);
+			for (size_t i = 0; i < visibleObjects.size(); i++) {
+				sceneBatch.addDraw(CAMERA_LIST, visibleObjects[i]);
+			}
+			for (size_t i = 0; i < shadowCasters.size(); i++) {
+				sceneBatch.addDraw(SHADOW_LIST, shadowCasters[i]);
+			}
+		}
+		useOcclusion = gpuCulling && occlusionCulling;
+		if (useOcclusion) {
+			for (int i = 0; i < NUM_OBJECTS; i++) {
+				if (isOccluder[i]) {
+					sceneBatch.addDraw(OCCLUDER_LIST, i);
+				}
+			}
+		}
+		sceneBatch.submit();
+		ew::CPUProfiler::endScope();
+
+		//Everything from the culling to the screen, the UI draws on top after
+		frameGraph.setEnabled(cullingPass, gpuCulling);
+		frameGraph.setScreenSize(SCREEN_WIDTH, SCREEN_HEIGHT);
+		frameGraph.execute();
 
 		//Draw UI
+		ew::CPUProfiler::beginScope("ImGuiBuild");
 		ImGui::Begin("Settings");
 		ImGui::SliderFloat("Material Ambient K", &ambientK, 0, 1);
 		ImGui::SliderFloat("Material Diffuse K", &diffuseK, 0, 1);
@@ -295,30 +580,79 @@ int main() {
 		ImGui::SliderFloat("Min Bias Value", &minBias, 0.001f, 0.009f);
 		ImGui::SliderFloat("Max Bias Value", &maxBias, 0.01f, 0.1f);
 
+		ImGui::Combo("Post Effect", &postEffect, POST_EFFECTS);
+
+		ImGui::Text("Materials: %d (%s)", materials.getNumMaterials(), materials.isBindless() ? "bindless" : "texture array");
+		if (gpuCullingSupported) {
+			ImGui::Checkbox("GPU Culling", &gpuCulling);
+		}
+		if (gpuCulling) {
+			ImGui::Checkbox("Occlusion Culling", &occlusionCulling);
+			const ew::CullStats& cameraStats = gpuCuller.getStats(CAMERA_LIST);
+			const ew::CullStats& shadowStats = gpuCuller.getStats(SHADOW_LIST);
+			ImGui::Text("Objects: %d, culled on the GPU", sceneBatch.getNumObjects());
+			ImGui::Text("Camera: %u drawn, %u outside, %u occluded", cameraStats.drawn, cameraStats.frustumCulled, cameraStats.occluded);
+			ImGui::Text("Shadows: %u drawn, %u outside", shadowStats.drawn, shadowStats.frustumCulled);
+			ImGui::Text("Triangles: %u camera, %u shadows", cameraStats.triangles, shadowStats.triangles);
+		}
+		else {
+			ImGui::Text("Objects: %d, visible: %d, shadow casters: %d", sceneBatch.getNumObjects(),
+				sceneBatch.getNumDraws(CAMERA_LIST), sceneBatch.getNumDraws(SHADOW_LIST));
+			ImGui::Text("Triangles: %d camera, %d shadows", sceneBatch.getNumTriangles(CAMERA_LIST), sceneBatch.getNumTriangles(SHADOW_LIST));
+		}
+		ImGui::Checkbox("LOD", &useLOD);
+		if (useLOD) {
+			float fullDetailPixels = lodSelector.getFullDetailPixels();
+			if (ImGui::SliderFloat("LOD Full Detail Pixels", &fullDetailPixels, 32, 1024)) {
+				lodSelector.setFullDetailPixels(fullDetailPixels);
+			}
+		}
+		ImGui::Text("LOD: sphere %d (%d tris), cylinder %d (%d tris)", objectLevels[1], sceneBatch.getMeshTriangles(objectMeshes[1] + objectLevels[1]),
+			objectLevels[2], sceneBatch.getMeshTriangles(objectMeshes[2] + objectLevels[2]));
+		ImGui::Text("Under cursor: %s", hoveredObject >= 0 ? OBJECT_NAMES[hoveredObject] : "nothing");
+		ImGui::Text("Transforms: %d, rebuilt this frame: %d", transforms.getNumTransforms(), transforms.getNumUpdated());
+		ImGui::Text("Virtual ground: %d/%d pages resident, %d streaming, %.1f MB%s", groundTexture.getResidentPages(),
+			groundTexture.getCapacity(), groundTexture.getPendingPages(), groundTexture.getCacheMB(), groundTexture.isSparse() ? " (sparse)" : "");
+
+		bool glStateDebug = glState.isDebug();
+		if (ImGui::Checkbox("Count GL Calls", &glStateDebug)) {
+			glState.setDebug(glStateDebug);
+		}
+		if (glStateDebug) {
+			ImGui::Text("GL state calls last frame: %d issued, %d skipped, %d mismatches", glState.getIssuedCalls(),
+				glState.getSkippedCalls(), glState.getMismatches());
+		}
+
 		lightPosition = glm::normalize(-dirLight.direction) * lightDistance;
 
+		frameGraph.drawImGui();
+		ew::GPUProfiler::get().drawImGui();
+		ew::CPUProfiler::get().drawImGui(&ew::GPUProfiler::get());
+
 		ImGui::End();
 
 		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		ew::CPUProfiler::endScope();
+		//Benchmarks and dumped frames are of the scene only
+		if (!headlessRun.isEnabled()) {
+			PROFILE_CPU("UI");
+			PROFILE_GPU("UI");
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		}
+		ew::GPUProfiler::get().endFrame();
+		headlessRun.endFrame();
 		glfwPollEvents();
 
+		//Includes waiting on vsync and on the GPU catching up
+		ew::CPUProfiler::beginScope("SwapBuffers");
 		glfwSwapBuffers(window);
+		ew::CPUProfiler::endScope();
 	}
 
-	glDeleteTextures(1, &texture);
-	glDeleteFramebuffers(1, &fbo);
+	bool headlessWritten = headlessRun.finish();
 
 	glfwTerminate();
-	return 0;
-}
-
-//Author: Sam Fox
-void renderObjectInScene(Shader& shader, ew::Transform& transform, ew::Mesh& mesh)
-{
-	//Draw cube
-	shader.setMat4("_Model", transform.getModelMatrix());
-	mesh.draw();
+	return headlessWritten ? 0 : 1;
 }
 
 //Author: Sam Fox
@@ -327,7 +661,7 @@ GLuint createTexture(const char* filePath)
 	//texture stuff
 	GLuint texture = NULL;
 	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	ew::GLState::get().bindTexture(GL_TEXTURE_2D, texture);
 
 	//Load texture data as file
 	int width, height, numComponents;
@@ -378,7 +712,7 @@ void resizeFrameBufferCallback(GLFWwindow* window, int width, int height)
 	SCREEN_WIDTH = width;
 	SCREEN_HEIGHT = height;
 	camera.setAspectRatio((float)SCREEN_WIDTH / SCREEN_HEIGHT);
-	glViewport(0, 0, width, height);
+	ew::GLState::get().viewport(0, 0, width, height);
 }
 //Author: Eric Winebrenner
 void keyboardCallback(GLFWwindow* window, int keycode, int scancode, int action, int mods)
@@ -410,6 +744,13 @@ void mouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
 void mousePosCallback(GLFWwindow* window, double xpos, double ypos)
 {
 	if (glfwGetInputMode(window, GLFW_CURSOR) != GLFW_CURSOR_DISABLED) {
+		//Free cursor: pick whatever is under it, ray from the near plane to the far plane
+		glm::vec2 ndc((float)(2.0 * xpos / SCREEN_WIDTH - 1.0), (float)(1.0 - 2.0 * ypos / SCREEN_HEIGHT));
+		glm::mat4 inverseViewProjection = glm::inverse(camera.getViewProjectionMatrix());
+		glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+		glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+		glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+		hoveredObject = sceneBVH.raycast(origin, glm::vec3(farPoint) / farPoint.w - origin, 1.0f);
 		return;
 	}
 	if (!firstMouseInput) {
@@ -433,6 +774,7 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 		int inputMode = glfwGetInputMode(window, GLFW_CURSOR) == GLFW_CURSOR_DISABLED ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED;
 		glfwSetInputMode(window, GLFW_CURSOR, inputMode);
 		glfwGetCursorPos(window, &prevMouseX, &prevMouseY);
+		hoveredObject = -1;
 	}
 }
 
@@ -1,4 +1,7 @@
 #version 450                          
+#ifdef BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
 out vec4 FragColor;
 
 uniform float _AmbientK;
@@ -10,7 +13,67 @@ uniform float _Shininess;
 uniform vec3 _CameraPos;
 uniform vec3 _Color; //material color
 
-uniform sampler2D _Texture;
+//Mirrors ew::MaterialTable::GPUMaterial
+struct Material
+{
+    uvec2 albedoHandle; //resident bindless handles
+    uvec2 ormHandle;
+    float albedoLayer;  //layers of _MaterialArray when bindless isn't available
+    float ormLayer;
+    uint flags;         //MATERIAL_VIRTUAL | MATERIAL_ORM | MATERIAL_ALBEDO
+    uint pad;
+    vec4 color;
+};
+
+#define MATERIAL_VIRTUAL 1u
+#define MATERIAL_ORM 2u
+#define MATERIAL_ALBEDO 4u
+
+layout (std430, binding = 1) readonly buffer Materials
+{
+    Material _Materials[];
+};
+
+#ifndef BINDLESS
+uniform sampler2DArray _MaterialArray;
+#endif
+
+flat in uint MaterialIndex;
+
+//Virtual texture, see ew::VirtualTexture
+uniform usampler2D _VTPageTable; //(slot x, slot y, mapped mip, valid)
+uniform sampler2D _VTCache;
+uniform float _VTVirtualSize;
+uniform float _VTPageSize;
+uniform float _VTSlotSize;
+uniform float _VTBorder;
+uniform float _VTCacheSize;
+uniform int _VTMaxMip;
+uniform float _VTMipBias;
+
+int VirtualMip(vec2 uv)
+{
+    vec2 texel = uv * _VTVirtualSize;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float mip = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + _VTMipBias;
+    return int(clamp(mip, 0, _VTMaxMip));
+}
+
+vec3 SampleVirtual(vec2 uv)
+{
+    int mip = VirtualMip(uv); //before fract, it would put a seam in the derivatives
+    uv = fract(uv);
+
+    float pagesPerSide = _VTVirtualSize / _VTPageSize;
+    ivec2 page = ivec2(uv * pagesPerSide) >> mip;
+    uvec4 entry = texelFetch(_VTPageTable, page, mip);
+
+    //the entry may point at a coarser ancestor while the requested page streams in
+    vec2 inPage = fract(uv * (pagesPerSide / float(1 << entry.z)));
+    vec2 cacheTexel = vec2(entry.xy) * _VTSlotSize + _VTBorder + inPage * _VTPageSize;
+    return textureLod(_VTCache, cacheTexel / _VTCacheSize, 0).rgb;
+}
 
 uniform sampler2D _ShadowMap;
 
@@ -85,20 +148,51 @@ vec3 CalculateSpecular(float lightIntensity, vec3 lightColor, vec3 lightDir, vec
     return (_SpecularK * pow(specularDot, _Shininess) * lightIntensity) * lightColor;
 }
 
+vec3 SampleAlbedo(Material material, vec2 uv)
+{
+    if ((material.flags & MATERIAL_ALBEDO) == 0u)
+    {
+        return vec3(1.0);
+    }
+#ifdef BINDLESS
+    return texture(sampler2D(material.albedoHandle), uv).rgb;
+#else
+    return texture(_MaterialArray, vec3(uv, material.albedoLayer)).rgb;
+#endif
+}
+
+//R = occlusion, G = roughness, B = metalness, A = displacement
+vec4 SampleORM(Material material, vec2 uv)
+{
+    if ((material.flags & MATERIAL_ORM) == 0u)
+    {
+        return vec4(1.0, 0.5, 0.0, 0.0);
+    }
+#ifdef BINDLESS
+    return texture(sampler2D(material.ormHandle), uv);
+#else
+    return texture(_MaterialArray, vec3(uv, material.ormLayer));
+#endif
+}
+
 void main()
 {             
-    vec3 color = texture(_Texture, vs_out.UV).rgb;
+    Material material = _Materials[MaterialIndex];
+    bool isVirtual = (material.flags & MATERIAL_VIRTUAL) != 0u;
+    vec3 albedo = isVirtual ? SampleVirtual(vs_out.UV) : SampleAlbedo(material, vs_out.UV);
+    vec4 orm = SampleORM(material, vs_out.UV);
+    vec3 color = albedo * material.color.rgb;
     vec3 normal = normalize(vs_out.Normal);
 
     // ambient
-    vec3 ambient = CalculateAmbient(_Light.intensity, _Light.color);
+    vec3 ambient = CalculateAmbient(_Light.intensity, _Light.color) * orm.r;
 
     // diffuse
     vec3 lightDir = normalize(_LightPos - vs_out.WorldPosition);//normalize(_Light.direction);
     vec3 diffuse = CalculateDiffuse(_Light.intensity, _Light.color, lightDir, normal);
 
     // specular
-    vec3 specular = CalculateSpecular(_Light.intensity, _Light.color, lightDir, normal);
+    vec3 specular = CalculateSpecular(_Light.intensity, _Light.color, lightDir, normal) * (1.0 - orm.g);
 
     // calculate shadow
     float shadow = ShadowCalculation(dot(lightDir, normal));
@@ -3,8 +3,19 @@ layout (location = 0) in vec3 vPos;
 layout (location = 1) in vec3 vNormal;
 layout (location = 2) in vec2 vTexCoord;
 layout (location = 3) in vec3 vTangent;
+layout (location = 4) in uint vDrawID; //per instance, = baseInstance of the indirect command
+
+struct ObjectData
+{
+    mat4 model;
+    uint materialIndex;
+};
+
+layout (std430, binding = 0) readonly buffer Objects
+{
+    ObjectData _Objects[];
+};
 
-uniform mat4 _Model;
 uniform mat4 _View;
 uniform mat4 _Projection;
 uniform mat4 _LightSpaceMatrix;
@@ -17,7 +28,11 @@ out struct Vertex
     vec4 FragPosLightSpace;
 }vs_out;
 
+flat out uint MaterialIndex;
+
 void main(){    
+    mat4 _Model = _Objects[vDrawID].model;
+    MaterialIndex = _Objects[vDrawID].materialIndex;
     vs_out.WorldPosition = vec3(_Model * vec4(vPos, 1));
 
     vs_out.Normal = vNormal;
@@ -1,10 +1,21 @@
 #version 450                          
 layout (location = 0) in vec3 vPos;
+layout (location = 4) in uint vDrawID;
+
+struct ObjectData
+{
+    mat4 model;
+    uint materialIndex;
+};
+
+layout (std430, binding = 0) readonly buffer Objects
+{
+    ObjectData _Objects[];
+};
 
 uniform mat4 _LightSpaceMatrix;
-uniform mat4 _Model;
 
 void main()
 {
-    gl_Position = _LightSpaceMatrix * _Model * vec4(vPos, 1.0);
+    gl_Position = _LightSpaceMatrix * _Objects[vDrawID].model * vec4(vPos, 1.0);
 }  
\ No newline at end of file
@@ -0,0 +1,84 @@
+#version 450
+//Records which virtual texture pages are visible. Rendered at 1 / FEEDBACK_SCALE resolution
+layout (early_fragment_tests) in;
+
+struct Material
+{
+    uvec2 albedoHandle; //resident bindless handles
+    uvec2 ormHandle;
+    float albedoLayer;  //layers of _MaterialArray when bindless isn't available
+    float ormLayer;
+    uint flags;         //MATERIAL_VIRTUAL | MATERIAL_ORM | MATERIAL_ALBEDO
+    uint pad;
+    vec4 color;
+};
+
+#define MATERIAL_VIRTUAL 1u
+#define MATERIAL_ORM 2u
+#define MATERIAL_ALBEDO 4u
+
+layout (std430, binding = 1) readonly buffer Materials
+{
+    Material _Materials[];
+};
+
+//one bit per page, mips packed one after another
+layout (std430, binding = 2) buffer Feedback
+{
+    uint _RequestedPages[];
+};
+
+in struct Vertex
+{
+    vec3 Normal;
+    vec3 WorldPosition;
+    vec2 UV;
+    vec4 FragPosLightSpace;
+}vs_out;
+
+flat in uint MaterialIndex;
+
+//Virtual texture, see ew::VirtualTexture
+uniform usampler2D _VTPageTable; //(slot x, slot y, mapped mip, valid)
+uniform sampler2D _VTCache;
+uniform float _VTVirtualSize;
+uniform float _VTPageSize;
+uniform float _VTSlotSize;
+uniform float _VTBorder;
+uniform float _VTCacheSize;
+uniform int _VTMaxMip;
+uniform float _VTMipBias;
+
+int VirtualMip(vec2 uv)
+{
+    vec2 texel = uv * _VTVirtualSize;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float mip = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + _VTMipBias;
+    return int(clamp(mip, 0, _VTMaxMip));
+}
+
+void main()
+{
+    if ((_Materials[MaterialIndex].flags & MATERIAL_VIRTUAL) == 0u)
+    {
+        return;
+    }
+
+    int mip = VirtualMip(vs_out.UV);
+    int pagesPerSide = int(_VTVirtualSize / _VTPageSize);
+    ivec2 page = ivec2(fract(vs_out.UV) * pagesPerSide) >> mip;
+
+    int index = 0;
+    for (int i = 0; i < mip; i++)
+    {
+        index += (pagesPerSide >> i) * (pagesPerSide >> i);
+    }
+    index += page.y * (pagesPerSide >> mip) + page.x;
+
+    uint bit = 1u << (index & 31);
+    if ((_RequestedPages[index >> 5] & bit) == 0)
+    {
+        atomicOr(_RequestedPages[index >> 5], bit);
+    }
+}
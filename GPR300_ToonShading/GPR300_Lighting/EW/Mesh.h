@@ -30,6 +30,9 @@ namespace ew {
 		Mesh(MeshData* meshData);
 		~Mesh();
 		void draw();
+		//For callers that track the bound VAO themselves
+		GLuint getVAO() const { return mVAO; }
+		GLsizei getNumIndices() const { return mNumIndices; }
 	private:
 		GLuint mVAO, mVBO, mEBO;
 		GLsizei mNumIndices;
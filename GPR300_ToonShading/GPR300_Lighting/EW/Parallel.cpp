@@ -0,0 +1,145 @@
+//Author: Sam Fox
+
+#include "Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ew {
+	//One parallelFor call. Lives on the caller's stack until every worker has let go of it
+	struct ParallelJob {
+		const std::function<void(int, int)>* func;
+		int count;
+		int batchSize;
+		int numBatches;
+		std::atomic<int> nextBatch;
+		std::atomic<int> doneBatches;
+		int numWorkers; //workers currently holding the job, guarded by the pool mutex
+	};
+
+	class WorkerPool {
+	public:
+		WorkerPool()
+			: mJob(NULL), mGeneration(0), mQuit(false)
+		{
+			unsigned int hardwareThreads = std::thread::hardware_concurrency();
+			int numWorkers = hardwareThreads > 1 ? (int)hardwareThreads - 1 : 0;
+			for (int i = 0; i < numWorkers; i++) {
+				mThreads.push_back(std::thread(&WorkerPool::workerLoop, this));
+			}
+		}
+
+		~WorkerPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mQuit = true;
+			}
+			mWake.notify_all();
+			for (size_t i = 0; i < mThreads.size(); i++) {
+				mThreads[i].join();
+			}
+		}
+
+		int getNumThreads() const { return (int)mThreads.size() + 1; }
+
+		void run(ParallelJob& job)
+		{
+			std::lock_guard<std::mutex> callerLock(mCallerMutex);
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mJob = &job;
+				mGeneration++;
+			}
+			mWake.notify_all();
+
+			runBatches(job);
+
+			std::unique_lock<std::mutex> lock(mMutex);
+			mDone.wait(lock, [&]() { return job.doneBatches.load() == job.numBatches && job.numWorkers == 0; });
+			mJob = NULL;
+		}
+
+	private:
+		static void runBatches(ParallelJob& job)
+		{
+			int batch;
+			while ((batch = job.nextBatch.fetch_add(1)) < job.numBatches)
+			{
+				int begin = batch * job.batchSize;
+				(*job.func)(begin, std::min(begin + job.batchSize, job.count));
+				job.doneBatches.fetch_add(1);
+			}
+		}
+
+		void workerLoop()
+		{
+			unsigned int seenGeneration = 0;
+			std::unique_lock<std::mutex> lock(mMutex);
+			while (true)
+			{
+				mWake.wait(lock, [&]() { return mQuit || (mJob != NULL && mGeneration != seenGeneration); });
+				if (mQuit) {
+					return;
+				}
+				seenGeneration = mGeneration;
+				ParallelJob* job = mJob;
+				job->numWorkers++;
+				lock.unlock();
+
+				runBatches(*job);
+
+				lock.lock();
+				job->numWorkers--;
+				mDone.notify_all();
+			}
+		}
+
+		std::vector<std::thread> mThreads;
+		std::mutex mMutex;
+		std::mutex mCallerMutex; //one parallelFor at a time
+		std::condition_variable mWake;
+		std::condition_variable mDone;
+		ParallelJob* mJob;
+		unsigned int mGeneration;
+		bool mQuit;
+	};
+
+	static WorkerPool& getPool()
+	{
+		static WorkerPool pool;
+		return pool;
+	}
+
+	void parallelFor(int count, int minBatch, const std::function<void(int, int)>& func)
+	{
+		if (count <= 0) {
+			return;
+		}
+		WorkerPool& pool = getPool();
+		//A few batches per thread evens out ranges that take longer than others
+		int batchSize = std::max(minBatch, (count + pool.getNumThreads() * 4 - 1) / (pool.getNumThreads() * 4));
+		if (batchSize >= count || pool.getNumThreads() == 1) {
+			func(0, count);
+			return;
+		}
+
+		ParallelJob job;
+		job.func = &func;
+		job.count = count;
+		job.batchSize = batchSize;
+		job.numBatches = (count + batchSize - 1) / batchSize;
+		job.nextBatch = 0;
+		job.doneBatches = 0;
+		job.numWorkers = 0;
+		pool.run(job);
+	}
+
+	int getNumThreads()
+	{
+		return getPool().getNumThreads();
+	}
+}
@@ -0,0 +1,14 @@
+//Author: Sam Fox
+
+#pragma once
+#include <functional>
+
+namespace ew {
+	//Calls func(begin, end) on sub ranges of [0, count) spread over a pool of worker threads and the caller.
+	//Returns once every range is done. Ranges are at least minBatch long, so small loops stay on the calling thread.
+	//func must not call parallelFor itself.
+	void parallelFor(int count, int minBatch, const std::function<void(int, int)>& func);
+
+	//Worker threads plus the calling thread
+	int getNumThreads();
+}
@@ -0,0 +1,189 @@
+//Author: Sam Fox
+
+#include "RenderQueue.h"
+#include <stdio.h>
+#include <string.h>
+#include <utility>
+
+namespace ew {
+	static const int PASS_SHIFT = 60;
+	static const int PROGRAM_SHIFT = 52;
+	static const int MATERIAL_SHIFT = 40;
+	static const int MESH_SHIFT = 24;
+	static const int DEPTH_BITS = 24;
+
+	int RenderQueue::addPass(GLenum stencilFunc, GLuint stencilWriteMask)
+	{
+		if ((int)mPasses.size() >= MAX_PASSES) {
+			printf("RenderQueue: more than %d passes\n", MAX_PASSES);
+			return -1;
+		}
+		Pass pass;
+		pass.stencilFunc = stencilFunc;
+		pass.stencilWriteMask = stencilWriteMask;
+		mPasses.push_back(pass);
+		return (int)mPasses.size() - 1;
+	}
+
+	int RenderQueue::addProgram(Shader* shader)
+	{
+		if ((int)mPrograms.size() >= MAX_PROGRAMS) {
+			printf("RenderQueue: more than %d programs\n", MAX_PROGRAMS);
+			return -1;
+		}
+		mPrograms.push_back(shader);
+		return (int)mPrograms.size() - 1;
+	}
+
+	int RenderQueue::addMaterial(const MaterialTexture* textures, int count)
+	{
+		if ((int)mMaterials.size() >= MAX_MATERIALS) {
+			printf("RenderQueue: more than %d materials\n", MAX_MATERIALS);
+			return -1;
+		}
+		mMaterials.push_back(std::vector<MaterialTexture>(textures, textures + count));
+		return (int)mMaterials.size() - 1;
+	}
+
+	int RenderQueue::addMesh(Mesh* mesh)
+	{
+		if ((int)mMeshes.size() >= MAX_MESHES) {
+			printf("RenderQueue: more than %d meshes\n", MAX_MESHES);
+			return -1;
+		}
+		mMeshes.push_back(mesh);
+		return (int)mMeshes.size() - 1;
+	}
+
+	void RenderQueue::clear()
+	{
+		mDraws.clear();
+		mItems.clear();
+	}
+
+	void RenderQueue::submit(int pass, int program, int material, int mesh, float depth, const glm::mat4& model, int stencilRef)
+	{
+		//Non negative floats sort the same as their bits, the top DEPTH_BITS of them are plenty
+		uint32_t depthBits;
+		depth = depth > 0.0f ? depth : 0.0f;
+		memcpy(&depthBits, &depth, sizeof(depthBits));
+
+		SortItem item;
+		item.key = (uint64_t)pass << PASS_SHIFT
+			| (uint64_t)program << PROGRAM_SHIFT
+			| (uint64_t)material << MATERIAL_SHIFT
+			| (uint64_t)mesh << MESH_SHIFT
+			| (uint64_t)(depthBits >> (31 - DEPTH_BITS));
+		item.draw = (uint32_t)mDraws.size();
+		mItems.push_back(item);
+
+		Draw draw;
+		draw.model = model;
+		draw.stencilRef = stencilRef;
+		mDraws.push_back(draw);
+	}
+
+	void RenderQueue::radixSort()
+	{
+		//LSD, a byte at a time. Stable, so equal keys keep their submission order
+		mSortScratch.resize(mItems.size());
+		std::vector<SortItem>* src = &mItems;
+		std::vector<SortItem>* dst = &mSortScratch;
+		for (int shift = 0; shift < 64; shift += 8) {
+			size_t offsets[256] = { 0 };
+			for (size_t i = 0; i < src->size(); i++) {
+				offsets[((*src)[i].key >> shift) & 0xFF]++;
+			}
+			//Every key has the same byte here, nothing would move
+			if (offsets[((*src)[0].key >> shift) & 0xFF] == src->size()) {
+				continue;
+			}
+			size_t total = 0;
+			for (int b = 0; b < 256; b++) {
+				size_t count = offsets[b];
+				offsets[b] = total;
+				total += count;
+			}
+			for (size_t i = 0; i < src->size(); i++) {
+				(*dst)[offsets[((*src)[i].key >> shift) & 0xFF]++] = (*src)[i];
+			}
+			std::swap(src, dst);
+		}
+		if (src != &mItems) {
+			mItems.swap(mSortScratch);
+		}
+	}
+
+	void RenderQueue::run(const std::vector<SortItem>& items, bool issue, RenderStats& stats) const
+	{
+		stats = RenderStats();
+		int currentPass = -1, currentProgram = -1, currentMaterial = -1, currentMesh = -1, currentStencilRef = -1;
+		for (size_t i = 0; i < items.size(); i++) {
+			uint64_t key = items[i].key;
+			int pass = (int)(key >> PASS_SHIFT);
+			int program = (int)(key >> PROGRAM_SHIFT) & (MAX_PROGRAMS - 1);
+			int material = (int)(key >> MATERIAL_SHIFT) & (MAX_MATERIALS - 1);
+			int mesh = (int)(key >> MESH_SHIFT) & (MAX_MESHES - 1);
+			const Draw& draw = mDraws[items[i].draw];
+
+			if (pass != currentPass) {
+				stats.passChanges++;
+				if (issue) {
+					glStencilMask(mPasses[pass].stencilWriteMask);
+				}
+			}
+			if (pass != currentPass || draw.stencilRef != currentStencilRef) {
+				stats.stencilRefChanges++;
+				if (issue) {
+					glStencilFunc(mPasses[pass].stencilFunc, draw.stencilRef, 0xFF);
+				}
+				currentStencilRef = draw.stencilRef;
+			}
+			currentPass = pass;
+			if (program != currentProgram) {
+				stats.programBinds++;
+				if (issue) {
+					mPrograms[program]->use();
+				}
+				currentProgram = program;
+			}
+			if (material != currentMaterial) {
+				const std::vector<MaterialTexture>& textures = mMaterials[material];
+				stats.textureBinds += (int)textures.size();
+				for (size_t t = 0; issue && t < textures.size(); t++) {
+					glActiveTexture(GL_TEXTURE0 + textures[t].unit);
+					glBindTexture(textures[t].target, textures[t].texture);
+				}
+				currentMaterial = material;
+			}
+			if (mesh != currentMesh) {
+				stats.vaoBinds++;
+				if (issue) {
+					glBindVertexArray(mMeshes[mesh]->getVAO());
+				}
+				currentMesh = mesh;
+			}
+
+			stats.draws++;
+			if (issue) {
+				mPrograms[program]->setMat4("_Model", draw.model);
+				glDrawElements(GL_TRIANGLES, mMeshes[mesh]->getNumIndices(), GL_UNSIGNED_INT, 0);
+			}
+		}
+	}
+
+	void RenderQueue::execute()
+	{
+		if (mItems.empty()) {
+			mStats = RenderStats();
+			mUnsortedStats = RenderStats();
+			return;
+		}
+		run(mItems, false, mUnsortedStats);
+		radixSort();
+		run(mItems, true, mStats);
+
+		glStencilFunc(GL_ALWAYS, 0, 0xFF);
+		glStencilMask(0xFF);
+	}
+}
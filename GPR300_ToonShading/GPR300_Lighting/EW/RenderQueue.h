@@ -0,0 +1,93 @@
+//Author: Sam Fox
+
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+#include "Mesh.h"
+#include "Shader.h"
+
+namespace ew {
+	/// <summary>
+	/// GL state changes made to draw one frame
+	/// </summary>
+	struct RenderStats {
+		int draws = 0;
+		int passChanges = 0;
+		int programBinds = 0;
+		int textureBinds = 0;
+		int vaoBinds = 0;
+		int stencilRefChanges = 0;
+		int getStateChanges() const { return passChanges + programBinds + textureBinds + vaoBinds + stencilRefChanges; }
+	};
+
+	/// <summary>
+	/// Draws are recorded first and issued later. Each draw gets a 64 bit key, pass | program | material | mesh | depth
+	/// from the highest bits down. A radix sort on the keys puts everything sharing a program, then textures, then a VAO
+	/// next to each other, nearest first, and execute() only changes state where neighbours differ.
+	/// Passes, programs, materials and meshes are registered once and referred to by index.
+	/// </summary>
+	class RenderQueue {
+	public:
+		static const int MAX_PASSES = 1 << 4;
+		static const int MAX_PROGRAMS = 1 << 8;
+		static const int MAX_MATERIALS = 1 << 12;
+		static const int MAX_MESHES = 1 << 16;
+
+		struct MaterialTexture {
+			GLuint unit;
+			GLenum target;
+			GLuint texture;
+		};
+
+		//Passes draw in the order they were added. glStencilFunc's reference comes from each draw
+		int addPass(GLenum stencilFunc, GLuint stencilWriteMask);
+		//Frame uniforms are the caller's, set them before execute. The queue only sets _Model
+		int addProgram(Shader* shader);
+		//Bound to their units when a draw needs them, count can be 0
+		int addMaterial(const MaterialTexture* textures, int count);
+		int addMesh(Mesh* mesh);
+
+		void clear();
+		//depth is any value that grows away from the camera, must not be negative
+		void submit(int pass, int program, int material, int mesh, float depth, const glm::mat4& model, int stencilRef = 0);
+		//Sorts, draws, then leaves the stencil test writing with GL_ALWAYS
+		void execute();
+
+		int getNumDraws() const { return (int)mDraws.size(); }
+		//What the last execute changed
+		const RenderStats& getStats() const { return mStats; }
+		//What drawing the same frame in submission order would have changed
+		const RenderStats& getUnsortedStats() const { return mUnsortedStats; }
+
+	private:
+		struct Pass {
+			GLenum stencilFunc;
+			GLuint stencilWriteMask;
+		};
+		struct Draw {
+			glm::mat4 model;
+			int stencilRef;
+		};
+		struct SortItem {
+			uint64_t key;
+			uint32_t draw;
+		};
+
+		void radixSort();
+		//Walks items changing only what differs from the previous draw. Counts without touching GL if issue is false
+		void run(const std::vector<SortItem>& items, bool issue, RenderStats& stats) const;
+
+		std::vector<Pass> mPasses;
+		std::vector<Shader*> mPrograms;
+		std::vector<std::vector<MaterialTexture>> mMaterials;
+		std::vector<Mesh*> mMeshes;
+
+		std::vector<Draw> mDraws;
+		std::vector<SortItem> mItems;
+		std::vector<SortItem> mSortScratch;
+		RenderStats mStats;
+		RenderStats mUnsortedStats;
+	};
+}
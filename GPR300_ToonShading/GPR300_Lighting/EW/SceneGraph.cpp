@@ -0,0 +1,152 @@
+//Author: Sam Fox
+
+#include "SceneGraph.h"
+#include "Parallel.h"
+#include "SimdMath.h"
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+
+namespace ew {
+	//Nodes of one level handed to a thread at a time
+	static const int LEVEL_BATCH = 256;
+
+	const int SceneGraph::NO_PARENT;
+
+	int SceneGraph::createNode(const Transform& local, int parent)
+	{
+		int node = (int)mSlots.size();
+		int slot = (int)mNodes.size();
+		mSlots.push_back(slot);
+		mNodes.push_back(node);
+		mParentSlots.push_back(parent == NO_PARENT ? NO_PARENT : mSlots[parent]);
+		mLocals.push_back(local);
+		mLocalMatrices.push_back(glm::mat4(1));
+		mWorldMatrices.push_back(glm::mat4(1));
+		mLocalDirty.push_back(1);
+		mWorldDirty.push_back(1);
+		mNeedsSort = true;
+		mAnyDirty = true;
+		return node;
+	}
+
+	int SceneGraph::getParent(int node) const
+	{
+		int parentSlot = mParentSlots[mSlots[node]];
+		return parentSlot == NO_PARENT ? NO_PARENT : mNodes[parentSlot];
+	}
+
+	void SceneGraph::setParent(int node, int parent)
+	{
+		//A node can't end up below itself
+		for (int ancestor = parent; ancestor != NO_PARENT; ancestor = getParent(ancestor)) {
+			if (ancestor == node) {
+				printf("SceneGraph: node %d can't be parented to its descendant %d\n", node, parent);
+				return;
+			}
+		}
+		mParentSlots[mSlots[node]] = parent == NO_PARENT ? NO_PARENT : mSlots[parent];
+		markDirty(node);
+		mNeedsSort = true;
+	}
+
+	void SceneGraph::sort()
+	{
+		int count = (int)mNodes.size();
+
+		//Depth of every slot, parents may still come after their children here
+		std::vector<int> depths(count, -1);
+		for (int slot = 0; slot < count; slot++)
+		{
+			int depth = 0;
+			int ancestor = mParentSlots[slot];
+			while (ancestor != NO_PARENT && depths[ancestor] < 0) {
+				depth++;
+				ancestor = mParentSlots[ancestor];
+			}
+			depths[slot] = depth + (ancestor == NO_PARENT ? 0 : depths[ancestor] + 1);
+		}
+
+		//Stable, so siblings keep their creation order
+		std::vector<int> order(count);
+		for (int i = 0; i < count; i++) {
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return depths[a] < depths[b]; });
+
+		std::vector<int> newSlots(count);
+		for (int i = 0; i < count; i++) {
+			newSlots[order[i]] = i;
+		}
+		std::vector<int> nodes(count), parentSlots(count);
+		std::vector<Transform> locals(count);
+		std::vector<glm::mat4> localMatrices(count), worldMatrices(count);
+		std::vector<unsigned char> localDirty(count), worldDirty(count);
+		mLevelStarts.clear();
+		for (int i = 0; i < count; i++)
+		{
+			int old = order[i];
+			nodes[i] = mNodes[old];
+			parentSlots[i] = mParentSlots[old] == NO_PARENT ? NO_PARENT : newSlots[mParentSlots[old]];
+			locals[i] = mLocals[old];
+			localMatrices[i] = mLocalMatrices[old];
+			worldMatrices[i] = mWorldMatrices[old];
+			localDirty[i] = mLocalDirty[old];
+			worldDirty[i] = mWorldDirty[old];
+			mSlots[nodes[i]] = i;
+			while ((int)mLevelStarts.size() <= depths[old]) {
+				mLevelStarts.push_back(i);
+			}
+		}
+		mLevelStarts.push_back(count);
+
+		mNodes.swap(nodes);
+		mParentSlots.swap(parentSlots);
+		mLocals.swap(locals);
+		mLocalMatrices.swap(localMatrices);
+		mWorldMatrices.swap(worldMatrices);
+		mLocalDirty.swap(localDirty);
+		mWorldDirty.swap(worldDirty);
+		mNeedsSort = false;
+	}
+
+	void SceneGraph::update()
+	{
+		if (mNeedsSort) {
+			sort();
+		}
+		if (!mAnyDirty) {
+			mNumUpdated = 0;
+			return;
+		}
+
+		//A level only reads the level above it, which is finished by the time parallelFor returns
+		std::atomic<int> numUpdated(0);
+		for (size_t level = 0; level + 1 < mLevelStarts.size(); level++)
+		{
+			int levelStart = mLevelStarts[level];
+			parallelFor(mLevelStarts[level + 1] - levelStart, LEVEL_BATCH, [&](int begin, int end) {
+				int updated = 0;
+				for (int slot = levelStart + begin; slot < levelStart + end; slot++)
+				{
+					int parent = mParentSlots[slot];
+					bool worldDirty = mLocalDirty[slot] || (parent != NO_PARENT && mWorldDirty[parent]);
+					mWorldDirty[slot] = worldDirty;
+					if (!worldDirty) {
+						continue;
+					}
+					if (mLocalDirty[slot]) {
+						const Transform& local = mLocals[slot];
+						mLocalMatrices[slot] = composeTRS(local.position, local.rotation, local.scale);
+						mLocalDirty[slot] = 0;
+					}
+					mWorldMatrices[slot] = parent == NO_PARENT ? mLocalMatrices[slot] : mul(mWorldMatrices[parent], mLocalMatrices[slot]);
+					updated++;
+				}
+				numUpdated += updated;
+			});
+		}
+		mNumUpdated = numUpdated;
+		mAnyDirty = false;
+	}
+}
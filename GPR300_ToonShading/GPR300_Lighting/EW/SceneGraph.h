@@ -0,0 +1,63 @@
+//Author: Sam Fox
+
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "Transform.h"
+
+namespace ew {
+	/// <summary>
+	/// Transforms with parents. Nodes are stored breadth first in flat arrays, so every parent comes before its children
+	/// and each depth is one contiguous range. update() walks the levels in order, rebuilding only nodes whose local
+	/// transform or an ancestor changed, and splits each level across threads.
+	/// </summary>
+	class SceneGraph {
+	public:
+		static const int NO_PARENT = -1;
+
+		//Returns a handle that stays valid when the arrays are re-sorted
+		int createNode(const Transform& local = Transform(), int parent = NO_PARENT);
+		void setParent(int node, int parent);
+		int getParent(int node) const;
+		int getNumNodes() const { return (int)mSlots.size(); }
+
+		const Transform& getLocal(int node) const { return mLocals[mSlots[node]]; }
+		void setLocal(int node, const Transform& local) { mLocals[mSlots[node]] = local; markDirty(node); }
+		void setPosition(int node, const glm::vec3& position) { mLocals[mSlots[node]].position = position; markDirty(node); }
+		void setRotation(int node, const glm::quat& rotation) { mLocals[mSlots[node]].rotation = rotation; markDirty(node); }
+		//glm would turn a vec3 into a quat with its own Euler convention, use setEulerAngles
+		void setRotation(int node, const glm::vec3& euler) = delete;
+		void setEulerAngles(int node, const glm::vec3& euler) { mLocals[mSlots[node]].rotation = eulerToQuat(euler); markDirty(node); }
+		void setScale(int node, const glm::vec3& scale) { mLocals[mSlots[node]].scale = scale; markDirty(node); }
+
+		//Propagates every change since the last call
+		void update();
+		//Valid after update()
+		const glm::mat4& getWorldMatrix(int node) const { return mWorldMatrices[mSlots[node]]; }
+		glm::vec3 getWorldPosition(int node) const { return glm::vec3(mWorldMatrices[mSlots[node]][3]); }
+		//World matrices rebuilt by the last update()
+		int getNumUpdated() const { return mNumUpdated; }
+
+	private:
+		void markDirty(int node) { mLocalDirty[mSlots[node]] = 1; mAnyDirty = true; }
+		//Breadth first order and level ranges after nodes were added or moved
+		void sort();
+
+		//Indexed by node handle
+		std::vector<int> mSlots;
+		//Indexed by slot, sorted by depth
+		std::vector<int> mNodes;
+		std::vector<int> mParentSlots;
+		std::vector<Transform> mLocals;
+		std::vector<glm::mat4> mLocalMatrices;
+		std::vector<glm::mat4> mWorldMatrices;
+		std::vector<unsigned char> mLocalDirty;
+		std::vector<unsigned char> mWorldDirty;
+		//Slot range of depth d is [mLevelStarts[d], mLevelStarts[d + 1])
+		std::vector<int> mLevelStarts;
+
+		bool mNeedsSort = false;
+		bool mAnyDirty = false;
+		int mNumUpdated = 0;
+	};
+}
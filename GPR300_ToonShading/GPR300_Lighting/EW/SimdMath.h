@@ -0,0 +1,94 @@
+//Author: Sam Fox
+
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <math.h>
+#include <stddef.h>
+
+//SSE is always there on x64. Define EW_SIMD_SCALAR to compare against the plain C++ path
+#if !defined(EW_SIMD_SCALAR) && (defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define EW_SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+namespace ew {
+	/// <summary>
+	/// Same matrix as ew::translate(p) * ew::rotateX(r.x) * ew::rotateY(r.y) * ew::rotateZ(r.z) * ew::scale(s),
+	/// written out directly: one sin and cos per axis and no intermediate matrices.
+	/// </summary>
+	inline glm::mat4 composeTRS(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale) {
+		float sx = sinf(rotation.x), cx = cosf(rotation.x);
+		float sy = sinf(rotation.y), cy = cosf(rotation.y);
+		float sz = sinf(rotation.z), cz = cosf(rotation.z);
+		//ew::rotateY turns the opposite way of glm::rotate, hence the signs on sy
+		return glm::mat4(
+			glm::vec4(cy * cz, cx * sz - sx * sy * cz, sx * sz + cx * sy * cz, 0.0f) * scale.x,
+			glm::vec4(-cy * sz, cx * cz + sx * sy * sz, sx * cz - cx * sy * sz, 0.0f) * scale.y,
+			glm::vec4(-sy, -sx * cy, cx * cy, 0.0f) * scale.z,
+			glm::vec4(position, 1.0f));
+	}
+
+	//Same as composeTRS with the Euler angles the quaternion was built from, without any trig
+	inline glm::mat4 composeTRS(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+		float xx = rotation.x * rotation.x, yy = rotation.y * rotation.y, zz = rotation.z * rotation.z;
+		float xy = rotation.x * rotation.y, xz = rotation.x * rotation.z, yz = rotation.y * rotation.z;
+		float wx = rotation.w * rotation.x, wy = rotation.w * rotation.y, wz = rotation.w * rotation.z;
+		return glm::mat4(
+			glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f) * scale.x,
+			glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f) * scale.y,
+			glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f) * scale.z,
+			glm::vec4(position, 1.0f));
+	}
+
+	inline glm::mat4 mul(const glm::mat4& a, const glm::mat4& b) {
+		glm::mat4 out;
+#ifdef EW_SIMD_SSE
+		__m128 a0 = _mm_loadu_ps(&a[0][0]);
+		__m128 a1 = _mm_loadu_ps(&a[1][0]);
+		__m128 a2 = _mm_loadu_ps(&a[2][0]);
+		__m128 a3 = _mm_loadu_ps(&a[3][0]);
+		for (int c = 0; c < 4; c++) {
+			__m128 col = _mm_loadu_ps(&b[c][0]);
+			__m128 r = _mm_mul_ps(a0, _mm_shuffle_ps(col, col, 0x00));
+			r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_shuffle_ps(col, col, 0x55)));
+			r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_shuffle_ps(col, col, 0xAA)));
+			r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_shuffle_ps(col, col, 0xFF)));
+			_mm_storeu_ps(&out[c][0], r);
+		}
+#else
+		for (int c = 0; c < 4; c++) {
+			out[c] = a[0] * b[c].x + a[1] * b[c].y + a[2] * b[c].z + a[3] * b[c].w;
+		}
+#endif
+		return out;
+	}
+
+	inline glm::vec4 mul(const glm::mat4& m, const glm::vec4& v) {
+#ifdef EW_SIMD_SSE
+		__m128 vec = _mm_loadu_ps(&v.x);
+		__m128 r = _mm_mul_ps(_mm_loadu_ps(&m[0][0]), _mm_shuffle_ps(vec, vec, 0x00));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m[1][0]), _mm_shuffle_ps(vec, vec, 0x55)));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m[2][0]), _mm_shuffle_ps(vec, vec, 0xAA)));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m[3][0]), _mm_shuffle_ps(vec, vec, 0xFF)));
+		glm::vec4 out;
+		_mm_storeu_ps(&out.x, r);
+		return out;
+#else
+		return m[0] * v.x + m[1] * v.y + m[2] * v.z + m[3] * v.w;
+#endif
+	}
+
+	//Batched versions. They use AVX2 when the CPU has it, two columns per instruction
+	void composeTRS(const glm::vec3* positions, const glm::vec3* rotations, const glm::vec3* scales, glm::mat4* out, size_t count);
+	void composeTRS(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* out, size_t count);
+	//out[i] = a * b[i], e.g. view projection * model
+	void mul(const glm::mat4& a, const glm::mat4* b, glm::mat4* out, size_t count);
+	//out[i] = a[i] * b[i], e.g. parent world * local
+	void mul(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count);
+	//out[i] = m * v[i]
+	void mul(const glm::mat4& m, const glm::vec4* v, glm::vec4* out, size_t count);
+
+	//"AVX2", "SSE" or "Scalar", whichever the batched functions run
+	const char* getSimdPath();
+}
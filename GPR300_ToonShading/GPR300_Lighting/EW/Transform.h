@@ -3,19 +3,33 @@
 #pragma once
 #include <glm/glm.hpp>
 #include "ewMath.h"
+#include "SimdMath.h"
+#include "Quaternion.h"
 
 namespace ew {
 	struct Transform {
 		glm::vec3 position = glm::vec3(0);
-		glm::vec3 rotation = glm::vec3(0);
+		glm::quat rotation = glm::quat(1, 0, 0, 0);
 		glm::vec3 scale = glm::vec3(1);
 
-		glm::mat4 getModelMatrix() {
-			return ew::translate(position) * ew::rotateX(rotation.x) * ew::rotateY(rotation.y) * ew::rotateZ(rotation.z) * ew::scale(scale);
+		glm::mat4 getModelMatrix() const {
+			//Same result as translate * rotateX * rotateY * rotateZ * scale from ewMath.h with the Euler angles
+			return ew::composeTRS(position, rotation, scale);
+		}
+		//Radians, for UI. Animation should compose quaternions instead of adding to these
+		glm::vec3 getEulerAngles() const {
+			return quatToEuler(rotation);
+		}
+		void setEulerAngles(const glm::vec3& euler) {
+			rotation = eulerToQuat(euler);
+		}
+		//Applies delta in local space, renormalizing so repeated calls don't drift
+		void rotate(const glm::quat& delta) {
+			rotation = glm::normalize(rotation * delta);
 		}
 		void reset() {
 			position = glm::vec3(0);
-			rotation = glm::vec3(0);
+			rotation = glm::quat(1, 0, 0, 0);
 			scale = glm::vec3(1);
 		}
 	};
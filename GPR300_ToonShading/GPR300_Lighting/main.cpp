@@ -7,6 +7,7 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <stdio.h>
+#include <string.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -20,15 +21,20 @@
 #include "EW/Camera.h"
 #include "EW/Mesh.h"
 #include "EW/Transform.h"
+#include "EW/SceneGraph.h"
 #include "EW/ShapeGen.h"
+#include "EW/RenderQueue.h"
 
 #include <iostream>
 
-#include <queue>
+#include <algorithm>
+#include <string>
+#include <vector>
 
-void DrawOutlines(ew::Transform transforms[], ew::Transform outlineTransforms[], ew::Mesh* meshes[], Shader& lit, Shader& outline);
 GLuint createTexture(const char* filePath);
-void renderObjectInScene(Shader& shader, ew::Transform& transform, ew::Mesh& mesh);
+GLuint createTextureArray(const char* filePaths[], int count);
+GLuint createHatchLookup(const float thresholds[], int count);
+void updateHatchLookup(GLuint lookup, const float thresholds[], int count);
 void processInput(GLFWwindow* window);
 void resizeFrameBufferCallback(GLFWwindow* window, int width, int height);
 void keyboardCallback(GLFWwindow* window, int keycode, int scancode, int action, int mods);
@@ -46,10 +52,12 @@ double prevMouseX;
 double prevMouseY;
 bool firstMouseInput = false;
 
-float hatchThreshold1 = 0.3f;
-float hatchThreshold2 = 0.55f;
-float hatchThreshold3 = 0.7f;
-float hatchThreshold4 = 1.0f;
+//one threshold per hatch level, lightest level last
+const int NUM_HATCH_LEVELS = 4;
+float hatchThresholds[NUM_HATCH_LEVELS] = { 0.3f, 0.55f, 0.7f, 1.0f };
+
+//resolution of the tone -> hatch layer lookup texture
+const int HATCH_LOOKUP_SIZE = 256;
 
 float hatchTiling = 3;
 
@@ -85,10 +93,7 @@ DirectionalLight dirLight;
 glm::vec3 outlineColor = glm::vec3(0.25, 1, 0.5);
 float outlineScale = 1.08f;
 
-const char* HATCH_1 = "Hatch01.png";
-const char* HATCH_2 = "Hatch02.png";
-const char* HATCH_3 = "Hatch03.png";
-const char* HATCH_4 = "Hatch04.png";
+const char* HATCH_TEXTURES[NUM_HATCH_LEVELS] = { "Hatch01.png", "Hatch02.png", "Hatch03.png", "Hatch04.png" };
 
 int main() {
 	if (!glfwInit()) {
@@ -162,58 +167,57 @@ int main() {
 	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
 
 	//Initialize shape transforms
-	ew::Transform cubeTransform;
-	ew::Transform sphereTransform;
-	ew::Transform planeTransform;
-	ew::Transform cylinderTransform;
-
-	cubeTransform.position = glm::vec3(-2.0f, 0.0f, 0.0f);
-	sphereTransform.position = glm::vec3(0.0f, 0.0f, 0.0f);
-
-	planeTransform.position = glm::vec3(0.0f, -1.0f, 0.0f);
-	planeTransform.scale = glm::vec3(10.0f);
-
-	cylinderTransform.position = glm::vec3(2.0f, 0.0f, 0.0f);
-
-	//outline models
-	ew::Transform cubeOutlineTransform;
-	ew::Transform sphereOutlineTransform;
-	ew::Transform planeOutlineTransform;
-	ew::Transform cylinderOutlineTransform;
-
-	cubeOutlineTransform.position = cubeTransform.position;
-	cubeOutlineTransform.scale = cubeTransform.scale * outlineScale;
-	sphereOutlineTransform.position = sphereTransform.position;
-	sphereOutlineTransform.scale = sphereTransform.scale * outlineScale;
-
-	planeOutlineTransform.position = planeTransform.position;
-	planeOutlineTransform.scale = planeTransform.scale * outlineScale;
-
-	cylinderOutlineTransform.position = cylinderTransform.position;
-	cylinderOutlineTransform.scale = cylinderTransform.scale * outlineScale;
+	ew::SceneGraph scene;
+	ew::Transform transform;
+	transform.position = glm::vec3(-2.0f, 0.0f, 0.0f);
+	int cubeNode = scene.createNode(transform);
+	transform.position = glm::vec3(0.0f, 0.0f, 0.0f);
+	int sphereNode = scene.createNode(transform);
+	transform.position = glm::vec3(2.0f, 0.0f, 0.0f);
+	int cylinderNode = scene.createNode(transform);
+	transform.position = glm::vec3(0.0f, -1.0f, 0.0f);
+	transform.scale = glm::vec3(10.0f);
+	int planeNode = scene.createNode(transform);
+
+	//outline shells are children of their shape, only their scale is their own
+	const int NUM_OBJECTS = 4;
+	int objectNodes[NUM_OBJECTS] = { cubeNode, sphereNode, cylinderNode, planeNode };
+	ew::Mesh* objectMeshes[NUM_OBJECTS] = { &cubeMesh, &sphereMesh, &cylinderMesh, &planeMesh };
+	int outlineNodes[NUM_OBJECTS];
+	ew::Transform outlineTransform;
+	outlineTransform.scale = glm::vec3(outlineScale);
+	for (int i = 0; i < NUM_OBJECTS; i++) {
+		outlineNodes[i] = scene.createNode(outlineTransform, objectNodes[i]);
+	}
 
 	dirLight.color = glm::vec3(1, 1, 1);
 	dirLight.direction = glm::vec3(0, 1, 0);
 	dirLight.intensity = 0.5;
 
-	GLuint hatch1 = createTexture(HATCH_1);
-	GLuint hatch2 = createTexture(HATCH_2);
-	GLuint hatch3 = createTexture(HATCH_3);
-	GLuint hatch4 = createTexture(HATCH_4);
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, hatch1);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, hatch2);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, hatch3);
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, hatch4);
-
-	std::priority_queue<float> distances;
-	ew::Transform order[4];
-	ew::Transform outlines[4];
-	ew::Mesh* meshes[4] = {&cubeMesh};
+	//all hatch levels live in one array texture, the lookup maps tone -> pair of layers
+	GLuint hatchArray = createTextureArray(HATCH_TEXTURES, NUM_HATCH_LEVELS);
+	GLuint hatchLookup = createHatchLookup(hatchThresholds, NUM_HATCH_LEVELS);
+
+	if (hatchArray == NULL)
+		std::cout << "Failed to load hatch textures!" << std::endl;
+
+	//Shapes write their own stencil value, outlines draw wherever another value is, so one shape's outline
+	//still shows over the shapes behind it no matter which order the two passes run in
+	ew::RenderQueue renderQueue;
+	int litPass = renderQueue.addPass(GL_ALWAYS, 0xFF);
+	int outlinePass = renderQueue.addPass(GL_NOTEQUAL, 0x00);
+	int litProgram = renderQueue.addProgram(&litShader);
+	int outlineProgram = renderQueue.addProgram(&outlineShader);
+	ew::RenderQueue::MaterialTexture hatchTextures[] = {
+		{ 0, GL_TEXTURE_2D_ARRAY, hatchArray },
+		{ 1, GL_TEXTURE_1D, hatchLookup }
+	};
+	int hatchMaterial = renderQueue.addMaterial(hatchTextures, 2);
+	int outlineMaterial = renderQueue.addMaterial(NULL, 0);
+	int objectMeshIds[NUM_OBJECTS];
+	for (int i = 0; i < NUM_OBJECTS; i++) {
+		objectMeshIds[i] = renderQueue.addMesh(objectMeshes[i]);
+	}
 
 	while (!glfwWindowShouldClose(window)) {
 		processInput(window);
@@ -228,12 +232,7 @@ int main() {
 		deltaTime = time - lastFrameTime;
 		lastFrameTime = time;
 
-		//activate stencil
-		glStencilFunc(GL_ALWAYS, 1, 0xFF);
-		glStencilMask(0xFF);
-
 		//Draw
-		litShader.use();
 		litShader.setMat4("_Projection", camera.getProjectionMatrix());
 		litShader.setMat4("_View", camera.getViewMatrix());
 		litShader.setVec3("_Color", materialColor);
@@ -249,55 +248,28 @@ int main() {
 		litShader.setFloat("_SpecularK", specularK);
 		litShader.setFloat("_Shininess", shininess);
 
-		litShader.setInt("_Hatch1", 0);
-		litShader.setInt("_Hatch2", 1);
-		litShader.setInt("_Hatch3", 2);
-		litShader.setInt("_Hatch4", 3);
+		litShader.setInt("_HatchArray", 0);
+		litShader.setInt("_HatchLookup", 1);
 		litShader.setFloat("_ScreenWidth", SCREEN_WIDTH);
 		litShader.setFloat("_ScreenHeight", SCREEN_HEIGHT);
 
-		litShader.setFloat("_Threshold1", hatchThreshold1);
-		litShader.setFloat("_Threshold2", hatchThreshold2);
-		litShader.setFloat("_Threshold3", hatchThreshold3);
-		litShader.setFloat("_Threshold4", hatchThreshold4);
 		litShader.setFloat("_Tiling", hatchTiling);
 
-		distances.push(glm::distance(cubeTransform.position, camera.getPosition()));
-		distances.push(glm::distance(sphereTransform.position, camera.getPosition()));
-		distances.push(glm::distance(cylinderTransform.position, camera.getPosition()));
-		distances.push(glm::distance(planeTransform.position, camera.getPosition()));
+		outlineShader.setMat4("_Projection", camera.getProjectionMatrix());
+		outlineShader.setMat4("_View", camera.getViewMatrix());
+		outlineShader.setVec3("_OutlineColor", outlineColor);
 
-		for (int i = 3; i >= 0; i--)
-		{
-			if (distances.top() == glm::distance(cubeTransform.position, camera.getPosition()))
-			{
-				order[i] = cubeTransform;
-				outlines[i] = cubeOutlineTransform;
-				meshes[i] = &cubeMesh;
-			}
-			else if (distances.top() == glm::distance(sphereTransform.position, camera.getPosition()))
-			{
-				order[i] = sphereTransform;
-				outlines[i] = sphereOutlineTransform;
-				meshes[i] = &sphereMesh;
-			}
-			else if (distances.top() == glm::distance(cylinderTransform.position, camera.getPosition()))
-			{
-				order[i] = cylinderTransform;
-				outlines[i] = cylinderOutlineTransform;
-				meshes[i] = &cylinderMesh;
-			}
-			else if (distances.top() == glm::distance(planeTransform.position, camera.getPosition()))
-			{
-				order[i] = planeTransform;
-				outlines[i] = planeOutlineTransform;
-				meshes[i] = &planeMesh;
-			}
+		scene.update();
 
-			distances.pop();
+		//Recorded in any order, the queue sorts them by state and then nearest first
+		renderQueue.clear();
+		for (int i = 0; i < NUM_OBJECTS; i++)
+		{
+			float depth = glm::distance(scene.getWorldPosition(objectNodes[i]), camera.getPosition());
+			renderQueue.submit(litPass, litProgram, hatchMaterial, objectMeshIds[i], depth, scene.getWorldMatrix(objectNodes[i]), i + 1);
+			renderQueue.submit(outlinePass, outlineProgram, outlineMaterial, objectMeshIds[i], depth, scene.getWorldMatrix(outlineNodes[i]), i + 1);
 		}
-
-		DrawOutlines(order, outlines, meshes, litShader, outlineShader);
+		renderQueue.execute();
 
 		//Draw UI
 		ImGui::Begin("Settings");
@@ -308,10 +280,16 @@ int main() {
 
 		ImGui::SliderFloat("Hatch Tiling", &hatchTiling, 0.1, 20);
 
-		ImGui::SliderFloat("Hatch 1 Threshold", &hatchThreshold1, 0, 1);
-		ImGui::SliderFloat("Hatch 2 Threshold", &hatchThreshold2, 0, 1);
-		ImGui::SliderFloat("Hatch 3 Threshold", &hatchThreshold3, 0, 1);
-		ImGui::SliderFloat("Hatch 4 Threshold", &hatchThreshold4, 0, 1);
+		//only rebuild the lookup when a threshold actually moved
+		bool thresholdsChanged = false;
+		for (int i = 0; i < NUM_HATCH_LEVELS; i++)
+		{
+			std::string label = "Hatch " + std::to_string(i + 1) + " Threshold";
+			thresholdsChanged |= ImGui::SliderFloat(label.c_str(), &hatchThresholds[i], 0, 1);
+		}
+
+		if (thresholdsChanged)
+			updateHatchLookup(hatchLookup, hatchThresholds, NUM_HATCH_LEVELS);
 
 
 		if (ImGui::CollapsingHeader("Directional Light"))
@@ -324,13 +302,24 @@ int main() {
 		if (ImGui::CollapsingHeader("Outline Stuff"))
 		{
 			ImGui::ColorEdit3("Outline Color", &outlineColor.r);
-			ImGui::SliderFloat("Outline Scale", &outlineScale, 1.01, 2);
+			if (ImGui::SliderFloat("Outline Scale", &outlineScale, 1.01, 2))
+			{
+				for (int i = 0; i < NUM_OBJECTS; i++) {
+					scene.setScale(outlineNodes[i], glm::vec3(outlineScale));
+				}
+			}
 		}
 
-		cubeOutlineTransform.scale = cubeTransform.scale * outlineScale;
-		sphereOutlineTransform.scale = sphereTransform.scale * outlineScale;
-		cylinderOutlineTransform.scale = cylinderTransform.scale * outlineScale;
-		planeOutlineTransform.scale = planeTransform.scale * outlineScale;
+		if (ImGui::CollapsingHeader("Render Queue"))
+		{
+			const ew::RenderStats& sorted = renderQueue.getStats();
+			const ew::RenderStats& unsorted = renderQueue.getUnsortedStats();
+			ImGui::Text("Draws: %d", sorted.draws);
+			ImGui::Text("State changes: %d sorted, %d in submission order", sorted.getStateChanges(), unsorted.getStateChanges());
+			ImGui::Text("Programs: %d / %d, textures: %d / %d", sorted.programBinds, unsorted.programBinds, sorted.textureBinds, unsorted.textureBinds);
+			ImGui::Text("VAOs: %d / %d, stencil: %d / %d", sorted.vaoBinds, unsorted.vaoBinds,
+				sorted.passChanges + sorted.stencilRefChanges, unsorted.passChanges + unsorted.stencilRefChanges);
+		}
 
 		ImGui::End();
 
@@ -341,39 +330,13 @@ int main() {
 		glfwSwapBuffers(window);
 	}
 
+	glDeleteTextures(1, &hatchArray);
+	glDeleteTextures(1, &hatchLookup);
+
 	glfwTerminate();
 	return 0;
 }
 
-void DrawOutlines(ew::Transform transforms[], ew::Transform outlineTransforms[], ew::Mesh* meshes[], Shader& lit, Shader& outline)
-{
-	for (int i = 0; i < 4; i++)
-	{
-		//activate stencil
-		glStencilFunc(GL_ALWAYS, 1, 0xFF);
-		glStencilMask(0xFF);
-
-		lit.use();
-		renderObjectInScene(lit, transforms[i], *meshes[i]);
-
-		//deactivate stencil
-		glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-		glStencilMask(0x00);
-		//glDisable(GL_DEPTH_TEST);
-
-		outline.use();
-		outline.setMat4("_Projection", camera.getProjectionMatrix());
-		outline.setMat4("_View", camera.getViewMatrix());
-		outline.setVec3("_OutlineColor", outlineColor);
-
-		renderObjectInScene(outline, outlineTransforms[i], *meshes[i]);
-
-		glStencilMask(0xFF);
-		glStencilFunc(GL_ALWAYS, 0, 0xFF);
-		//glEnable(GL_DEPTH_TEST);
-	}
-}
-
 GLuint createTexture(const char* filePath)
 {
 	//texture stuff
@@ -421,13 +384,134 @@ GLuint createTexture(const char* filePath)
 	return texture;
 }
 
+//Author: Sam Fox
+//Bilinear resample so every layer of an array texture can share one size
+void resampleImage(const unsigned char* src, int srcWidth, int srcHeight, unsigned char* dst, int dstWidth, int dstHeight, int numComponents)
+{
+	for (int y = 0; y < dstHeight; y++)
+	{
+		float v = (y + 0.5f) * srcHeight / dstHeight - 0.5f;
+		int y0 = glm::clamp((int)floor(v), 0, srcHeight - 1);
+		int y1 = glm::min(y0 + 1, srcHeight - 1);
+		float ty = glm::clamp(v - y0, 0.0f, 1.0f);
+
+		for (int x = 0; x < dstWidth; x++)
+		{
+			float u = (x + 0.5f) * srcWidth / dstWidth - 0.5f;
+			int x0 = glm::clamp((int)floor(u), 0, srcWidth - 1);
+			int x1 = glm::min(x0 + 1, srcWidth - 1);
+			float tx = glm::clamp(u - x0, 0.0f, 1.0f);
+
+			for (int c = 0; c < numComponents; c++)
+			{
+				float top = glm::mix((float)src[(y0 * srcWidth + x0) * numComponents + c], (float)src[(y0 * srcWidth + x1) * numComponents + c], tx);
+				float bottom = glm::mix((float)src[(y1 * srcWidth + x0) * numComponents + c], (float)src[(y1 * srcWidth + x1) * numComponents + c], tx);
+				dst[(y * dstWidth + x) * numComponents + c] = (unsigned char)(glm::mix(top, bottom, ty) + 0.5f);
+			}
+		}
+	}
+}
+
+//Author: Sam Fox
+//Loads every image into one mipmapped GL_TEXTURE_2D_ARRAY, layer i = filePaths[i].
+//Layers are resampled to the size of the first image.
+GLuint createTextureArray(const char* filePaths[], int count)
+{
+	const int numComponents = 4;
+	int width = 0, height = 0;
+	std::vector<unsigned char> layers;
+
+	stbi_set_flip_vertically_on_load(true);
+	for (int i = 0; i < count; i++)
+	{
+		int layerWidth, layerHeight, layerComponents;
+		unsigned char* textureData = stbi_load(filePaths[i], &layerWidth, &layerHeight, &layerComponents, numComponents);
+
+		if (textureData == NULL)
+		{
+			std::cout << "Failed to load " << filePaths[i] << std::endl;
+			return NULL;
+		}
+
+		if (i == 0)
+		{
+			width = layerWidth;
+			height = layerHeight;
+			layers.resize((size_t)width * height * numComponents * count);
+		}
+
+		unsigned char* dst = &layers[(size_t)width * height * numComponents * i];
+		if (layerWidth == width && layerHeight == height)
+			memcpy(dst, textureData, (size_t)width * height * numComponents);
+		else
+			resampleImage(textureData, layerWidth, layerHeight, dst, width, height, numComponents);
+
+		stbi_image_free(textureData);
+	}
+
+	int mipLevels = 1 + (int)floor(log2((float)glm::max(width, height)));
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, mipLevels, GL_RGBA8, width, height, count);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, width, height, count, GL_RGBA, GL_UNSIGNED_BYTE, &layers[0]);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+	return texture;
+}
+
+//Author: Sam Fox
+//Precomputes which two hatch layers a tone falls between.
+//Each texel holds (lower layer, upper layer, segment start, 1 / segment width); lower layer < 0 means no hatching.
+void fillHatchLookup(const float thresholds[], int count, std::vector<glm::vec4>& texels)
+{
+	texels.assign(HATCH_LOOKUP_SIZE, glm::vec4(-1, -1, 0, 0));
+
+	for (int i = 0; i < HATCH_LOOKUP_SIZE; i++)
+	{
+		float ratio = (float)i / (HATCH_LOOKUP_SIZE - 1);
+
+		for (int j = 0; j < count - 1; j++)
+		{
+			if (thresholds[j] <= ratio && thresholds[j + 1] >= ratio)
+			{
+				float width = thresholds[j + 1] - thresholds[j];
+				texels[i] = glm::vec4(j, j + 1, thresholds[j], width > 0 ? 1.0f / width : 0.0f);
+				break;
+			}
+		}
+	}
+}
+
+//Author: Sam Fox
+GLuint createHatchLookup(const float thresholds[], int count)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_1D, texture);
+	glTexStorage1D(GL_TEXTURE_1D, 1, GL_RGBA32F, HATCH_LOOKUP_SIZE);
+
+	//nearest so layer indices are never blended together
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+	updateHatchLookup(texture, thresholds, count);
+	return texture;
+}
 
 //Author: Sam Fox
-void renderObjectInScene(Shader& shader, ew::Transform& transform, ew::Mesh& mesh)
+void updateHatchLookup(GLuint lookup, const float thresholds[], int count)
 {
-	//Draw cube
-	shader.setMat4("_Model", transform.getModelMatrix());
-	mesh.draw();
+	std::vector<glm::vec4> texels;
+	fillHatchLookup(thresholds, count, texels);
+	glTextureSubImage1D(lookup, 0, 0, HATCH_LOOKUP_SIZE, GL_RGBA, GL_FLOAT, &texels[0]);
 }
 
 //Author: Eric Winebrenner
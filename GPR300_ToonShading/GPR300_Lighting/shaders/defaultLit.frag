@@ -23,23 +23,16 @@ struct DirectionalLight
     float intensity;
 };
 
-uniform sampler2D _Hatch1;
-uniform sampler2D _Hatch2;
-uniform sampler2D _Hatch3;
-uniform sampler2D _Hatch4;
+//every hatch level is one layer of the array
+uniform sampler2DArray _HatchArray;
+
+//tone -> (lower layer, upper layer, segment start, 1 / segment width)
+uniform sampler1D _HatchLookup;
 
 uniform float _ScreenWidth;
 uniform float _ScreenHeight;
 uniform float _Tiling;
 
-//threshold settings
-
-uniform float _Threshold1;
-uniform float _Threshold2;
-uniform float _Threshold3;
-uniform float _Threshold4;
-
-
 uniform DirectionalLight _DirLight;
 in vec2 UV;
 
@@ -74,49 +67,23 @@ vec3 CalculateDirectionalLight(DirectionalLight light, vec3 worldNormal)
     return ambient + diffuse + specular;
 }
 
-//here's Nate's fancy stuff for hatch lerping.
-//this is kind of gross. 
-struct GradientSegment
-{
-    float percent;
-    vec3 color;
-};
-
+//two array fetches and a lerp, the segment search is baked into _HatchLookup
 vec3 GetHatchGradient(float ratio, vec2 screenUV) 
 {    
-    if (ratio > 1) 
-    {
-        ratio = 1;
-    }
-    
-    GradientSegment colors[4];
-    colors[0].color = texture(_Hatch1, screenUV).xyz;
-    colors[0].percent = _Threshold1;
+    ratio = clamp(ratio, 0, 1);
 
-    colors[1].color = texture(_Hatch1, screenUV).xyz;
-    colors[1].percent =_Threshold2;
+    float lookupSize = textureSize(_HatchLookup, 0);
+    vec4 segment = texture(_HatchLookup, (ratio * (lookupSize - 1) + 0.5) / lookupSize);
 
-    colors[2].color = texture(_Hatch2, screenUV).xyz;
-    colors[2].percent = _Threshold3;
-
-    colors[3].color = texture(_Hatch4, screenUV).xyz;
-    colors[3].percent = _Threshold4;
-    
-    vec3 finalColor = vec3(0, 0, 0);
-    //lerp.
-
-    for (int i = 0; i < 3; i++)
+    if (segment.x < 0)
     {
-        if (colors[i].percent <= ratio && colors[i + 1].percent >= ratio)
-        {
-            float lerpTime = (ratio - colors[i].percent) / (colors[i + 1].percent - colors[i].percent);
-            finalColor.r = colors[i].color.x + lerpTime * (colors[i + 1].color.x - colors[i].color.x);
-            finalColor.g = colors[i].color.y + lerpTime * (colors[i + 1].color.y - colors[i].color.y);
-            finalColor.b = colors[i].color.z + lerpTime * (colors[i + 1].color.z - colors[i].color.z);
-            return finalColor;
-        }
+        return vec3(0, 0, 0);
     }
-    return finalColor;
+
+    float lerpTime = clamp((ratio - segment.z) * segment.w, 0, 1);
+    vec3 lower = texture(_HatchArray, vec3(screenUV, segment.x)).xyz;
+    vec3 upper = texture(_HatchArray, vec3(screenUV, segment.y)).xyz;
+    return mix(lower, upper, lerpTime);
 }
 
 void main()
@@ -5,6 +5,7 @@
 #include <glm/matrix.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include <stdio.h>
 
@@ -60,42 +61,61 @@ namespace sf
 struct Transform
 {
 	glm::vec3 position;
-	glm::vec3 rotation; //euler angles
+	glm::quat rotation;
 	glm::vec3 scale;
 
-	glm::mat4 getModelMatrix()
+	//euler angles, rotated in the order X, Y, Z
+	void setRotation(const glm::vec3& euler)
 	{
-		glm::mat4 t = glm::mat4(1);
-		t[3][0] = position.x;
-		t[3][1] = position.y;
-		t[3][2] = position.z;
-
-		glm::mat4 s = glm::mat4(1);
-		s[0][0] = scale.x;
-		s[1][1] = scale.y;
-		s[2][2] = scale.z;
-
 		glm::mat4 rX = glm::mat4(
 			1, 0, 0, 0,
-			0, cos(rotation.x), -sin(rotation.x), 0,
-			0, sin(rotation.x), cos(rotation.x), 0,
+			0, cos(euler.x), -sin(euler.x), 0,
+			0, sin(euler.x), cos(euler.x), 0,
 			0, 0, 0, 1);
 
 		glm::mat4 rY = glm::mat4(
-			cos(rotation.y), 0, sin(rotation.y), 0,
+			cos(euler.y), 0, sin(euler.y), 0,
 			0, 1, 0, 0,
-			-sin(rotation.y), 0, cos(rotation.y), 0,
+			-sin(euler.y), 0, cos(euler.y), 0,
 			0, 0, 0, 1);
 
 		glm::mat4 rZ = glm::mat4(
-			cos(rotation.z), -sin(rotation.z), 0, 0,
-			sin(rotation.z), cos(rotation.z), 0, 0,
+			cos(euler.z), -sin(euler.z), 0, 0,
+			sin(euler.z), cos(euler.z), 0, 0,
 			0, 0, 1, 0,
 			0, 0, 0, 1);
 
-		glm::mat4 r = rZ * rY * rX;
+		rotation = glm::quat_cast(rZ * rY * rX);
+	}
+
+	//the matrices above are transposed, so angles turn the other way around their axis than glm::angleAxis.
+	//normalizing keeps the quaternion a rotation no matter how long this keeps accumulating
+
+	//around the object's own axis, same as adding angle to euler x
+	void rotateLocal(float angle, const glm::vec3& axis)
+	{
+		rotation = glm::normalize(rotation * glm::angleAxis(-angle, axis));
+	}
+
+	//around the world axis, same as adding angle to euler z
+	void rotateWorld(float angle, const glm::vec3& axis)
+	{
+		rotation = glm::normalize(glm::angleAxis(-angle, axis) * rotation);
+	}
+
+	glm::mat4 getModelMatrix()
+	{
+		glm::mat4 t = glm::mat4(1);
+		t[3][0] = position.x;
+		t[3][1] = position.y;
+		t[3][2] = position.z;
+
+		glm::mat4 s = glm::mat4(1);
+		s[0][0] = scale.x;
+		s[1][1] = scale.y;
+		s[2][2] = scale.z;
 
-		return t * s * r;
+		return t * s * glm::mat4_cast(rotation);
 	}
 };
 
@@ -250,12 +270,12 @@ int main()
 	transform[5].position = glm::vec3(0);
 
 	// cube rotations
-	transform[0].rotation = glm::vec3(1, 0, 1);
-	transform[1].rotation = glm::vec3(5, 1, -4);
-	transform[2].rotation = glm::vec3(3, -3, 0);
-	transform[3].rotation = glm::vec3(0, 3, 1);
-	transform[4].rotation = glm::vec3(2, -1, 2);
-	transform[5].rotation = glm::vec3(1, -.5, .3);
+	transform[0].setRotation(glm::vec3(1, 0, 1));
+	transform[1].setRotation(glm::vec3(5, 1, -4));
+	transform[2].setRotation(glm::vec3(3, -3, 0));
+	transform[3].setRotation(glm::vec3(0, 3, 1));
+	transform[4].setRotation(glm::vec3(2, -1, 2));
+	transform[5].setRotation(glm::vec3(1, -.5, .3));
 
 	while (!glfwWindowShouldClose(window))
 	{
@@ -282,9 +302,9 @@ int main()
 		for (size_t i = 0; i < NUM_CUBES; i++)
 		{
 			if (i < NUM_CUBES / 2)
-				transform[i].rotation.x += sin(time) * 0.1f;
+				transform[i].rotateLocal(sin(time) * 0.1f, glm::vec3(1, 0, 0));
 			else
-				transform[i].rotation.z += cos(time) * 0.2f;
+				transform[i].rotateWorld(cos(time) * 0.2f, glm::vec3(0, 0, 1));
 
 			shader.setMat4("_Model", transform[i].getModelMatrix());
 			shader.setMat4("_View", camera.getViewMatrix());